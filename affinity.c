@@ -0,0 +1,211 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * CPU pinning for the worker threads, see affinity.h.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include "affinity.h"
+
+/* NUMA nodes looked for under /sys */
+#define AFFINITY_MAX_NODES (256)
+
+/******************** Parse CPU List **********************
+ * parse_cpus: Reads a CPU list like "0,2,8-15" (the format of --pin and
+ *       of /sys/.../cpulist).
+ * list: The text.
+ * cpus: Set to 1 for every CPU in the list.
+ * returns: 0, or -1 if the list is bad or names a CPU past CPU_SETSIZE.
+ ***************************************************************/
+
+static int parse_cpus(const char *list, cpu_set_t *cpus) {
+    const char *p = list;
+
+    CPU_ZERO(cpus);
+    while (*p && *p != '\n') {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        long hi = lo;
+
+        if (end == p || lo < 0) {
+            return -1;
+        }
+        p = end;
+        if (*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            if (end == p + 1 || hi < lo) {
+                return -1;
+            }
+            p = end;
+        }
+        if (hi >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (long c = lo; c <= hi; c++) {
+            CPU_SET(c, cpus);
+        }
+        if (*p == ',') {
+            p++;
+        }
+        else if (*p && *p != '\n') {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/******************** CPU Node **********************
+ * affinity_node: See affinity.h. Reads each node's cpulist until one
+ *       holds the CPU.
+ ***************************************************************/
+
+int affinity_node(int cpu) {
+    for (int node = 0; node < AFFINITY_MAX_NODES; node++) {
+        char path[64], line[4096];
+        cpu_set_t cpus;
+        FILE *in;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+                node);
+        in = fopen(path, "r");
+        if (!in) {
+            continue;
+        }
+        if (fgets(line, sizeof(line), in) && parse_cpus(line, &cpus) == 0
+                && CPU_ISSET(cpu, &cpus)) {
+            fclose(in);
+            return node;
+        }
+        fclose(in);
+    }
+    return 0;
+}
+
+/******************** Plan CPUs **********************
+ * affinity_plan: See affinity.h.
+ ***************************************************************/
+
+int *affinity_plan(const char *policy, int num_threads) {
+    cpu_set_t allowed, listed;
+    int *order, *node, *plan;
+    int n = 0;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+        perror("sched_getaffinity");
+        return NULL;
+    }
+    order = malloc(sizeof(int) * CPU_SETSIZE);
+    node = malloc(sizeof(int) * CPU_SETSIZE);
+    plan = malloc(sizeof(int) * num_threads);
+    if (!order || !node || !plan) {
+        printf("malloc failed: cpu plan\n");
+        exit(1);
+    }
+
+    if (strcmp(policy, "compact") == 0 || strcmp(policy, "scatter") == 0) {
+        int scatter = policy[0] == 's';
+        int max_node = 0;
+
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &allowed)) {
+                node[n] = affinity_node(c);
+                if (node[n] > max_node) {
+                    max_node = node[n];
+                }
+                order[n++] = c;
+            }
+        }
+        //sort by (node, cpu) for compact, by (rank in node, node) for
+        //scatter; n is small, so insertion sort
+        int *key = malloc(sizeof(int) * (n > 0 ? n : 1));
+        int *seen = calloc(max_node + 1, sizeof(int));
+
+        if (!key || !seen) {
+            printf("malloc failed: cpu plan\n");
+            exit(1);
+        }
+        for (int k = 0; k < n; k++) {
+            key[k] = scatter ? seen[node[k]]++ * (max_node + 1) + node[k]
+                : node[k];
+        }
+        for (int k = 1; k < n; k++) {
+            int c = order[k], kk = key[k], m = k;
+
+            while (m > 0 && key[m-1] > kk) {
+                order[m] = order[m-1];
+                key[m] = key[m-1];
+                m--;
+            }
+            order[m] = c;
+            key[m] = kk;
+        }
+        free(key);
+        free(seen);
+    }
+    else {
+        if (parse_cpus(policy, &listed)) {
+            printf("Bad --pin: %s (compact, scatter or a cpu list like"
+                    " 0,2,8-15)\n", policy);
+            free(order);
+            free(node);
+            free(plan);
+            return NULL;
+        }
+        //in the order given, not sorted
+        for (const char *p = policy; *p; ) {
+            char *end;
+            long lo = strtol(p, &end, 10), hi = lo;
+
+            if (*end == '-') {
+                hi = strtol(end + 1, &end, 10);
+            }
+            for (long c = lo; c <= hi; c++) {
+                if (!CPU_ISSET(c, &allowed)) {
+                    printf("CPU %ld is not available to this process\n", c);
+                    free(order);
+                    free(node);
+                    free(plan);
+                    return NULL;
+                }
+                if (n < CPU_SETSIZE) {
+                    order[n++] = c;
+                }
+            }
+            p = (*end == ',') ? end + 1 : end;
+        }
+    }
+
+    if (n == 0) {
+        printf("No CPUs to pin threads to\n");
+        free(order);
+        free(node);
+        free(plan);
+        return NULL;
+    }
+    for (int t = 0; t < num_threads; t++) {
+        plan[t] = order[t % n];
+    }
+    free(order);
+    free(node);
+    return plan;
+}
+
+/******************** Pin Thread **********************
+ * affinity_pin: See affinity.h.
+ ***************************************************************/
+
+int affinity_pin(int cpu) {
+    cpu_set_t cpus;
+
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) ? -1 : 0;
+}
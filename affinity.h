@@ -0,0 +1,28 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * CPU pinning for the worker threads. The CPUs and NUMA nodes come from
+ * the process's affinity mask and /sys, so no NUMA library is needed.
+ */
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+/* pick a CPU for each of num_threads threads. policy is "compact" (fill
+ * one NUMA node before the next), "scatter" (deal threads round-robin
+ * across nodes) or a CPU list like "0,2,8-15". With more threads than
+ * CPUs the CPUs are reused in the same order. returns a malloc'd array of
+ * num_threads CPUs, or NULL (with a message printed) if the policy is bad
+ * or names a CPU this process may not use */
+int *affinity_plan(const char *policy, int num_threads);
+
+/* the NUMA node of a CPU, 0 if the system does not say */
+int affinity_node(int cpu);
+
+/* pin the calling thread to cpu, returns 0 or -1 */
+int affinity_pin(int cpu);
+
+#endif
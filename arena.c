@@ -0,0 +1,219 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * The board arena, see arena.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <linux/mman.h>
+#include "arena.h"
+
+#define HUGE_2M (2L << 20)
+#define HUGE_1G (1L << 30)
+
+/******************** Map Huge Pages **********************
+ * map_hugetlb: Maps bytes on reserved hugetlbfs pages of one size.
+ * bytes: The size, rounded up to the page size here.
+ * page: The page size, HUGE_2M or HUGE_1G.
+ * size: Set to the bytes mapped.
+ * returns: The mapping, or NULL if there are not enough pages reserved
+ *       (or none of that size at all).
+ ***************************************************************/
+
+static char *map_hugetlb(size_t bytes, long page, size_t *size) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB
+        | (page == HUGE_1G ? MAP_HUGE_1GB : MAP_HUGE_2MB);
+    char *addr;
+
+    *size = (bytes + page - 1) & ~(size_t)(page - 1);
+    addr = mmap(NULL, *size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    return addr == MAP_FAILED ? NULL : addr;
+}
+
+/******************** THP Enabled **********************
+ * thp_enabled: Whether transparent huge pages may back a mapping that
+ *       asks for them, which the kernel says in
+ *       /sys/kernel/mm/transparent_hugepage/enabled ("always" or
+ *       "madvise" picked, not "never").
+ ***************************************************************/
+
+static int thp_enabled(void) {
+    FILE *in = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    char line[128];
+    int on = 0;
+
+    if (!in) {
+        return 0;
+    }
+    if (fgets(line, sizeof(line), in)) {
+        on = !strstr(line, "[never]");
+    }
+    fclose(in);
+    return on;
+}
+
+/******************** Map Pages **********************
+ * map_pages: Maps bytes of plain pages. For THP the mapping is put on a
+ *       2 MB boundary (mapping 2 MB more and trimming the ends), so every
+ *       2 MB of it can be one huge page, and advised to use them; else THP
+ *       is turned off for it, so plain pages are what was asked for.
+ * bytes: The size.
+ * thp: 1 for THP.
+ * size: Set to the bytes mapped.
+ * returns: The mapping, or NULL if mmap failed.
+ ***************************************************************/
+
+static char *map_pages(size_t bytes, int thp, size_t *size) {
+    long page = sysconf(_SC_PAGESIZE);
+    size_t extra = thp ? HUGE_2M : 0;
+    char *addr, *start;
+
+    *size = (bytes + page - 1) & ~(size_t)(page - 1);
+    if (thp) {
+        *size = (*size + HUGE_2M - 1) & ~(size_t)(HUGE_2M - 1);
+    }
+    addr = mmap(NULL, *size + extra, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+    start = addr;
+    if (thp) {
+        start = (char *)(((uintptr_t)addr + HUGE_2M - 1)
+                & ~(uintptr_t)(HUGE_2M - 1));
+        if (start > addr) {
+            munmap(addr, start - addr);
+        }
+        if (start + *size < addr + *size + extra) {
+            munmap(start + *size, addr + *size + extra - (start + *size));
+        }
+    }
+    //advice only, an arena without it still works
+    madvise(start, *size, thp ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+    return start;
+}
+
+/******************** Create Arena **********************
+ * arena_create: See arena.h.
+ ***************************************************************/
+
+struct arena *arena_create(size_t bytes, int mode) {
+    struct arena *a = calloc(1, sizeof(struct arena));
+
+    if (!a) {
+        printf("malloc failed: arena\n");
+        exit(1);
+    }
+    if (bytes == 0) {
+        bytes = ARENA_ALIGN;
+    }
+    if (mode == ARENA_AUTO && bytes >= HUGE_1G) {
+        a->addr = map_hugetlb(bytes, HUGE_1G, &a->size);
+        a->pages = ARENA_PAGES_1G;
+        a->page_bytes = HUGE_1G;
+    }
+    if (!a->addr && mode == ARENA_AUTO) {
+        a->addr = map_hugetlb(bytes, HUGE_2M, &a->size);
+        a->pages = ARENA_PAGES_2M;
+        a->page_bytes = HUGE_2M;
+    }
+    if (!a->addr && mode != ARENA_SMALL && thp_enabled()) {
+        a->addr = map_pages(bytes, 1, &a->size);
+        a->pages = ARENA_PAGES_THP;
+        a->page_bytes = HUGE_2M;
+    }
+    if (!a->addr) {
+        a->addr = map_pages(bytes, 0, &a->size);
+        a->pages = ARENA_PAGES_SMALL;
+        a->page_bytes = sysconf(_SC_PAGESIZE);
+    }
+    if (!a->addr) {
+        printf("mmap failed: %zu byte board arena\n", bytes);
+        exit(1);
+    }
+    return a;
+}
+
+/******************** Allocate From Arena **********************
+ * arena_alloc: See arena.h. A bump of the used count, so threads can
+ *       take pieces at once.
+ ***************************************************************/
+
+void *arena_alloc(struct arena *a, size_t bytes) {
+    size_t piece = arena_piece(bytes);
+    size_t at = __atomic_fetch_add(&a->used, piece, __ATOMIC_RELAXED);
+
+    if (at + piece > a->size) {
+        return NULL;
+    }
+    return a->addr + at;
+}
+
+/******************** Arena Pages **********************
+ * arena_usage: See arena.h. Finds the arena's mapping in smaps by its
+ *       start address and reads the two fields of it.
+ ***************************************************************/
+
+int arena_usage(const struct arena *a, long *page_kb, long *thp_kb) {
+    FILE *in = fopen("/proc/self/smaps", "r");
+    char line[256];
+    int found = 0;
+
+    *page_kb = a->page_bytes / 1024;
+    *thp_kb = 0;
+    if (!in) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), in)) {
+        unsigned long lo, hi;
+
+        //a mapping's first line is its range, its fields follow (no
+        //field name scans as one)
+        if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+            if (found) {
+                break;
+            }
+            found = lo == (uintptr_t)a->addr;
+            continue;
+        }
+        if (found) {
+            sscanf(line, "KernelPageSize: %ld kB", page_kb);
+            sscanf(line, "AnonHugePages: %ld kB", thp_kb);
+        }
+    }
+    fclose(in);
+    return found ? 0 : -1;
+}
+
+/******************** Page Names **********************/
+const char *arena_pages_name(int pages) {
+    switch (pages) {
+        case ARENA_PAGES_1G:
+            return "1 GB hugetlbfs";
+        case ARENA_PAGES_2M:
+            return "2 MB hugetlbfs";
+        case ARENA_PAGES_THP:
+            return "2 MB transparent";
+    }
+    return "base size";
+}
+
+/******************** Destroy Arena **********************
+ * arena_destroy: See arena.h.
+ ***************************************************************/
+
+void arena_destroy(struct arena *a) {
+    if (!a) {
+        return;
+    }
+    munmap(a->addr, a->size);
+    free(a);
+}
@@ -0,0 +1,78 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * One mapping for the run's boards and scratch space, on huge pages when
+ * the system has them, so a big board takes a few TLB entries instead of
+ * one per 4 KB. The arena is sized up front and handed out in pieces
+ * aligned to ARENA_ALIGN; nothing is freed until the arena is.
+ *
+ * With ARENA_AUTO the pages tried are, in order: reserved hugetlbfs pages
+ * (1 GB ones for an arena of at least 1 GB, then 2 MB ones), transparent
+ * huge pages (a 2 MB aligned mapping with MADV_HUGEPAGE), and plain pages.
+ * Pieces are spaced ARENA_STAGGER apart so they do not alias in cache.
+ * The memory comes zeroed and is only placed when first touched, so the
+ * threads that zero their own part of a board still get it on their node.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* every piece starts on a cache line, which also covers AVX-512 loads */
+#define ARENA_ALIGN (64)
+
+/* gap left after every piece. On huge pages two boards of the same size
+ * would otherwise start at the same offset into a page, which makes a
+ * row of one and the same row of the other share cache sets all the way
+ * to L2 (a 16 MB bitpack run took about 1.5x as long with no gap) */
+#define ARENA_STAGGER (16384 + ARENA_ALIGN)
+
+/* which pages to try, see --pages */
+#define ARENA_AUTO  (0) //hugetlbfs, then THP, then plain pages
+#define ARENA_THP   (1) //THP, then plain pages
+#define ARENA_SMALL (2) //plain pages, THP turned off for the mapping
+
+/* the pages an arena got */
+#define ARENA_PAGES_1G    (0) //hugetlbfs, 1 GB pages
+#define ARENA_PAGES_2M    (1) //hugetlbfs, 2 MB pages
+#define ARENA_PAGES_THP   (2) //transparent huge pages where the kernel can
+#define ARENA_PAGES_SMALL (3) //the base page size
+
+struct arena {
+    char *addr;
+    size_t size; //bytes mapped
+    size_t used; //bytes handed out (atomic)
+    int pages; //ARENA_PAGES_*
+    long page_bytes; //the page size asked for
+};
+
+/* map an arena for at least bytes of pieces, trying the pages of mode.
+ * exits on failure */
+struct arena *arena_create(size_t bytes, int mode);
+
+/* bytes a piece of bytes takes in an arena, for sizing one */
+static inline size_t arena_piece(size_t bytes) {
+    return ((bytes + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+        + ARENA_STAGGER;
+}
+
+/* a zeroed piece of bytes, ARENA_ALIGN aligned; any thread may take one.
+ * returns NULL if the arena is full */
+void *arena_alloc(struct arena *a, size_t bytes);
+
+/* how the arena's pages turned out, from /proc/self/smaps once they have
+ * been touched: the kernel page size, and the KB on transparent huge
+ * pages. returns 0, or -1 if smaps could not be read */
+int arena_usage(const struct arena *a, long *page_kb, long *thp_kb);
+
+/* a name for an arena's pages, like "2 MB hugetlbfs" */
+const char *arena_pages_name(int pages);
+
+/* unmap the arena and free it */
+void arena_destroy(struct arena *a);
+
+#endif
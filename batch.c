@@ -0,0 +1,849 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Batch runner for many small boards, for Monte Carlo sweeps where
+ * starting gol once per board would cost more than the boards do. Boards
+ * come from a directory of board files or from a range of random seeds,
+ * and all of them are simulated in one process.
+ *
+ * Boards of the same size, rule and rounds are bit-sliced 64 to a group:
+ * every cell is one word whose bit b is that cell on board b, so one
+ * bitboard_rule_word steps the cell on all 64 boards at once, with no
+ * shifts, and the compiler vectorizes the row loop on top of that. Worker
+ * threads take whole groups off a shared counter.
+ *
+ * Each group keeps its last --period+1 generations (at least 2). A board
+ * has settled at generation g with period p the first time it repeats its
+ * state from p generations before (g is then the first generation of its
+ * cycle). A group stops as soon as all of its boards have settled, and each board's
+ * final population is read off the generation that matches its last round.
+ *
+ * To run:
+ * ./gol_batch --seeds=1-100000 --rounds=500            # 64x64 random boards
+ * ./gol_batch --seeds=1-1000 --size=128x96 --density=0.4 --rounds=1000
+ * ./gol_batch --dir=boards --out=results.csv           # every file in boards
+ * ./gol_batch --rule=highlife --rounds=200 a.txt b.rle # or files by name
+ *
+ * Options:
+ * --dir=DIR               simulate every file in DIR (text or RLE)
+ * --seeds=A-B             simulate random boards with seeds A to B
+ * --size=N|RxC            random board size (default 64x64)
+ * --density=D             chance a random cell starts alive (default 0.3)
+ * --rounds=N              rounds per board (files default to their own)
+ * --rule=RULE             rule, see gol -r (files default to their own)
+ * --period=P              longest cycle detected (default 2, 0 for none)
+ * --threads=T             worker threads (default the online CPUs)
+ * --out=FILE              where the results go (default stdout)
+ *
+ * Output is CSV, one line per board in the order given:
+ * board,rows,cols,rounds,live,settled,period
+ * where board is the file or seed, live the population after the last
+ * round, and settled/period the generation the board settled at and its
+ * period, or -1 and 0 if it did not settle within --period.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+#include "bitboard.h"
+#include "loader.h"
+#include "rule.h"
+
+/* boards in a group, one per bit of a word */
+#define BATCH_LANES (64)
+
+/* defaults for the options above */
+#define DEFAULT_SIZE     (64)
+#define DEFAULT_DENSITY  (0.3)
+#define DEFAULT_PERIOD   (2)
+
+/* longest --period, each one is another generation kept per group */
+#define MAX_PERIOD (16)
+
+/* getopt ids, every option is long only */
+enum {
+    OPT_DIR = 256, OPT_SEEDS, OPT_SIZE, OPT_DENSITY, OPT_ROUNDS, OPT_RULE,
+    OPT_PERIOD, OPT_THREADS, OPT_OUT
+};
+
+/* what to run, from the command line */
+struct batch_opts {
+    const char *dir;
+    char **files; //board files named on the command line
+    int num_files;
+    int seeds; //1 for random boards
+    uint64_t seed_first, seed_last;
+    int rows, cols;
+    double density;
+    int rounds; //-1 if not given
+    int rule_given;
+    uint32_t rule;
+    int period;
+    int threads;
+    const char *out;
+};
+
+/* one board, in input order */
+struct batch_board {
+    char *path; //NULL for a random board
+    uint64_t seed;
+    int rows, cols, rounds;
+    uint32_t rule;
+    long live; //results
+    long settled;
+    int period;
+};
+
+/* up to 64 boards of the same size, rule and rounds */
+struct batch_group {
+    int first; //index into order
+    int num;
+};
+
+/* everything the workers share */
+struct batch {
+    const struct batch_opts *opts;
+    struct batch_board *boards;
+    int num_boards;
+    int *order; //board indices sorted so groups are runs
+    struct batch_group *groups;
+    int num_groups;
+    int next_group; //taken with an atomic add
+    long cell_rounds; //board cells times rounds stepped, for the rate
+};
+
+/****************** Function Prototypes **********************/
+
+/* read the options into opts, exits on a bad one */
+void parse_batch_options(struct batch_opts *opts, int argc, char **argv);
+
+/* list the boards to run, from files or seeds, exits on a bad file */
+struct batch_board *make_boards(const struct batch_opts *opts, int *num);
+
+/* sort the boards into groups of the same size, rule and rounds */
+void make_groups(struct batch *b);
+
+/* the worker threads' main loop: run groups until there are none left */
+void *batch_worker(void *arg);
+
+/* simulate one group and fill in its boards' results */
+void run_group(struct batch *b, const struct batch_group *g,
+        uint64_t *gens);
+
+/* write the results as CSV */
+void write_results(const struct batch_opts *opts,
+        const struct batch_board *boards, int num);
+
+/**************************************************************/
+
+int main(int argc, char **argv) {
+    struct batch_opts opts;
+    struct batch b;
+    pthread_t *tids;
+    struct timespec start, end;
+    double secs;
+
+    parse_batch_options(&opts, argc, argv);
+    memset(&b, 0, sizeof(b));
+    b.opts = &opts;
+    b.boards = make_boards(&opts, &b.num_boards);
+    make_groups(&b);
+    if (opts.threads > b.num_groups) {
+        opts.threads = b.num_groups > 0 ? b.num_groups : 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    tids = malloc(sizeof(pthread_t) * opts.threads);
+    if (!tids) {
+        printf("malloc failed: threads\n");
+        exit(1);
+    }
+    for (int t = 0; t < opts.threads; t++) {
+        if (pthread_create(&tids[t], NULL, batch_worker, &b)) {
+            printf("pthread_create failed\n");
+            exit(1);
+        }
+    }
+    for (int t = 0; t < opts.threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    write_results(&opts, b.boards, b.num_boards);
+    fprintf(stderr, "%d boards in %d groups, %d threads: %.3f s, "
+            "%.4g cells/s\n", b.num_boards, b.num_groups, opts.threads,
+            secs, secs > 0 ? b.cell_rounds / secs : 0);
+
+    for (int k = 0; k < b.num_boards; k++) {
+        free(b.boards[k].path);
+    }
+    free(b.boards);
+    free(b.order);
+    free(b.groups);
+    free(tids);
+    return 0;
+}
+
+/******************** Parse Size **********************
+ * parse_size: Reads a board size, N (square) or RxC.
+ * text: The text.
+ * rows, cols: Set to the size.
+ * returns: 0, or -1 if it is not a size.
+ ***************************************************************/
+
+static int parse_size(const char *text, int *rows, int *cols) {
+    if (sscanf(text, "%dx%d", rows, cols) == 2) {
+        return (*rows > 0 && *cols > 0) ? 0 : -1;
+    }
+    if (sscanf(text, "%d", rows) == 1 && *rows > 0) {
+        *cols = *rows;
+        return 0;
+    }
+    return -1;
+}
+
+/******************** Parse Options **********************
+ * parse_batch_options: Reads the options, see the top of the file.
+ *       Arguments left over are board files.
+ * opts: Filled in, defaults first.
+ * argc, argv: The command line.
+ * returns: void.
+ ***************************************************************/
+
+void parse_batch_options(struct batch_opts *opts, int argc, char **argv) {
+    static struct option long_opts[] = {
+        {"dir", required_argument, NULL, OPT_DIR},
+        {"seeds", required_argument, NULL, OPT_SEEDS},
+        {"size", required_argument, NULL, OPT_SIZE},
+        {"density", required_argument, NULL, OPT_DENSITY},
+        {"rounds", required_argument, NULL, OPT_ROUNDS},
+        {"rule", required_argument, NULL, OPT_RULE},
+        {"period", required_argument, NULL, OPT_PERIOD},
+        {"threads", required_argument, NULL, OPT_THREADS},
+        {"out", required_argument, NULL, OPT_OUT},
+        {NULL, 0, NULL, 0}
+    };
+    unsigned long long first, last;
+    int opt;
+
+    //defaults
+    memset(opts, 0, sizeof(*opts));
+    opts->rows = opts->cols = DEFAULT_SIZE;
+    opts->density = DEFAULT_DENSITY;
+    opts->rounds = -1;
+    opts->rule = RULE_LIFE;
+    opts->period = DEFAULT_PERIOD;
+    opts->threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (opts->threads < 1) {
+        opts->threads = 1;
+    }
+
+    while ((opt = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case OPT_DIR:
+                opts->dir = optarg;
+                break;
+            case OPT_SEEDS:
+                if (sscanf(optarg, "%llu-%llu", &first, &last) != 2) {
+                    if (sscanf(optarg, "%llu", &first) != 1) {
+                        printf("Bad seeds: %s (use A-B)\n", optarg);
+                        exit(1);
+                    }
+                    last = first;
+                }
+                if (last < first || last - first >= INT32_MAX) {
+                    printf("Bad seeds: %s (use A-B)\n", optarg);
+                    exit(1);
+                }
+                opts->seeds = 1;
+                opts->seed_first = first;
+                opts->seed_last = last;
+                break;
+            case OPT_SIZE:
+                if (parse_size(optarg, &opts->rows, &opts->cols)) {
+                    printf("Bad size: %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_DENSITY:
+                opts->density = atof(optarg);
+                if (opts->density < 0 || opts->density > 1) {
+                    printf("Bad density: %s (use 0 to 1)\n", optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_ROUNDS:
+                opts->rounds = atoi(optarg);
+                if (opts->rounds < 0) {
+                    printf("Bad rounds: %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_RULE:
+                if (rule_parse(optarg, &opts->rule)) {
+                    printf("Bad rule: %s (use B3/S23, 23/3 or a name)\n",
+                            optarg);
+                    exit(1);
+                }
+                opts->rule_given = 1;
+                break;
+            case OPT_PERIOD:
+                opts->period = atoi(optarg);
+                if (opts->period < 0 || opts->period > MAX_PERIOD) {
+                    printf("Bad period: %s (use 0 to %d)\n", optarg,
+                            MAX_PERIOD);
+                    exit(1);
+                }
+                break;
+            case OPT_THREADS:
+                opts->threads = atoi(optarg);
+                if (opts->threads < 1) {
+                    printf("Bad threads: %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_OUT:
+                opts->out = optarg;
+                break;
+            default:
+                exit(1);
+        }
+    }
+    opts->files = argv + optind;
+    opts->num_files = argc - optind;
+    if (!opts->seeds && !opts->dir && opts->num_files == 0) {
+        printf("usage: %s --seeds=A-B --rounds=N | --dir=DIR | FILE...\n",
+                argv[0]);
+        exit(1);
+    }
+    if (opts->seeds && opts->rounds < 0) {
+        printf("Random boards need --rounds\n");
+        exit(1);
+    }
+}
+
+/******************** Compare Names **********************/
+static int cmp_name(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/******************** Add File **********************
+ * add_file: Reads a board file's header and adds it to the list. The
+ *       file is closed again, the cells are read by whichever worker
+ *       runs its group, so only a few files are ever mapped at once.
+ * opts: The options (--rounds and --rule override the file's).
+ * path: The file, copied.
+ * boards, num, cap: The list, grown as needed.
+ * returns: void, exits if the file cannot be read.
+ ***************************************************************/
+
+static void add_file(const struct batch_opts *opts, const char *path,
+        struct batch_board **boards, int *num, int *cap) {
+    struct board_file f;
+    struct batch_board *bd;
+
+    if (board_file_open(path, &f)) {
+        exit(1);
+    }
+    if (*num == *cap) {
+        *cap = *cap ? *cap * 2 : 1024;
+        *boards = realloc(*boards, sizeof(**boards) * *cap);
+        if (!*boards) {
+            printf("malloc failed: boards\n");
+            exit(1);
+        }
+    }
+    bd = &(*boards)[(*num)++];
+    memset(bd, 0, sizeof(*bd));
+    bd->path = strdup(path);
+    bd->rows = f.rows;
+    bd->cols = f.cols;
+    bd->rounds = opts->rounds >= 0 ? opts->rounds : f.iters;
+    bd->rule = (f.has_rule && !opts->rule_given) ? f.rule : opts->rule;
+    board_file_close(&f);
+    if (!bd->path) {
+        printf("malloc failed: boards\n");
+        exit(1);
+    }
+    if (bd->rounds < 0) {
+        printf("%s has no rounds, give --rounds\n", path);
+        exit(1);
+    }
+}
+
+/******************** Make Boards **********************
+ * make_boards: Lists the boards: the files on the command line, then
+ *       the files in --dir (by name, dot files skipped), then the seeds.
+ * opts: The options.
+ * num: Set to the number of boards.
+ * returns: The boards, exits on a bad file.
+ ***************************************************************/
+
+struct batch_board *make_boards(const struct batch_opts *opts, int *num) {
+    struct batch_board *boards = NULL;
+    int cap = 0;
+
+    *num = 0;
+    for (int k = 0; k < opts->num_files; k++) {
+        add_file(opts, opts->files[k], &boards, num, &cap);
+    }
+
+    if (opts->dir) {
+        DIR *dir = opendir(opts->dir);
+        struct dirent *ent;
+        char **names = NULL, path[4096];
+        int num_names = 0, cap_names = 0;
+
+        if (!dir) {
+            printf("Error: failed to open directory: %s\n", opts->dir);
+            exit(1);
+        }
+        while ((ent = readdir(dir)) != NULL) {
+            if (ent->d_name[0] == '.') {
+                continue;
+            }
+            if (num_names == cap_names) {
+                cap_names = cap_names ? cap_names * 2 : 1024;
+                names = realloc(names, sizeof(char *) * cap_names);
+            }
+            if (!names || !(names[num_names++] = strdup(ent->d_name))) {
+                printf("malloc failed: names\n");
+                exit(1);
+            }
+        }
+        closedir(dir);
+
+        //readdir order is arbitrary, the output should not be
+        qsort(names, num_names, sizeof(char *), cmp_name);
+        for (int k = 0; k < num_names; k++) {
+            snprintf(path, sizeof(path), "%s/%s", opts->dir, names[k]);
+            add_file(opts, path, &boards, num, &cap);
+            free(names[k]);
+        }
+        free(names);
+    }
+
+    if (opts->seeds) {
+        int first = *num;
+
+        cap = *num + (int)(opts->seed_last - opts->seed_first) + 1;
+        boards = realloc(boards, sizeof(*boards) * cap);
+        if (!boards) {
+            printf("malloc failed: boards\n");
+            exit(1);
+        }
+        for (int k = first; k < cap; k++) {
+            struct batch_board *bd = &boards[k];
+
+            memset(bd, 0, sizeof(*bd));
+            bd->seed = opts->seed_first + (k - first);
+            bd->rows = opts->rows;
+            bd->cols = opts->cols;
+            bd->rounds = opts->rounds;
+            bd->rule = opts->rule;
+        }
+        *num = cap;
+    }
+    return boards;
+}
+
+/* the board list being sorted, qsort has no context argument */
+static const struct batch_board *sort_boards;
+
+/******************** Compare Boards **********************
+ * cmp_board: Orders board indices by size, rule and rounds, then by
+ *       index, so boards that can share a group are next to each other.
+ ***************************************************************/
+
+static int cmp_board(const void *a, const void *b) {
+    const struct batch_board *x = &sort_boards[*(const int *)a];
+    const struct batch_board *y = &sort_boards[*(const int *)b];
+
+    if (x->rows != y->rows) {
+        return x->rows < y->rows ? -1 : 1;
+    }
+    if (x->cols != y->cols) {
+        return x->cols < y->cols ? -1 : 1;
+    }
+    if (x->rule != y->rule) {
+        return x->rule < y->rule ? -1 : 1;
+    }
+    if (x->rounds != y->rounds) {
+        return x->rounds < y->rounds ? -1 : 1;
+    }
+    return *(const int *)a - *(const int *)b;
+}
+
+/* 1 if two boards can be simulated in the same group */
+static int same_group(const struct batch_board *x,
+        const struct batch_board *y) {
+    return x->rows == y->rows && x->cols == y->cols && x->rule == y->rule
+        && x->rounds == y->rounds;
+}
+
+/******************** Make Groups **********************
+ * make_groups: Sorts the boards and cuts them into groups of up to 64
+ *       boards that share a size, rule and rounds.
+ * b: The batch, order and groups are filled in.
+ * returns: void.
+ ***************************************************************/
+
+void make_groups(struct batch *b) {
+    b->order = malloc(sizeof(int) * (b->num_boards + 1));
+    b->groups = malloc(sizeof(struct batch_group) * (b->num_boards + 1));
+    if (!b->order || !b->groups) {
+        printf("malloc failed: groups\n");
+        exit(1);
+    }
+    for (int k = 0; k < b->num_boards; k++) {
+        b->order[k] = k;
+    }
+    sort_boards = b->boards;
+    qsort(b->order, b->num_boards, sizeof(int), cmp_board);
+
+    b->num_groups = 0;
+    for (int k = 0; k < b->num_boards; k++) {
+        struct batch_group *g = &b->groups[b->num_groups];
+
+        if (k > 0 && g[-1].num < BATCH_LANES
+                && same_group(&b->boards[b->order[k-1]],
+                    &b->boards[b->order[k]])) {
+            g[-1].num++;
+            continue;
+        }
+        g->first = k;
+        g->num = 1;
+        b->num_groups++;
+    }
+}
+
+/******************** Random Number **********************
+ * next_random: splitmix64, the same generator as gol_bench, so seed S
+ *       here is the board gol_bench writes with --seed=S.
+ * state: The generator state, advanced.
+ * returns: 64 random bits.
+ ***************************************************************/
+
+static uint64_t next_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* where a file's cells go: its lane of the group's generation */
+struct lane_ctx {
+    uint64_t *cells;
+    int cols;
+    uint64_t bit;
+};
+
+static void set_lane_cell(void *ctx, long i, long j) {
+    struct lane_ctx *l = ctx;
+
+    l->cells[i * l->cols + j] |= l->bit;
+}
+
+/******************** Load Lane **********************
+ * load_lane: Puts one board's starting cells in its lane.
+ * opts: The options (density for random boards).
+ * bd: The board.
+ * cells: The group's generation 0, rows x cols words.
+ * lane: The board's bit.
+ * returns: void, exits if its file is bad.
+ ***************************************************************/
+
+static void load_lane(const struct batch_opts *opts,
+        const struct batch_board *bd, uint64_t *cells, int lane) {
+    long size = (long)bd->rows * bd->cols;
+    uint64_t bit = (uint64_t)1 << lane;
+
+    if (bd->path) {
+        struct board_file f;
+        struct lane_ctx l = {cells, bd->cols, bit};
+
+        if (board_file_open(bd->path, &f)
+                || board_file_cells(&f, 0, 1, 0, set_lane_cell, &l) < 0) {
+            exit(1);
+        }
+        board_file_close(&f);
+    }
+    else {
+        uint64_t state = bd->seed;
+        uint64_t cut = (opts->density >= 1) ? UINT64_MAX
+            : (uint64_t)(opts->density * 18446744073709551616.0);
+
+        for (long k = 0; k < size; k++) {
+            if (next_random(&state) < cut) {
+                cells[k] |= bit;
+            }
+        }
+    }
+}
+
+/******************** Step Cells **********************
+ * step_cells: Computes the next generation of every board in a group.
+ *       Always inlined, so each call with a constant rule is a kernel of
+ *       its own (as in bitboard.c). Interior columns read their
+ *       neighbors straight, so the loop vectorizes; the edge columns wrap.
+ * cur: The current generation, rows x cols words, one bit per board.
+ * next: Where the next generation goes.
+ * rows, cols: The board size, edges wrap around.
+ * rule: The rule, see rule.h.
+ * returns: void.
+ ***************************************************************/
+
+static inline __attribute__((always_inline)) void step_cells(
+        const uint64_t *cur, uint64_t *next, int rows, int cols,
+        uint32_t rule) {
+    for (int i = 0; i < rows; i++) {
+        const uint64_t *up = cur + (long)((i - 1 + rows) % rows) * cols;
+        const uint64_t *mid = cur + (long)i * cols;
+        const uint64_t *down = cur + (long)((i + 1) % rows) * cols;
+        uint64_t *out = next + (long)i * cols;
+
+        for (int j = 1; j < cols - 1; j++) {
+            out[j] = bitboard_rule_word(up[j-1], up[j], up[j+1],
+                    mid[j-1], mid[j], mid[j+1],
+                    down[j-1], down[j], down[j+1], rule);
+        }
+        //column 0 and cols-1 (the same column on a 1 wide board)
+        for (int j = 0; j < cols; j += (cols > 1) ? cols - 1 : 1) {
+            int w = (j - 1 + cols) % cols, e = (j + 1) % cols;
+
+            out[j] = bitboard_rule_word(up[w], up[j], up[e],
+                    mid[w], mid[j], mid[e],
+                    down[w], down[j], down[e], rule);
+        }
+    }
+}
+
+/******************** Step Group **********************
+ * step_group: step_cells, with the common rules specialized.
+ ***************************************************************/
+
+static void step_group(const uint64_t *cur, uint64_t *next, int rows,
+        int cols, uint32_t rule) {
+    switch (rule) {
+        case RULE_LIFE:
+            step_cells(cur, next, rows, cols, RULE_LIFE);
+            break;
+        case RULE_HIGHLIFE:
+            step_cells(cur, next, rows, cols, RULE_HIGHLIFE);
+            break;
+        case RULE_DAY_NIGHT:
+            step_cells(cur, next, rows, cols, RULE_DAY_NIGHT);
+            break;
+        case RULE_SEEDS:
+            step_cells(cur, next, rows, cols, RULE_SEEDS);
+            break;
+        default:
+            step_cells(cur, next, rows, cols, rule);
+            break;
+    }
+}
+
+/******************** Lane Differences **********************
+ * lane_diff: Which boards differ between two generations.
+ * a, b: The generations, size words each.
+ * returns: Bit b set if board b differs.
+ ***************************************************************/
+
+static uint64_t lane_diff(const uint64_t *a, const uint64_t *b, long size) {
+    uint64_t diff = 0;
+
+    for (long k = 0; k < size; k++) {
+        diff |= a[k] ^ b[k];
+    }
+    return diff;
+}
+
+/******************** Lane Population **********************
+ * lane_live: Counts the live cells of every board in a generation.
+ * cells: The generation, size words.
+ * live: Set to each board's count.
+ * returns: void.
+ ***************************************************************/
+
+static void lane_live(const uint64_t *cells, long size,
+        long live[BATCH_LANES]) {
+    memset(live, 0, sizeof(long) * BATCH_LANES);
+    for (long k = 0; k < size; k++) {
+        uint64_t w = cells[k];
+
+        while (w) {
+            live[__builtin_ctzll(w)]++;
+            w &= w - 1;
+        }
+    }
+}
+
+/* generations a group keeps: period back, and always the current and next */
+static int batch_ring(int period) {
+    return period + 1 > 2 ? period + 1 : 2;
+}
+
+/******************** Run Group **********************
+ * run_group: Loads a group's boards into their lanes and steps them,
+ *       checking after every round which boards repeat a generation up
+ *       to --period rounds back, and stopping when all of them have.
+ * b: The batch.
+ * g: The group.
+ * gens: Room for --period+1 generations of the group's board size.
+ * returns: void, the results go in the group's boards.
+ ***************************************************************/
+
+void run_group(struct batch *b, const struct batch_group *g,
+        uint64_t *gens) {
+    const struct batch_board *first = &b->boards[b->order[g->first]];
+    int rows = first->rows, cols = first->cols, rounds = first->rounds;
+    int period = b->opts->period, ring = batch_ring(period);
+    long size = (long)rows * cols;
+    uint64_t used = (g->num == BATCH_LANES) ? ~(uint64_t)0
+        : ((uint64_t)1 << g->num) - 1;
+    uint64_t open = used; //boards that have not settled
+    long settled[BATCH_LANES], live[BATCH_LANES];
+    int periods[BATCH_LANES], last[BATCH_LANES];
+    int gen = 0;
+
+    memset(gens, 0, sizeof(uint64_t) * size);
+    for (int l = 0; l < g->num; l++) {
+        load_lane(b->opts, &b->boards[b->order[g->first + l]], gens, l);
+    }
+
+    //generation t is gens[t % ring]
+    while (gen < rounds && open) {
+        const uint64_t *cur = gens + (gen % ring) * size;
+        uint64_t *next = gens + ((gen + 1) % ring) * size;
+
+        step_group(cur, next, rows, cols, first->rule);
+        gen++;
+        //the smallest p a board repeats with is its period
+        for (int p = 1; p <= period && p <= gen; p++) {
+            uint64_t same = open & ~lane_diff(next,
+                    gens + ((gen - p) % ring) * size, size);
+
+            for (uint64_t w = same; w; w &= w - 1) {
+                int l = __builtin_ctzll(w);
+
+                settled[l] = gen - p;
+                periods[l] = p;
+            }
+            open &= ~same;
+        }
+    }
+
+    __atomic_fetch_add(&b->cell_rounds, (long)gen * size * g->num,
+            __ATOMIC_RELAXED);
+
+    //a board that settled is in its cycle from then on, so its last
+    //round is whichever of the ring's generations is the same point in it
+    for (int l = 0; l < g->num; l++) {
+        struct batch_board *bd = &b->boards[b->order[g->first + l]];
+
+        bd->settled = -1;
+        bd->period = 0;
+        last[l] = gen;
+        if (!((open >> l) & 1)) {
+            bd->settled = settled[l];
+            bd->period = periods[l];
+            last[l] = gen - (bd->period - (rounds - gen) % bd->period)
+                % bd->period;
+        }
+    }
+    for (int k = gen - period; k <= gen; k++) {
+        int counted = 0;
+
+        for (int l = 0; l < g->num; l++) {
+            if (last[l] != k) {
+                continue;
+            }
+            if (!counted) {
+                lane_live(gens + (k % ring) * size, size, live);
+                counted = 1;
+            }
+            b->boards[b->order[g->first + l]].live = live[l];
+        }
+    }
+}
+
+/******************** Batch Worker **********************
+ * batch_worker: Takes groups off the shared counter and runs them, with
+ *       one ring of generations reused for every group it runs.
+ * arg: The batch.
+ * returns: NULL.
+ ***************************************************************/
+
+void *batch_worker(void *arg) {
+    struct batch *b = arg;
+    uint64_t *gens = NULL;
+    long have = 0;
+    int k;
+
+    while ((k = __atomic_fetch_add(&b->next_group, 1, __ATOMIC_RELAXED))
+            < b->num_groups) {
+        const struct batch_group *g = &b->groups[k];
+        const struct batch_board *bd = &b->boards[b->order[g->first]];
+        long need = (long)bd->rows * bd->cols * batch_ring(b->opts->period);
+
+        if (need > have) {
+            free(gens);
+            gens = aligned_alloc(64, ((need * sizeof(uint64_t)) + 63)
+                    & ~(size_t)63);
+            if (!gens) {
+                printf("malloc failed: generations\n");
+                exit(1);
+            }
+            have = need;
+        }
+        run_group(b, g, gens);
+    }
+    free(gens);
+    return NULL;
+}
+
+/******************** Write Results **********************
+ * write_results: Writes one CSV line per board, in input order.
+ * opts: The options (out).
+ * boards, num: The boards.
+ * returns: void, exits if the file cannot be written.
+ ***************************************************************/
+
+void write_results(const struct batch_opts *opts,
+        const struct batch_board *boards, int num) {
+    FILE *out = opts->out ? fopen(opts->out, "w") : stdout;
+
+    if (!out) {
+        printf("Error: failed to open file: %s\n", opts->out);
+        exit(1);
+    }
+    fprintf(out, "board,rows,cols,rounds,live,settled,period\n");
+    for (int k = 0; k < num; k++) {
+        const struct batch_board *bd = &boards[k];
+
+        if (bd->path) {
+            fprintf(out, "%s,", bd->path);
+        }
+        else {
+            fprintf(out, "%llu,", (unsigned long long)bd->seed);
+        }
+        fprintf(out, "%d,%d,%d,%ld,%ld,%d\n", bd->rows, bd->cols,
+                bd->rounds, bd->live, bd->settled, bd->period);
+    }
+    if ((opts->out && fclose(out)) || (!opts->out && fflush(out))) {
+        printf("Error: failed to write file: %s\n",
+                opts->out ? opts->out : "stdout");
+        exit(1);
+    }
+}
@@ -0,0 +1,735 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Benchmark driver for gol. For every board size it writes one random
+ * board, then runs gol on it once for each kernel, partitioning and
+ * thread count asked for. gol times each round itself (--times, from a
+ * monotonic clock, after its threads are made and the board is loaded),
+ * so process start, file loading and thread creation are not measured.
+ * The first rounds of a run are dropped as warmup and the rest give the
+ * median and 5th/95th percentile cells per second of the configuration,
+ * and its speedup and parallel efficiency over the fewest threads run.
+ *
+ * To run:
+ * ./gol_bench                                  # the default sweep, CSV
+ * ./gol_bench --sizes=4096 --threads=1,2,4,8 --kernels=bitpack
+ * ./gol_bench --format=json --out=bench.json
+ * ./gol_bench --baseline=old.csv               # exit 2 on a regression
+ * ./gol_bench --kernels=int -- -H              # options after -- go to gol
+ *
+ * Options:
+ * --gol=PATH              the gol to run (default ./gol_headless)
+ * --sizes=N|RxC,...       board sizes (default 1024,2048)
+ * --threads=T,...         thread counts (default 1,2,4)
+ * --partitions=P,...      rows, cols or tiles (or 0, 1, 2; default all)
+ * --kernels=K,...         int, bitpack or simd (default all)
+ * --density=D             chance each cell starts alive (default 0.3)
+ * --rounds=N              rounds per run (default 20)
+ * --warmup=W              leading rounds not counted (default 2)
+ * --seed=S                random board seed (default 1)
+ * --format=csv|json       output format (default csv)
+ * --out=FILE              where the results go (default stdout)
+ * --dir=DIR               where boards and times are written (default /tmp)
+ * --baseline=FILE         a CSV from an earlier run to compare against
+ * --tolerance=PCT         median drop counted as a regression (default 10)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+/* most values one list option takes */
+#define BENCH_MAX_LIST (32)
+
+/* defaults for the options above */
+#define DEFAULT_GOL       "./gol_headless"
+#define DEFAULT_DIR       "/tmp"
+#define DEFAULT_DENSITY   (0.3)
+#define DEFAULT_ROUNDS    (20)
+#define DEFAULT_WARMUP    (2)
+#define DEFAULT_TOLERANCE (10.0)
+
+/* exit status when a configuration got slower than the baseline */
+#define EXIT_REGRESSION (2)
+
+/* getopt ids, every option is long only */
+enum {
+    OPT_GOL = 256, OPT_SIZES, OPT_THREADS, OPT_PARTITIONS, OPT_KERNELS,
+    OPT_DENSITY, OPT_ROUNDS, OPT_WARMUP, OPT_SEED, OPT_FORMAT, OPT_OUT,
+    OPT_DIR, OPT_BASELINE, OPT_TOLERANCE
+};
+
+/* gol's names for its kernels (-k) and partitionings (argv[4]) */
+static const char *kernel_names[] = {"int", "bitpack", "simd"};
+static const char *part_names[] = {"rows", "cols", "tiles"};
+
+/* what to sweep, from the command line */
+struct bench_opts {
+    const char *gol;
+    int rows[BENCH_MAX_LIST], cols[BENCH_MAX_LIST];
+    int num_sizes;
+    int threads[BENCH_MAX_LIST];
+    int num_threads;
+    int parts[BENCH_MAX_LIST];
+    int num_parts;
+    int kernels[BENCH_MAX_LIST];
+    int num_kernels;
+    double density;
+    int rounds;
+    int warmup;
+    uint64_t seed;
+    int json;
+    const char *out;
+    const char *dir;
+    const char *baseline;
+    double tolerance;
+    char **extra; //options passed through to gol
+    int num_extra;
+};
+
+/* one configuration's measurements, all rates in cells per second */
+struct bench_result {
+    int rows, cols, kernel, part, threads;
+    int samples; //rounds counted
+    double median, p5, p95;
+    double speedup; //median over the fewest threads' median, 0 if none
+    double efficiency; //speedup per added thread, 1 is linear
+};
+
+/****************** Function Prototypes **********************/
+
+/* read the options into opts, exits on a bad one */
+void parse_bench_options(struct bench_opts *opts, int argc, char **argv);
+
+/* parse a comma separated list with parse_item, returns its length */
+int parse_list(const char *text, int *out, int *out2,
+        int (*parse_item)(const char *item, int *v, int *v2));
+
+/* write a rows x cols random board in the gol text format */
+void write_board(const char *path, int rows, int cols, double density,
+        uint64_t seed);
+
+/* run gol once and measure it, returns 0 or -1 if the run failed */
+int run_config(const struct bench_opts *opts, const char *board,
+        struct bench_result *res);
+
+/* fill in speedup and efficiency from the fewest threads of each config */
+void add_scaling(struct bench_result *res, int num);
+
+/* write the results as CSV or JSON */
+void write_results(const struct bench_opts *opts,
+        const struct bench_result *res, int num);
+
+/* compare medians with a baseline CSV, returns the regressions found */
+int compare_baseline(const struct bench_opts *opts,
+        const struct bench_result *res, int num);
+
+/**************************************************************/
+
+int main(int argc, char **argv) {
+    struct bench_opts opts;
+    struct bench_result *res;
+    int num = 0, regressions = 0;
+    char board[4096];
+
+    parse_bench_options(&opts, argc, argv);
+    res = malloc(sizeof(*res) * opts.num_sizes * opts.num_kernels
+            * opts.num_parts * opts.num_threads);
+    if (!res) {
+        printf("malloc failed: results\n");
+        exit(1);
+    }
+
+    for (int s = 0; s < opts.num_sizes; s++) {
+        int rows = opts.rows[s], cols = opts.cols[s];
+
+        snprintf(board, sizeof(board), "%s/gol_bench_%d.txt", opts.dir,
+                (int)getpid());
+        write_board(board, rows, cols, opts.density, opts.seed);
+
+        for (int k = 0; k < opts.num_kernels; k++) {
+            for (int p = 0; p < opts.num_parts; p++) {
+                //bit-packed rows are only ever split by row
+                if (opts.kernels[k] == 1 && opts.parts[p] != 0) {
+                    continue;
+                }
+                for (int t = 0; t < opts.num_threads; t++) {
+                    struct bench_result *r = &res[num];
+
+                    if (opts.threads[t] > rows || opts.threads[t] > cols) {
+                        continue;
+                    }
+                    r->rows = rows;
+                    r->cols = cols;
+                    r->kernel = opts.kernels[k];
+                    r->part = opts.parts[p];
+                    r->threads = opts.threads[t];
+                    if (run_config(&opts, board, r) == 0) {
+                        fprintf(stderr, "%dx%d %s %s %d threads: %.4g cells/s"
+                                " (p5 %.4g, p95 %.4g)\n", rows, cols,
+                                kernel_names[r->kernel], part_names[r->part],
+                                r->threads, r->median, r->p5, r->p95);
+                        num++;
+                    }
+                }
+            }
+        }
+        unlink(board);
+    }
+
+    add_scaling(res, num);
+    write_results(&opts, res, num);
+    if (opts.baseline) {
+        regressions = compare_baseline(&opts, res, num);
+    }
+    free(res);
+    return regressions ? EXIT_REGRESSION : 0;
+}
+
+/******************** Parse Size **********************
+ * parse_size: Reads a board size, N (square) or RxC.
+ * item: The text.
+ * v, v2: Set to the rows and columns.
+ * returns: 0, or -1 if it is not a size.
+ ***************************************************************/
+
+static int parse_size(const char *item, int *v, int *v2) {
+    if (sscanf(item, "%dx%d", v, v2) == 2) {
+        return (*v > 0 && *v2 > 0) ? 0 : -1;
+    }
+    if (sscanf(item, "%d", v) == 1 && *v > 0) {
+        *v2 = *v;
+        return 0;
+    }
+    return -1;
+}
+
+/******************** Parse Count **********************
+ * parse_count: Reads a positive integer list item.
+ ***************************************************************/
+
+static int parse_count(const char *item, int *v, int *v2) {
+    return (sscanf(item, "%d", v) == 1 && *v > 0) ? 0 : -1;
+}
+
+/******************** Parse Name **********************
+ * parse_name: Reads a name out of a table, or its index.
+ * names: The table, 3 entries (the kernels or the partitionings).
+ ***************************************************************/
+
+static int parse_name(const char *item, const char **names, int *v) {
+    for (int n = 0; n < 3; n++) {
+        if (strcmp(item, names[n]) == 0) {
+            *v = n;
+            return 0;
+        }
+    }
+    if (item[0] >= '0' && item[0] <= '2' && item[1] == '\0') {
+        *v = item[0] - '0';
+        return 0;
+    }
+    return -1;
+}
+
+static int parse_kernel(const char *item, int *v, int *v2) {
+    return parse_name(item, kernel_names, v);
+}
+
+static int parse_part(const char *item, int *v, int *v2) {
+    return parse_name(item, part_names, v);
+}
+
+/******************** Parse List **********************
+ * parse_list: Splits a comma separated option value and parses each item.
+ * text: The value.
+ * out, out2: Where each item's values go (out2 only for sizes).
+ * parse_item: Parses one item, returns 0 or -1.
+ * returns: The number of items, exits if one is bad.
+ ***************************************************************/
+
+int parse_list(const char *text, int *out, int *out2,
+        int (*parse_item)(const char *item, int *v, int *v2)) {
+    char item[64];
+    int n = 0;
+
+    while (*text) {
+        size_t len = strcspn(text, ",");
+        int dummy;
+
+        if (len == 0 || len >= sizeof(item) || n == BENCH_MAX_LIST) {
+            printf("Bad list: %s\n", text);
+            exit(1);
+        }
+        memcpy(item, text, len);
+        item[len] = '\0';
+        if (parse_item(item, &out[n], out2 ? &out2[n] : &dummy)) {
+            printf("Bad list item: %s\n", item);
+            exit(1);
+        }
+        n++;
+        text += len;
+        if (*text == ',') {
+            text++;
+        }
+    }
+    if (n == 0) {
+        printf("Empty list\n");
+        exit(1);
+    }
+    return n;
+}
+
+/******************** Parse Options **********************
+ * parse_bench_options: Reads the options, see the top of the file.
+ *       Everything after -- is passed to every gol run.
+ * opts: Filled in, defaults first.
+ * argc, argv: The command line.
+ * returns: void.
+ ***************************************************************/
+
+void parse_bench_options(struct bench_opts *opts, int argc, char **argv) {
+    static struct option long_opts[] = {
+        {"gol", required_argument, NULL, OPT_GOL},
+        {"sizes", required_argument, NULL, OPT_SIZES},
+        {"threads", required_argument, NULL, OPT_THREADS},
+        {"partitions", required_argument, NULL, OPT_PARTITIONS},
+        {"kernels", required_argument, NULL, OPT_KERNELS},
+        {"density", required_argument, NULL, OPT_DENSITY},
+        {"rounds", required_argument, NULL, OPT_ROUNDS},
+        {"warmup", required_argument, NULL, OPT_WARMUP},
+        {"seed", required_argument, NULL, OPT_SEED},
+        {"format", required_argument, NULL, OPT_FORMAT},
+        {"out", required_argument, NULL, OPT_OUT},
+        {"dir", required_argument, NULL, OPT_DIR},
+        {"baseline", required_argument, NULL, OPT_BASELINE},
+        {"tolerance", required_argument, NULL, OPT_TOLERANCE},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+
+    //defaults
+    memset(opts, 0, sizeof(*opts));
+    opts->gol = DEFAULT_GOL;
+    opts->num_sizes = parse_list("1024,2048", opts->rows, opts->cols,
+            parse_size);
+    opts->num_threads = parse_list("1,2,4", opts->threads, NULL,
+            parse_count);
+    opts->num_parts = parse_list("rows,cols,tiles", opts->parts, NULL,
+            parse_part);
+    opts->num_kernels = parse_list("int,bitpack,simd", opts->kernels, NULL,
+            parse_kernel);
+    opts->density = DEFAULT_DENSITY;
+    opts->rounds = DEFAULT_ROUNDS;
+    opts->warmup = DEFAULT_WARMUP;
+    opts->seed = 1;
+    opts->dir = DEFAULT_DIR;
+    opts->tolerance = DEFAULT_TOLERANCE;
+
+    while ((opt = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case OPT_GOL:
+                opts->gol = optarg;
+                break;
+            case OPT_SIZES:
+                opts->num_sizes = parse_list(optarg, opts->rows, opts->cols,
+                        parse_size);
+                break;
+            case OPT_THREADS:
+                opts->num_threads = parse_list(optarg, opts->threads, NULL,
+                        parse_count);
+                break;
+            case OPT_PARTITIONS:
+                opts->num_parts = parse_list(optarg, opts->parts, NULL,
+                        parse_part);
+                break;
+            case OPT_KERNELS:
+                opts->num_kernels = parse_list(optarg, opts->kernels, NULL,
+                        parse_kernel);
+                break;
+            case OPT_DENSITY:
+                opts->density = atof(optarg);
+                if (opts->density < 0 || opts->density > 1) {
+                    printf("Bad density: %s (use 0 to 1)\n", optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_ROUNDS:
+                opts->rounds = atoi(optarg);
+                break;
+            case OPT_WARMUP:
+                opts->warmup = atoi(optarg);
+                break;
+            case OPT_SEED:
+                opts->seed = strtoull(optarg, NULL, 10);
+                break;
+            case OPT_FORMAT:
+                if (strcmp(optarg, "csv") == 0) {
+                    opts->json = 0;
+                }
+                else if (strcmp(optarg, "json") == 0) {
+                    opts->json = 1;
+                }
+                else {
+                    printf("Unknown format: %s (csv or json)\n", optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_OUT:
+                opts->out = optarg;
+                break;
+            case OPT_DIR:
+                opts->dir = optarg;
+                break;
+            case OPT_BASELINE:
+                opts->baseline = optarg;
+                break;
+            case OPT_TOLERANCE:
+                opts->tolerance = atof(optarg);
+                break;
+            default:
+                exit(1);
+        }
+    }
+    if (opts->warmup < 0 || opts->rounds <= opts->warmup) {
+        printf("Need more rounds (%d) than warmup rounds (%d)\n",
+                opts->rounds, opts->warmup);
+        exit(1);
+    }
+    opts->extra = argv + optind;
+    opts->num_extra = argc - optind;
+}
+
+/******************** Random Number **********************
+ * next_random: splitmix64, enough for a reproducible random board.
+ * state: The generator state, advanced.
+ * returns: 64 random bits.
+ ***************************************************************/
+
+static uint64_t next_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/******************** Write Board **********************
+ * write_board: Writes a random board in the gol text format, each cell
+ *       alive with chance density. The live count is only known at the
+ *       end, so the header is written padded and filled in last.
+ * path: The file to write.
+ * rows, cols: The board size.
+ * density: Chance a cell is alive.
+ * seed: The same seed always gives the same board.
+ * returns: void, exits if the file cannot be written.
+ ***************************************************************/
+
+void write_board(const char *path, int rows, int cols, double density,
+        uint64_t seed) {
+    FILE *out = fopen(path, "w");
+    uint64_t state = seed;
+    uint64_t cut = (density >= 1) ? UINT64_MAX
+        : (uint64_t)(density * 18446744073709551616.0);
+    long live = 0;
+
+    if (!out) {
+        printf("Error: failed to open file: %s\n", path);
+        exit(1);
+    }
+    //rounds come from gol's -n, the count is rewritten below
+    fprintf(out, "%d\n%d\n0\n%20ld\n", rows, cols, 0L);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            if (next_random(&state) < cut) {
+                fprintf(out, "%d %d\n", i, j);
+                live++;
+            }
+        }
+    }
+    if (fseek(out, 0, SEEK_SET) || fprintf(out, "%d\n%d\n0\n%20ld\n", rows,
+                cols, live) < 0 || fclose(out)) {
+        printf("Error: failed to write file: %s\n", path);
+        exit(1);
+    }
+}
+
+/******************** Compare Doubles **********************/
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/******************** Percentile **********************
+ * percentile: Linear interpolation between the closest ranks.
+ * sorted: The samples, ascending.
+ * n: How many, at least 1.
+ * q: The percentile, 0 to 100.
+ * returns: The value at q.
+ ***************************************************************/
+
+static double percentile(const double *sorted, int n, double q) {
+    double pos = q / 100 * (n - 1);
+    int lo = (int)pos;
+
+    if (lo >= n - 1) {
+        return sorted[n-1];
+    }
+    return sorted[lo] + (pos - lo) * (sorted[lo+1] - sorted[lo]);
+}
+
+/******************** Run Configuration **********************
+ * run_config: Runs gol on the board with res's kernel, partitioning and
+ *       threads, output mode 0, and reads back the time of every round.
+ *       gol's own output is dropped.
+ * opts: The options (gol, rounds, warmup, extra options).
+ * board: The board file.
+ * res: The configuration in, its measurements out.
+ * returns: 0, or -1 (with a message) if gol failed.
+ ***************************************************************/
+
+int run_config(const struct bench_opts *opts, const char *board,
+        struct bench_result *res) {
+    char times[4096], threads[16], part[16], rounds[16], times_opt[4200];
+    char **args = malloc(sizeof(char *) * (12 + opts->num_extra));
+    double *cps = malloc(sizeof(double) * opts->rounds);
+    long cells = (long)res->rows * res->cols;
+    int n = 0, status, round;
+    double secs;
+    FILE *in;
+    pid_t pid;
+
+    if (!args || !cps) {
+        printf("malloc failed: run\n");
+        exit(1);
+    }
+    snprintf(times, sizeof(times), "%s/gol_bench_%d.times", opts->dir,
+            (int)getpid());
+    snprintf(times_opt, sizeof(times_opt), "--times=%s", times);
+    snprintf(threads, sizeof(threads), "%d", res->threads);
+    snprintf(part, sizeof(part), "%d", res->part);
+    snprintf(rounds, sizeof(rounds), "%d", opts->rounds);
+    args[n++] = (char *)opts->gol;
+    args[n++] = (char *)board;
+    args[n++] = "0";
+    args[n++] = threads;
+    args[n++] = part;
+    args[n++] = "0";
+    args[n++] = "-k";
+    args[n++] = (char *)kernel_names[res->kernel];
+    args[n++] = "-n";
+    args[n++] = rounds;
+    args[n++] = times_opt;
+    for (int e = 0; e < opts->num_extra; e++) {
+        args[n++] = opts->extra[e];
+    }
+    args[n] = NULL;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+
+        if (null >= 0) {
+            dup2(null, STDOUT_FILENO);
+        }
+        execv(opts->gol, args);
+        perror(opts->gol);
+        _exit(127);
+    }
+    free(args);
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+            || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%dx%d %s %s %d threads: gol failed, skipped\n",
+                res->rows, res->cols, kernel_names[res->kernel],
+                part_names[res->part], res->threads);
+        free(cps);
+        unlink(times);
+        return -1;
+    }
+
+    //round r took secs, the first warmup rounds are dropped
+    in = fopen(times, "r");
+    if (!in) {
+        printf("Error: failed to open file: %s\n", times);
+        exit(1);
+    }
+    n = 0;
+    while (fscanf(in, "%d %lf", &round, &secs) == 2) {
+        if (round > opts->warmup && secs > 0 && n < opts->rounds) {
+            cps[n++] = cells / secs;
+        }
+    }
+    fclose(in);
+    unlink(times);
+    if (n == 0) {
+        fprintf(stderr, "%dx%d %s %s %d threads: no rounds timed, skipped\n",
+                res->rows, res->cols, kernel_names[res->kernel],
+                part_names[res->part], res->threads);
+        free(cps);
+        return -1;
+    }
+
+    qsort(cps, n, sizeof(double), cmp_double);
+    res->samples = n;
+    res->median = percentile(cps, n, 50);
+    res->p5 = percentile(cps, n, 5);
+    res->p95 = percentile(cps, n, 95);
+    res->speedup = 0;
+    res->efficiency = 0;
+    free(cps);
+    return 0;
+}
+
+/******************** Add Scaling **********************
+ * add_scaling: Compares each result with the same size, kernel and
+ *       partitioning run on the fewest threads: speedup is the ratio of
+ *       their medians and efficiency is speedup over the ratio of their
+ *       threads (so with 1 thread as the base, speedup / threads).
+ * res: The results.
+ * num: How many.
+ * returns: void.
+ ***************************************************************/
+
+void add_scaling(struct bench_result *res, int num) {
+    for (int a = 0; a < num; a++) {
+        const struct bench_result *base = NULL;
+
+        for (int b = 0; b < num; b++) {
+            if (res[b].rows == res[a].rows && res[b].cols == res[a].cols
+                    && res[b].kernel == res[a].kernel
+                    && res[b].part == res[a].part
+                    && (!base || res[b].threads < base->threads)) {
+                base = &res[b];
+            }
+        }
+        res[a].speedup = res[a].median / base->median;
+        res[a].efficiency = res[a].speedup * base->threads / res[a].threads;
+    }
+}
+
+/******************** Write Results **********************
+ * write_results: Writes one CSV line or JSON object per configuration,
+ *       to opts->out or stdout.
+ * opts: The options (format, out, rounds, warmup, density).
+ * res: The results.
+ * num: How many.
+ * returns: void.
+ ***************************************************************/
+
+void write_results(const struct bench_opts *opts,
+        const struct bench_result *res, int num) {
+    FILE *out = opts->out ? fopen(opts->out, "w") : stdout;
+
+    if (!out) {
+        printf("Error: failed to open file: %s\n", opts->out);
+        exit(1);
+    }
+    if (!opts->json) {
+        fprintf(out, "rows,cols,kernel,partition,threads,density,rounds,"
+                "warmup,samples,median_cps,p5_cps,p95_cps,speedup,"
+                "efficiency\n");
+    }
+    else {
+        fprintf(out, "[\n");
+    }
+    for (int k = 0; k < num; k++) {
+        const struct bench_result *r = &res[k];
+
+        if (!opts->json) {
+            fprintf(out, "%d,%d,%s,%s,%d,%g,%d,%d,%d,%.6e,%.6e,%.6e,%.4f,"
+                    "%.4f\n", r->rows, r->cols, kernel_names[r->kernel],
+                    part_names[r->part], r->threads, opts->density,
+                    opts->rounds, opts->warmup, r->samples, r->median, r->p5,
+                    r->p95, r->speedup, r->efficiency);
+        }
+        else {
+            fprintf(out, "  {\"rows\": %d, \"cols\": %d, \"kernel\": \"%s\","
+                    " \"partition\": \"%s\", \"threads\": %d,"
+                    " \"density\": %g, \"rounds\": %d, \"warmup\": %d,"
+                    " \"samples\": %d, \"median_cps\": %.6e,"
+                    " \"p5_cps\": %.6e, \"p95_cps\": %.6e,"
+                    " \"speedup\": %.4f, \"efficiency\": %.4f}%s\n",
+                    r->rows, r->cols, kernel_names[r->kernel],
+                    part_names[r->part], r->threads, opts->density,
+                    opts->rounds, opts->warmup, r->samples, r->median, r->p5,
+                    r->p95, r->speedup, r->efficiency,
+                    (k < num - 1) ? "," : "");
+        }
+    }
+    if (opts->json) {
+        fprintf(out, "]\n");
+    }
+    if (out != stdout && fclose(out)) {
+        printf("Error: failed to write file: %s\n", opts->out);
+        exit(1);
+    }
+}
+
+/******************** Compare Baseline **********************
+ * compare_baseline: Reads a CSV written by an earlier gol_bench and
+ *       reports every configuration whose median cells per second fell by
+ *       more than opts->tolerance percent. Configurations only in one of
+ *       the two runs are ignored.
+ * opts: The options (baseline, tolerance).
+ * res: This run's results.
+ * num: How many.
+ * returns: The number of regressions.
+ ***************************************************************/
+
+int compare_baseline(const struct bench_opts *opts,
+        const struct bench_result *res, int num) {
+    FILE *in = fopen(opts->baseline, "r");
+    char line[1024], kernel[16], part[16];
+    int rows, cols, threads, regressions = 0, matched = 0;
+    double median;
+
+    if (!in) {
+        printf("Error: failed to open file: %s\n", opts->baseline);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), in)) {
+        //rows,cols,kernel,partition,threads,density,rounds,warmup,samples,
+        //median_cps,...
+        if (sscanf(line, "%d,%d,%15[^,],%15[^,],%d,%*[^,],%*[^,],%*[^,],"
+                    "%*[^,],%lf", &rows, &cols, kernel, part, &threads,
+                    &median) != 6) {
+            continue;
+        }
+        for (int k = 0; k < num; k++) {
+            const struct bench_result *r = &res[k];
+            double change;
+
+            if (r->rows != rows || r->cols != cols || r->threads != threads
+                    || strcmp(kernel_names[r->kernel], kernel) != 0
+                    || strcmp(part_names[r->part], part) != 0) {
+                continue;
+            }
+            matched++;
+            change = (r->median - median) / median * 100;
+            if (change < -opts->tolerance) {
+                fprintf(stderr, "regression: %dx%d %s %s %d threads: %.4g ->"
+                        " %.4g cells/s (%.1f%%)\n", rows, cols, kernel, part,
+                        threads, median, r->median, change);
+                regressions++;
+            }
+        }
+    }
+    fclose(in);
+    fprintf(stderr, "%d of %d configurations compared with %s, %d slower by"
+            " more than %g%%\n", matched, num, opts->baseline, regressions,
+            opts->tolerance);
+    return regressions;
+}
@@ -0,0 +1,131 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Bit-packed board storage for the Game of Life.
+ * Each row is stored as ceil(cols/64) uint64_t words, bit k of word w
+ * holding column w*64+k. Bits past the last column are always kept 0.
+ */
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+#include "rule.h"
+
+/* number of 64-cell words used to store one row of cols cells */
+static inline int bitboard_words(int cols) {
+    return (cols + 63) / 64;
+}
+
+/* read the cell at (i, j), wpr is the number of words per row */
+static inline int bitboard_get(const uint64_t *board, int wpr, int i, int j) {
+    return (board[(long)i*wpr + (j >> 6)] >> (j & 63)) & 1;
+}
+
+/* set the cell at (i, j) to alive */
+static inline void bitboard_set(uint64_t *board, int wpr, int i, int j) {
+    board[(long)i*wpr + (j >> 6)] |= (uint64_t)1 << (j & 63);
+}
+
+/******************** Next State of 64 Cells **********************
+ * bitboard_life_word: Applies the B3/S23 rule to 64 cells at once.
+ * nw..se: The 8 neighbor words, already shifted so bit k of each
+ *         lines up with bit k of the center word c.
+ * returns: The next state of the 64 cells.
+ ***************************************************************/
+
+static inline uint64_t bitboard_life_word(uint64_t nw, uint64_t n,
+        uint64_t ne, uint64_t w, uint64_t c, uint64_t e,
+        uint64_t sw, uint64_t s, uint64_t se) {
+    uint64_t s_a, c_a, s_b, c_b, s_c, c_c, c_d, t, c_e, c_f;
+    uint64_t ones, twos, fours;
+
+    //full adders over the top row and the middle pair, half adder below
+    s_a = nw ^ n ^ ne;
+    c_a = (nw & n) | (ne & (nw ^ n));
+    s_b = w ^ e ^ sw;
+    c_b = (w & e) | (sw & (w ^ e));
+    s_c = s ^ se;
+    c_c = s & se;
+
+    //sum the three ones columns, carries go to the twos column
+    ones = s_a ^ s_b ^ s_c;
+    c_d = (s_a & s_b) | (s_c & (s_a ^ s_b));
+
+    //sum the four twos carries, carries go to the fours column
+    t = c_a ^ c_b ^ c_c;
+    c_e = (c_a & c_b) | (c_c & (c_a ^ c_b));
+    twos = t ^ c_d;
+    c_f = t & c_d;
+
+    //a count of 8 wraps to 0 here, which is dead either way
+    fours = c_e | c_f;
+
+    //alive with 3 neighbors, or with 2 if already alive
+    return twos & ~fours & (ones | c);
+}
+
+/******************** Next State of 64 Cells, Any Rule **********************
+ * bitboard_rule_word: Applies a Life-like rule to 64 cells at once. The
+ *       count is summed into four bit planes (8 no longer wraps to 0),
+ *       and each count 0..8 the rule uses is matched against them. With
+ *       rule a constant the unused counts fold away, which is how the
+ *       kernels make their specialized copies; B3/S23 uses the shorter
+ *       logic above.
+ * nw..se, c: As for bitboard_life_word.
+ * rule: The rule, see rule.h.
+ * returns: The next state of the 64 cells.
+ ***************************************************************/
+
+static inline __attribute__((always_inline)) uint64_t bitboard_rule_word(
+        uint64_t nw, uint64_t n, uint64_t ne, uint64_t w, uint64_t c,
+        uint64_t e, uint64_t sw, uint64_t s, uint64_t se, uint32_t rule) {
+    uint64_t s_a, c_a, s_b, c_b, s_c, c_c, c_d, t, c_e, c_f;
+    uint64_t plane[4], res = 0;
+
+    if (rule == RULE_LIFE) {
+        return bitboard_life_word(nw, n, ne, w, c, e, sw, s, se);
+    }
+
+    //the same adders as bitboard_life_word
+    s_a = nw ^ n ^ ne;
+    c_a = (nw & n) | (ne & (nw ^ n));
+    s_b = w ^ e ^ sw;
+    c_b = (w & e) | (sw & (w ^ e));
+    s_c = s ^ se;
+    c_c = s & se;
+    plane[0] = s_a ^ s_b ^ s_c;
+    c_d = (s_a & s_b) | (s_c & (s_a ^ s_b));
+    t = c_a ^ c_b ^ c_c;
+    c_e = (c_a & c_b) | (c_c & (c_a ^ c_b));
+    plane[1] = t ^ c_d;
+    c_f = t & c_d;
+    plane[2] = c_e ^ c_f;
+    plane[3] = c_e & c_f;
+
+    for (int k = 0; k <= 8; k++) {
+        uint64_t born = -(uint64_t)((rule >> k) & 1);
+        uint64_t stays = -(uint64_t)((rule >> (9 + k)) & 1);
+        uint64_t match = ~(uint64_t)0;
+
+        for (int b = 0; b < 4; b++) {
+            match &= ((k >> b) & 1) ? plane[b] : ~plane[b];
+        }
+        res |= match & ((born & ~c) | (stays & c));
+    }
+    return res;
+}
+
+/* allocate a zeroed rows x cols bit-packed board, NULL on failure */
+uint64_t *bitboard_alloc(int rows, int cols);
+
+/* compute rows row_start..row_end of the next generation from base into
+ * next (toroidal board) under rule, returns the number of live cells
+ * written */
+int bitboard_step_rows(const uint64_t *base, uint64_t *next, int rows,
+        int cols, int row_start, int row_end, uint32_t rule);
+
+#endif
@@ -16,16 +16,66 @@
  * ./gol file1.txt  1  # run with config file file1.txt, ascii animation
  * ./gol file1.txt  2  # run with config file file1.txt, ParaVis animation
  *
+ * Options after the positional args:
+ * -k, --kernel=int|bitpack|simd   cell update kernel (default int)
+ * -r, --rule=RULE                  Life-like rule, like B36/S23 (default
+ *                                  B3/S23, or the file's rule)
+ * -i, --isa=auto|sse2|avx2|avx512  force the simd kernel's instruction set
+ * -H, --halo                       pad int boards with a one-cell halo
+ * --tile-size=RxC                  tile size for argv[4] = 2 (default: L2)
+ * -s, --steal                      argv[4] = 2: idle threads steal tiles
+ * -A, --active                     argv[4] = 2: skip tiles that cannot change
+ * -e, --engine=threads|hashlife|sparse  generation engine (default threads)
+ * --hl-mem=MB                      hashlife node cache cap (default 512)
+ * -u, --unbounded                  sparse engine: infinite plane, no torus
+ * -P, --population=FILE            write the live cells after every round
+ * --sync=barrier|neighbor          argv[4] = 0 or 1: how rounds are ordered
+ * -T, --temporal=K                 argv[4] = 0: K rounds per pass over memory
+ * -C, --checkpoint=N               write a snapshot every N rounds
+ * --checkpoint-file=PATH           where to write it (default gol.snap)
+ * -n, --rounds=N                   run to round N, not the file's count
+ * --pin=compact|scatter|CPUS       pin each thread to a CPU
+ * --times=FILE                     write the seconds every round took
+ * --trace=FILE                     write a per-thread timeline (JSON)
+ * --trace-counters                 add hardware counters to the trace
+ * --cycle=P                        stop once the board repeats within P
+ * --fps=N                          frames a second in modes 1 and 2 (10)
+ * --stream=FILE                    write every round's statistics (binary)
+ * --stream-state                   add every round's board change to them
+ * --pages=auto|thp|small           board memory: huge pages where it can
+ *
+ * <infile.txt> may also be an RLE pattern (with -n), or a snapshot to
+ * restart from a checkpoint.
  */
+#ifndef GOL_HEADLESS
 #include <pthreadGridVisi.h>
+#endif
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
-#include <sys/time.h>
 #include <time.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#ifndef GOL_HEADLESS
 #include "colors.h"
+#endif
+#include "bitboard.h"
+#include "simd.h"
+#include "hashlife.h"
+#include "sparse.h"
+#include "snapshot.h"
+#include "loader.h"
+#include "affinity.h"
+#include "trace.h"
+#include "rule.h"
+#include "render.h"
+#include "stream.h"
+#include "arena.h"
 
 /****************** Definitions **********************/
 /* Three possible modes in which the GOL simulation can run */
@@ -33,22 +83,141 @@
 #define OUTPUT_ASCII  (1)   // with ascii animation
 #define OUTPUT_VISI   (2)   // with ParaVis animation
 
-/* Used to slow down animation run modes: usleep(SLEEP_USECS);
- * Change this value to make the animation run faster or slower
+/* Tiles are at most this many columns wide, the rest of the L2 budget
+ * goes to rows */
+#define TILE_MAX_COLS  (1024)
+
+/* L2 size to assume when the system does not report one */
+#define DEFAULT_L2_BYTES (256*1024)
+
+/* With work stealing, split the board into at least this many tiles per
+ * thread so there is something left to steal */
+#define STEAL_TILES_PER_THREAD (8)
+
+/* getopt ids of the options that only have a long name */
+#define OPT_TILE_SIZE  (256)
+#define OPT_HL_MEM     (257)
+#define OPT_SYNC       (258)
+#define OPT_CKPT_FILE  (259)
+#define OPT_PIN        (260)
+#define OPT_TIMES      (261)
+#define OPT_TRACE      (262)
+#define OPT_TRACE_COUNTERS (263)
+#define OPT_CYCLE      (264)
+#define OPT_FPS        (265)
+#define OPT_STREAM     (266)
+#define OPT_STREAM_STATE (267)
+#define OPT_PAGES      (268)
+
+/* With --cycle, row and column bands are stepped and then hashed this
+ * many bytes of board at a time, so the hash reads them from cache */
+#define HASH_CHUNK_BYTES (256*1024)
+
+/* Most intervals kept in a thread's trace timeline, later ones only count
+ * towards the summary */
+#define TRACE_MAX_EVENTS (1 << 18)
+
+/* Where checkpoints go unless --checkpoint-file says otherwise */
+#define DEFAULT_CKPT_FILE "gol.snap"
+
+/* With neighbor sync, check a neighbor's round this many times before
+ * sleeping on it (unless there are more threads than CPUs, when spinning
+ * only takes the CPU from the thread we wait for) */
+#define SYNC_SPINS (2000)
+
+/* Engines that can run the simulation */
+#define ENGINE_THREADS  (0)  // pthreads stepping one generation at a time
+#define ENGINE_HASHLIFE (1)  // memoized quadtree, many generations at once
+#define ENGINE_SPARSE   (2)  // live cell list, cost grows with population
+
+/* Default cap on the hashlife node cache, in MB */
+#define DEFAULT_HL_MEM_MB (512)
+
+/* Kernels that can compute a generation */
+#define KERNEL_INT     (0)  // one int per cell, per-cell neighbor count
+#define KERNEL_BITPACK (1)  // 64 cells per uint64_t, bit-sliced adder
+#define KERNEL_SIMD    (2)  // int board, vectorized row strips
+
+/* Temporal blocking strips are sized so both fit in this fraction of L2 */
+#define TBLOCK_L2_SHARE (2)
+
+/* Frames a second drawn in the animation run modes, however fast the
+ * rounds go (--fps changes it, 0 draws every round it can)
  */
-//#define SLEEP_USECS  (1000000)
-#define SLEEP_USECS    (100000)
+#define DEFAULT_FPS    (10)
 
 /* A global variable to keep track of the number of live cells in the
  * world (this is the ONLY global variable you may use in your program)
  */
 static int total_live = 0;
-/* declare a mutex: initialize in main */
-static pthread_mutex_t my_mutex;
 
 /* declare a barrier: initialize in main */
 static pthread_barrier_t my_barrier;
 
+/* One rectangle of the board handed out as a unit of work in tile mode
+ * (row_or_col == 2) */
+struct gol_tile {
+    int r0, r1; //first and last row of the tile
+    int c0, c1; //first and last column of the tile
+};
+
+/* One thread's share of the tiles for work stealing. range packs the next
+ * tile to hand out (low 32 bits) and one past the last (high 32 bits), so
+ * the owner (taking from the front) and thieves (taking from the back)
+ * agree on what is left with one compare-and-swap. Padded to a cache line
+ * so neighboring queues do not false share. */
+struct tile_queue {
+    uint64_t range;
+    int first, last; //the tiles the owner starts every round with
+} __attribute__((aligned(64)));
+
+/* One thread's live cells for the round, on its own cache line so the
+ * threads never share a line while they write them; thread 1 adds them up
+ * after the barrier that ends the round. With --cycle the thread's hash of
+ * its part of the board rides along */
+struct live_count {
+    int count;
+    uint64_t hash;
+} __attribute__((aligned(64)));
+
+/* Cycle detection (--cycle): the board hash and live count of the last
+ * window rounds, kept by thread 1 in a ring indexed by round % window.
+ * Thread 1 sets end_round once a repeat is found, and every thread reads
+ * it after the next barrier. */
+struct cycle_state {
+    int window; //longest period looked for
+    uint64_t *hashes;
+    int *lives;
+    int *rounds; //round held in each slot, -1 if none
+    int end_round; //last round to compute (iters until a cycle is found)
+    int period; //0 until a cycle is found
+    int start; //first round of the cycle
+    int found_at; //round the repeat was seen at
+    uint64_t cell_keys[64]; //int boards: random key of each cell of a word
+};
+
+/* One partition's progress for neighbor sync: the last round it has
+ * finished computing, which is also the futex word its neighbors sleep
+ * on. Padded so partitions never share a cache line. */
+struct part_sync {
+    int done; //last round finished
+    int sleepers; //1 if a neighbor may be asleep on done
+} __attribute__((aligned(64)));
+
+struct gol_data;
+
+/* One load thread's share of the board file, see load_cells */
+struct load_part {
+    struct gol_data *data;
+    struct board_file *file;
+    pthread_barrier_t *barrier; //between zeroing the boards and parsing
+    int part; //which part of the file, and which rows to zero
+    long cells; //live cells found, -1 on a format error
+    uint64_t *keys; //sparse engine: the cells found
+    long num_keys;
+    long cap_keys;
+};
+
 /* This struct represents all the data you need to keep track of your GOL
  * simulation.  Rather than passing individual arguments into each function,
  * we'll pass in everything in just one of these structs.
@@ -66,22 +235,119 @@ struct gol_data {
     int iters; // number of iterations to run the gol simulation
     int output_mode; // set to:  OUTPUT_NONE, OUTPUT_ASCII, or OUTPUT_VISI
     int num_threads; //# of threads
-    int row_or_col; //which allocation style
+    int row_or_col; //which allocation style: 0 rows, 1 columns, 2 tiles
     int printinfo; // determine if allocation info is printed
     int data_per_thread; //how many rows or columns does each thread handle
     int extra_data; //number of rows or columns left over from the even partioning
     int thread_id; //which thread is this?
     int start_index; //each threads start
     int end_index; //each threads end
+    int kernel; //KERNEL_INT, KERNEL_BITPACK or KERNEL_SIMD
+    int isa; //instruction set of the simd kernel (ISA_AUTO until resolved)
+    uint32_t rule; //the rule, see rule.h
+    int rule_given; //1 if -r set it, which overrides the file's
+    simd_step_fn simd_step; //the simd kernel picked for isa and rule
+    simd_halo_step_fn simd_halo_step; //same, for boards with a halo
+    int halo; //1 if the int boards have a one-cell halo border, else 0
+    int stride; //ints from the start of one board row to the next
+    int engine; //ENGINE_THREADS or ENGINE_HASHLIFE
+    size_t hl_max_bytes; //cap on the hashlife node cache
+    int unbounded; //sparse engine: 1 for the infinite plane, 0 for a torus
+    uint64_t *live_keys; //sparse engine: the live cells (sorted after a run)
+    long num_keys; //sparse engine: number of live_keys
+
+    //the board split into tiles, shared read only by all threads
+    struct gol_tile *tiles;
+    int num_tiles;
+    int tile_rows; //rows per tile (the last row of tiles may be shorter)
+    int tile_cols; //cols per tile (the last column of tiles may be narrower)
+
+    //work stealing between tile queues, one queue per thread (shared)
+    int steal; //1 if idle threads steal tiles from busy ones
+    struct tile_queue *queues;
+    double busy_secs; //this thread's time spent computing tiles
+    double idle_secs; //this thread's time spent waiting for others
+    long tiles_own; //tiles taken from our own queue
+    long tiles_stolen; //tiles taken from other threads' queues
+
+    //active-region tracking: only recompute tiles near last round's changes
+    int active; //1 if quiescent tiles are skipped
+    int tiles_down; //rows of tiles
+    int tiles_across; //columns of tiles
+    int (*tile_nbrs)[8]; //the 8 tiles around each tile (wrapping)
+    unsigned char *tile_changed; //tiles that changed last round (read only)
+    unsigned char *tile_changed_next; //tiles that change this round
+    int *tile_live; //live cells in each tile, kept for skipped tiles
+    uint64_t *tile_hashes; //hash of each tile, kept for unchanged tiles
+    long tiles_skipped; //tile computations this thread skipped
+
+    //the live cell reduction, one padded slot per thread (shared)
+    struct live_count *live_counts;
+    int *history; //live cells after each round start_round..iters, or NULL
+    char *history_file; //where to write history, NULL for nowhere
+    double *round_secs; //seconds each round start_round+1..iters took
+    char *times_file; //where to write round_secs, NULL for nowhere
+
+    //per-thread timeline of compute and wait times, NULL unless --trace
+    char *trace_file; //where the JSON timeline goes
+    int trace_counters; //1 to read hardware counters too
+    struct trace *trace; //the timeline (shared, one record per thread)
+
+    //cycle detection: stop once the board repeats, see struct cycle_state
+    int cycle_window; //longest period looked for (0: off)
+    struct cycle_state *cycle; //thread 1's history (shared)
+
+    //animation: a frame clock picks rounds, a renderer thread draws them
+    int fps; //frames a second (0: as many as the renderer keeps up with)
+    struct render *render; //the frame ring and renderer (shared), or NULL
+
+    //per-round statistics and board changes, see stream.h
+    char *stream_file; //where they go, NULL for nowhere
+    int stream_state; //1 to add board changes
+    struct stream *stream; //the writer (shared), or NULL
+
+    //neighbor sync: wait for the bands on each side, not every thread
+    int neighbor_sync; //1 to replace the per-round barriers
+    struct part_sync *syncs; //one per thread (shared)
+    int nbr_before; //index in syncs of the band above (or left), wrapping
+    int nbr_after; //index in syncs of the band below (or right), wrapping
+    int sync_spins; //times to check a neighbor before sleeping
+
+    //temporal blocking: K rounds of a band in cache per pass over the board
+    int tblock; //rounds per pass (1: off)
+    int tblock_rows; //board rows per cache-resident strip
+
+    //CPU pinning, NULL unless --pin
+    char *pin_policy; //compact, scatter or a CPU list
+    int *cpus; //the CPU of each thread (shared)
+
+    //checkpoint and restart
+    int rounds; //-n: the round to run to, -1 for the file's count
+    int start_round; //the round the board was loaded at (0, or a snapshot's)
+    struct snap_map snap; //the snapshot the board came from, if mapped
+    int checkpoint_every; //rounds between checkpoints (0: none)
+    char *checkpoint_file; //where checkpoints go
+    struct snap_writer *ckpt; //the background writer (shared), or NULL
+
+    //the boards, temporal strips and stream board come out of one arena
+    int pages; //which pages to try, ARENA_AUTO, ARENA_THP or ARENA_SMALL
+    struct arena *arena; //(shared), NULL for the sparse engine
 
     //the base and next arrays of our board
     int *base_arr;
     int *next_arr;
 
+    //the base and next boards when running the bitpack kernel
+    int words_per_row; //uint64_t words per board row
+    uint64_t *base_bits;
+    uint64_t *next_bits;
+
+#ifndef GOL_HEADLESS
     /* fields used by ParaVis library (when run in OUTPUT_VISI mode). */
     // NOTE: DO NOT CHANGE their definitions BUT USE these fields
     visi_handle handle;
     color3 *image_buff;
+#endif
 };
 
 
@@ -93,6 +359,22 @@ void *play_gol(void *args);
 /* init gol data from the input file and run mode cmdline args */
 int init_game_data_from_args(struct gol_data *data, char **argv);
 
+/* parse the optional flags that follow the positional args */
+void parse_options(struct gol_data *data, int argc, char **argv);
+
+/* returns 1 if cell (i, j) of the current board is alive, 0 otherwise */
+int get_cell(struct gol_data *data, int i, int j);
+
+/* index of cell (i, j) in base_arr/next_arr, halo or not */
+long cell_index(struct gol_data *data, int i, int j);
+
+/* copy the wrapped edges of a region of arr into the halo */
+void fill_halo(struct gol_data *data, int *arr, int r0, int r1, int c0,
+        int c1);
+
+/* find number of neighbors of the cell at index on a halo board */
+int get_neighbors_halo(struct gol_data *data, long index);
+
 /* print board to the terminal (for OUTPUT_ASCII mode) */
 void print_board(struct gol_data *data, int round);
 
@@ -106,14 +388,120 @@ void animation_action(struct gol_data *data, int output_mode, int round);
 int get_neighbors(struct gol_data *data, int x, int y);
 
 /* returns 1 if alive, 0 if dead based on num neighbors*/
-int alive_or_dead(int cell_status, int num_neighbors);
+int alive_or_dead(int cell_status, int num_neighbors, uint32_t rule);
 
+#ifndef GOL_HEADLESS
 /* use updated data to set colors for visualization */
 void update_colors(struct gol_data *data);
 
+/* set colors for one region of the board */
+void update_colors_region(struct gol_data *data, int row_start, int row_end,
+        int col_start, int col_end);
+#endif
+
+/* compute one region of the next generation, returns its live cells */
+int step_region(struct gol_data *data, int r0, int r1, int c0, int c1);
+
+/* split the board into L2-sized tiles for row_or_col == 2 */
+void make_tiles(struct gol_data *data);
+
+/* next tile to compute this round with work stealing, -1 when none left */
+int take_tile(struct gol_data *data);
+
+/* allocate the per-tile state used to skip quiescent tiles */
+void make_tile_tracking(struct gol_data *data);
+
+/* compute (or skip, if quiescent) one tile, returns its live cells */
+int step_tile(struct gol_data *data, int t);
+
+/* returns 1 if a region differs between base_arr and next_arr */
+int region_changed(struct gol_data *data, int r0, int r1, int c0, int c1);
+
+/* hash of a region of the next board (or of base, if next is 0) */
+uint64_t hash_region(struct gol_data *data, int next, int r0, int r1, int c0,
+        int c1);
+
+/* hash of one tile of the next board, reused if the tile did not change */
+uint64_t hash_tile(struct gol_data *data, int t);
+
+/* add a region of the round just computed to this thread's --stream part */
+void stream_region(struct gol_data *data, struct stream_part *part, int r0,
+        int r1, int c0, int c1);
+
+/* add one tile of the round just computed to this thread's --stream part */
+void stream_tile(struct gol_data *data, struct stream_part *part, int t);
+
+/* hash of this thread's partition of the base board, before round 1 */
+uint64_t hash_partition(struct gol_data *data);
+
+/* thread 1: look for the board of round in the history, then add it */
+void check_cycle(struct gol_data *data, int round, uint64_t hash, int live);
+
+/* current time in seconds from a monotonic clock */
+double now_secs(void);
+
 /* partition threads */
 void partition_threads(struct gol_data *data);
 
+/* run all the rounds with the engine picked on the command line */
+void run_engine(struct gol_data *data);
+
+/* run all the rounds with the hashlife engine */
+void run_hashlife(struct gol_data *data);
+
+/* the first and last of total items thread t of n gets */
+void thread_share(int total, int n, int t, int *first, int *last);
+
+/* zero thread t's part of both boards, so its pages are placed near it */
+void first_touch(struct gol_data *data, int t);
+
+/* zero the boards and set the file's cells with num_threads threads */
+void load_cells(struct gol_data *data, struct board_file *file,
+        const char *path, long howmany, double load_start);
+
+/* one load thread, see load_cells */
+void *load_worker(void *args);
+
+/* board_file_cells callbacks setting one cell of each board format */
+void set_int_cell(void *ctx, long i, long j);
+void set_bit_cell(void *ctx, long i, long j);
+void add_sparse_cell(void *ctx, long i, long j);
+
+/* run all the rounds with the sparse engine */
+void run_sparse(struct gol_data *data);
+
+/* write the live cells of every round to data->history_file */
+void write_history(struct gol_data *data);
+
+/* write the seconds every round took to data->times_file */
+void write_times(struct gol_data *data);
+
+/* print which pages the board arena got */
+void print_pages(struct gol_data *data);
+
+/* temporal blocking: advance rows r0..r1 gens rounds, from base to next */
+int step_temporal(struct gol_data *data, uint64_t *strip[2], int r0, int r1,
+        int gens);
+
+/* copy n board rows starting at first (wrapping) into a bit-packed strip */
+void load_strip(struct gol_data *data, uint64_t *strip, int first, int n);
+
+/* copy strip rows into board rows r0..r1 of the next board */
+void store_strip(struct gol_data *data, const uint64_t *strip, int r0,
+        int r1);
+
+/* neighbor sync: wait until a partition has finished round gen */
+void wait_for_round(struct part_sync *sync, int gen, int spins);
+
+/* neighbor sync: announce that our partition has finished round gen */
+void finish_round(struct part_sync *sync, int gen);
+
+/* fill a new board from the mapped snapshot in data->snap */
+void load_snapshot_board(struct gol_data *data, int *base_arr);
+
+/* pack this thread's share of the current board for a checkpoint */
+void checkpoint_rows(struct gol_data *data);
+
 
 
 
@@ -121,6 +509,7 @@ void partition_threads(struct gol_data *data);
 
 
 /************ Definitions for using ParVisi library ***********/
+#ifndef GOL_HEADLESS
 /* initialization for the ParaVisi library (DO NOT MODIFY) */
 int setup_animation(struct gol_data* data);
 /* register animation with ParaVisi library (DO NOT MODIFY) */
@@ -128,6 +517,7 @@ int setup_animation(struct gol_data* data);
 //         struct gol_data* data);
 /* name for visi (you may change the string value if you'd like) */
 static char visi_name[] = "GOL ʕ•́ᴥ•̀ʔっ♡";
+#endif
 /**************************************************************/
 
 
@@ -136,30 +526,50 @@ int main(int argc, char **argv) {
 
     int ret;
     struct gol_data data;
-    double secs;
-    struct timeval start_time, stop_time; 
-
-
-  // Initialize the mutex
-    if (pthread_mutex_init(&my_mutex, NULL)) { 
-        printf("pthread_mutex_init error\n");
-        exit(1);
-    }
-    
+    double secs, start_time = 0, stop_time = 0;
 
-  
 
     /* check number of command line arguments */
-    if (argc < 3) {
-        printf("usage: %s <infile.txt> <output_mode>[0|1|2]\n", argv[0]);
-        printf("(0: no visualization, 1: ASCII, 2: ParaVisi)\n");
+    if (argc < 6) {
+        printf("usage: %s <infile.txt> <output_mode>[0|1|2] <num_threads>"
+                " <row_vs_col>[0|1|2] <print_info>[0|1] [options]\n", argv[0]);
+        printf("(output_mode 0: no visualization, 1: ASCII, 2: ParaVisi)\n");
+        printf("(row_vs_col 0: row bands, 1: column bands, 2: L2 tiles)\n");
+        printf("options: -k, --kernel=int|bitpack|simd"
+                "  -r, --rule=B3/S23"
+                "  -i, --isa=auto|sse2|avx2|avx512  -H, --halo"
+                "  --tile-size=RxC  -s, --steal  -A, --active"
+                "  -e, --engine=threads|hashlife|sparse  --hl-mem=MB"
+                "  -u, --unbounded  -P, --population=FILE"
+                "  --sync=barrier|neighbor  -T, --temporal=K"
+                "  -C, --checkpoint=N  --checkpoint-file=PATH"
+                "  -n, --rounds=N  --pin=compact|scatter|CPUS"
+                "  --times=FILE  --trace=FILE  --trace-counters"
+                "  --cycle=P  --fps=N  --stream=FILE  --stream-state"
+                "  --pages=auto|thp|small\n");
         exit(1);
     }
 
+    /* read the optional flags before the game state needs them */
+    parse_options(&data, argc, argv);
+
     /* Initialize game state (all fields in data) from information
      * read from input file */
     
     ret = init_game_data_from_args(&data, argv);
+    check_error(ret);
+
+    //only the threaded engine has a dense board to animate every round
+    if (data.engine != ENGINE_THREADS && data.output_mode == OUTPUT_VISI) {
+        printf("Only the threads engine can run with ParaVisi animation\n");
+        exit(1);
+    }
+#ifdef GOL_HEADLESS
+    if (data.output_mode == OUTPUT_VISI) {
+        printf("This gol was built headless, use output mode 0 or 1\n");
+        exit(1);
+    }
+#endif
 
     // Initialize the barrier with num threads that will be synchronized
 
@@ -171,22 +581,18 @@ int main(int argc, char **argv) {
 
     /* Invoke play_gol in different ways based on the run mode */ 
     if (data.output_mode == OUTPUT_NONE) {  // run with no animation
-        ret = gettimeofday(&start_time, NULL);
-        check_error(ret);
+        start_time = now_secs();
         //partition and create threads to run gol
-        partition_threads(&data);
+        run_engine(&data);
         //play_gol(&data);
-        ret = gettimeofday(&stop_time, NULL);
-        check_error(ret);
+        stop_time = now_secs();
     }
     else if (data.output_mode == OUTPUT_ASCII) { // run with ascii animation
-        ret = gettimeofday(&start_time, NULL);
-        check_error(ret);
+        start_time = now_secs();
         //partition and create threads to run gol
-        partition_threads(&data);
+        run_engine(&data);
         //play_gol(&data);
-        ret = gettimeofday(&stop_time, NULL);
-        check_error(ret);
+        stop_time = now_secs();
 
         // clear the previous print_board output from the terminal:
         // (NOTE: you can comment out this line while debugging)
@@ -197,6 +603,7 @@ int main(int argc, char **argv) {
         //       (it's to help us with grading your output)
         print_board(&data, data.iters);
     }
+#ifndef GOL_HEADLESS
     else if (data.output_mode == OUTPUT_VISI) {  
         // OUTPUT_VISI: run with ParaVisi animation
         // tell ParaVisi that it should run play_gol
@@ -208,20 +615,30 @@ int main(int argc, char **argv) {
         //MOVED INTO PARTITION THREADS
         // start ParaVisi animation
         //run_animation(data.handle, data.iters);
-    } else {
+    }
+#endif
+    else {
         printf("Invalid output mode: %d\n", data.output_mode);
         printf("Check your game data initialization\n");
         exit(1);
     }
 
+    if (data.history_file) {
+        write_history(&data);
+    }
+    if (data.times_file) {
+        write_times(&data);
+    }
+
+    if (data.printinfo == 1 && data.arena) {
+        print_pages(&data);
+    }
+
     //Timing
     if (data.output_mode != OUTPUT_VISI) {
-        double ms, s; 
-        secs = 0.0;
-        // Compute the total runtime in seconds
-        ms = (stop_time.tv_usec/1000000.0)-(start_time.tv_usec/1000000.0);
-        s = (stop_time.tv_sec)-(start_time.tv_sec);
-        secs = ms + s;
+        // Compute the total runtime in seconds (monotonic, so a clock
+        // change during the run cannot skew it)
+        secs = stop_time - start_time;
         /* Print the total runtime, in seconds. */
         // NOTE: do not modify these calls to fprintf
         fprintf(stdout, "Total time: %0.3f seconds\n", secs);
@@ -230,8 +647,21 @@ int main(int argc, char **argv) {
     }
 
     // clean-up before exit
-    free(data.base_arr);
-    free(data.next_arr);
+    //the boards are in the arena, or one of the bit boards is the snapshot
+    arena_destroy(data.arena);
+    if (data.snap.addr) {
+        snapshot_unmap(&data.snap);
+    }
+    free(data.tiles);
+    free(data.tile_nbrs);
+    free(data.tile_changed);
+    free(data.tile_changed_next);
+    free(data.tile_live);
+    free(data.tile_hashes);
+    free(data.history);
+    free(data.round_secs);
+    free(data.live_keys);
+    free(data.cpus);
 
     return 0;
 }
@@ -248,12 +678,19 @@ int main(int argc, char **argv) {
  */
 int init_game_data_from_args(struct gol_data *data, char **argv) {
 
-    int  howmany, ret;
-    FILE *infile;
-    //open file, get file ptr
-    infile = fopen(argv[1], "r");
-    if (infile == NULL) {
-        printf("Error: failed to open file: %s\n", argv[1]);
+    long howmany;
+    struct board_file file;
+    double load_start = now_secs();
+
+    //a snapshot (checkpoint) is used as the board, a text or RLE file is
+    //parsed into it
+    memset(&file, 0, sizeof(file));
+    if (snapshot_is(argv[1])) {
+        if (snapshot_map(argv[1], &data->snap)) {
+            exit(1);
+        }
+    }
+    else if (board_file_open(argv[1], &file)) {
         exit(1);
     }
 
@@ -263,23 +700,184 @@ int init_game_data_from_args(struct gol_data *data, char **argv) {
     //copy the flag for row or cols
     data->row_or_col = atoi(argv[4]);
     //error check row or col
-    if ((data->row_or_col != 0) && (data->row_or_col != 1)) {
-        printf("argv[4] error, enter 0 or 1.\n");
+    if ((data->row_or_col < 0) || (data->row_or_col > 2)) {
+        printf("argv[4] error, enter 0, 1 or 2.\n");
+        exit(1);
+    }
+    //bit-packed rows can only be split between threads by row
+    if (data->kernel == KERNEL_BITPACK && data->row_or_col != 0) {
+        printf("bitpack kernel needs row parallelism, enter 0 for argv[4].\n");
+        exit(1);
+    }
+    //stealing hands out tiles
+    if (data->steal && data->row_or_col != 2) {
+        printf("Work stealing needs tiles, enter 2 for argv[4].\n");
+        exit(1);
+    }
+    if (data->active && data->row_or_col != 2) {
+        printf("Active-region tracking needs tiles, enter 2 for argv[4].\n");
+        exit(1);
+    }
+    if (data->kernel == KERNEL_BITPACK && data->halo) {
+        printf("The halo layout is for the int and simd kernels.\n");
+        exit(1);
+    }
+    if (data->history_file && data->engine != ENGINE_THREADS) {
+        printf("The population history is kept by the threads engine.\n");
+        exit(1);
+    }
+    if (data->times_file && data->engine != ENGINE_THREADS) {
+        printf("Round times are kept by the threads engine.\n");
+        exit(1);
+    }
+    if (data->trace_file && data->engine != ENGINE_THREADS) {
+        printf("Traces are kept by the threads engine.\n");
+        exit(1);
+    }
+    if (data->trace_counters && !data->trace_file) {
+        printf("--trace-counters needs --trace=FILE.\n");
+        exit(1);
+    }
+    //every round is summed by thread 1, and skipped tiles are not counted
+    if (data->stream_file && (data->engine != ENGINE_THREADS
+                || data->neighbor_sync || data->tblock > 1 || data->active)) {
+        printf("Streaming needs the threads engine, barrier sync, no -T"
+                " and no -A.\n");
+        exit(1);
+    }
+    //board changes are whole words of whole rows
+    if (data->stream_state && (!data->stream_file || data->row_or_col != 0)) {
+        printf("--stream-state needs --stream=FILE and row partitioning.\n");
+        exit(1);
+    }
+    //a repeat is only seen by comparing whole rounds
+    if (data->cycle_window && (data->engine != ENGINE_THREADS
+                || data->neighbor_sync || data->tblock > 1)) {
+        printf("Cycle detection needs the threads engine, barrier sync and"
+                " no -T.\n");
+        exit(1);
+    }
+    //with neighbor sync bands drift apart, so no one sees a whole round
+    if (data->neighbor_sync && (data->row_or_col == 2
+                || data->output_mode != OUTPUT_NONE || data->history_file
+                || data->engine != ENGINE_THREADS)) {
+        printf("Neighbor sync needs the threads engine, row or column bands,"
+                " output mode 0 and no -P.\n");
+        exit(1);
+    }
+    //a temporal block steps whole-width row strips, several rounds per sync
+    if (data->tblock > 1 && (data->row_or_col != 0 || data->neighbor_sync
+                || data->history_file || data->engine != ENGINE_THREADS)) {
+        printf("Temporal blocking needs the threads engine, row bands,"
+                " barrier sync and no -P.\n");
+        exit(1);
+    }
+    if (data->unbounded && data->engine != ENGINE_SPARSE) {
+        printf("Only the sparse engine runs on an unbounded plane.\n");
+        exit(1);
+    }
+    //checkpoints copy a whole round, which neighbor sync never has
+    if (data->checkpoint_every && (data->engine != ENGINE_THREADS
+                || data->neighbor_sync)) {
+        printf("Checkpoints need the threads engine and barrier sync.\n");
+        exit(1);
+    }
+    if (data->snap.addr && data->engine == ENGINE_SPARSE) {
+        printf("Snapshots hold a dense board, restart with the threads or"
+                " hashlife engine.\n");
+        exit(1);
+    }
+
+    //-r, else the rule the snapshot was run under or the file names
+    if (data->snap.addr) {
+        uint32_t rule = data->snap.header->rule;
+        char a[RULE_TEXT_MAX], b[RULE_TEXT_MAX];
+
+        if (rule & ~RULE_MASK) {
+            printf("Snapshot %s has a bad rule\n", argv[1]);
+            exit(1);
+        }
+        if (data->rule_given && data->rule != rule) {
+            printf("Snapshot %s was run under %s, not %s\n", argv[1],
+                    rule_format(rule, a), rule_format(data->rule, b));
+            exit(1);
+        }
+        data->rule = rule;
+    }
+    else if (!data->rule_given && file.has_rule) {
+        data->rule = file.rule;
+    }
+    //both only ever look at cells next to live ones
+    if ((data->rule & RULE_BIRTH(0)) && data->engine != ENGINE_THREADS) {
+        printf("Rules with B0 need the threads engine.\n");
         exit(1);
     }
 
     //copy the flag for determining if to print info
     data->printinfo = atoi(argv[5]);
 
+    //pick the simd kernel once, every thread calls through the pointer
+    if (data->kernel == KERNEL_SIMD) {
+        if (data->isa == ISA_AUTO) {
+            data->isa = simd_detect_isa();
+        }
+        else if (!simd_isa_supported(data->isa)) {
+            printf("This CPU does not support %s.\n", simd_isa_name(data->isa));
+            exit(1);
+        }
+        data->simd_step = simd_kernel(data->isa, data->rule);
+        data->simd_halo_step = simd_halo_kernel(data->isa, data->rule);
+        if (data->printinfo == 1) {
+            printf("simd kernel: %s\n", simd_isa_name(data->isa));
+        }
+    }
+    if (data->printinfo == 1 && data->rule != RULE_LIFE) {
+        char text[RULE_TEXT_MAX];
+        const char *name = rule_name(data->rule);
+
+        if (name) {
+            printf("rule: %s (%s)\n", rule_format(data->rule, text), name);
+        }
+        else {
+            printf("rule: %s\n", rule_format(data->rule, text));
+        }
+    }
+
 
 
 
 
-    ret = fscanf(infile, "%d\n %d\n %d\n %d", &data->rows, &data->cols, &data->iters, &howmany);
-    //check for file error
-    if(ret != 4){
-        printf("Improper file format\n");
-        exit(1);
+    if (data->snap.addr) {
+        const struct snap_header *h = data->snap.header;
+
+        if (h->iters > INT_MAX || h->live > INT_MAX) {
+            printf("Snapshot %s is too big for this gol\n", argv[1]);
+            exit(1);
+        }
+        data->rows = h->rows;
+        data->cols = h->cols;
+        data->iters = h->iters;
+        data->start_round = h->generation;
+        howmany = h->live;
+    }
+    else {
+        data->rows = file.rows;
+        data->cols = file.cols;
+        data->iters = file.iters;
+        howmany = file.howmany; //-1 for RLE, counted while parsing
+        if (file.rle && data->rounds < 0) {
+            printf("RLE files have no round count, give one with -n.\n");
+            exit(1);
+        }
+    }
+    //-n replaces the file's round count (or extends a restart)
+    if (data->rounds >= 0) {
+        if (data->rounds < data->start_round) {
+            printf("The snapshot is already at round %d, past -n %d.\n",
+                    data->start_round, data->rounds);
+            exit(1);
+        }
+        data->iters = data->rounds;
     }
 
     //Threads basic init
@@ -293,72 +891,146 @@ int init_game_data_from_args(struct gol_data *data, char **argv) {
         printf("Too many threads, run with equal or less than row/col size.\n");
         exit(1);
     }
+    //the load threads pin too, so the board is placed where it is used
+    if (data->pin_policy) {
+        data->cpus = affinity_plan(data->pin_policy, data->num_threads);
+        if (!data->cpus) {
+            exit(1);
+        }
+    }
+
+    data->tiles = NULL;
+
+    //the sparse engine never allocates the rows x cols board
+    if (data->engine == ENGINE_SPARSE) {
+        load_cells(data, &file, argv[1], howmany, load_start);
+        board_file_close(&file);
+        return 0;
+    }
 
-    //find out the number of rows or columns to each thread
+    //find out the number of rows, columns or tiles to each thread
     if (data->row_or_col == 0) {
             data->data_per_thread = data->rows / data->num_threads;
             data->extra_data = data->rows  % data->num_threads;
         }
+    else if (data->row_or_col == 2) {
+            make_tiles(data);
+            data->data_per_thread = data->num_tiles / data->num_threads;
+            data->extra_data = data->num_tiles % data->num_threads;
+        }
     else {
             data->data_per_thread = data->cols / data->num_threads;
             data->extra_data = data->cols % data->num_threads;
         }
 
 
-    total_live = howmany; //set initial # of alive cells to the total_live global variable
+    //the first round is the board as read, play_gol fills in the rest
+    if (data->history_file) {
+        data->history = malloc(sizeof(int) * ((long)data->iters + 1));
+        if (!data->history) {
+            printf("malloc failed: population history\n");
+            exit(1);
+        }
+    }
+    if (data->times_file) {
+        data->round_secs = calloc((long)data->iters + 1, sizeof(double));
+        if (!data->round_secs) {
+            printf("malloc failed: round times\n");
+            exit(1);
+        }
+    }
 
-    int *base_arr;       // a dynamically allocated "2D" array using 1 malloc
+    //temporal blocking: the tallest strips whose two copies fit in
+    //1/TBLOCK_L2_SHARE of L2, counting the tblock extra rows on each side
+    if (data->tblock > 1) {
+        long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        long row_bytes = sizeof(uint64_t) * bitboard_words(data->cols);
 
-    base_arr = malloc(sizeof(int)*data->rows*data->cols); //malloc memory
-    if (!base_arr) { //make sure malloc was succesful
-        printf("malloc failed, check file format\n");
-        exit(1);
+        if (l2 <= 0) {
+            l2 = DEFAULT_L2_BYTES;
+        }
+        data->tblock_rows = l2 / TBLOCK_L2_SHARE / (2 * row_bytes)
+            - 2 * data->tblock;
+        if (data->tblock_rows < 1) {
+            data->tblock_rows = 1;
+        }
+        if (data->printinfo == 1) {
+            printf("temporal blocking: %d rounds per pass, %d row strips\n",
+                    data->tblock, data->tblock_rows);
+        }
     }
-    
-    //calculate total length of array
-    int length = data->rows * data->cols;
 
-    //initialize the array to 0
-    for (int i = 0; i<length;i++) {
-       base_arr[i] = 0;
+    int *base_arr = NULL;       // a dynamically allocated "2D" array using 1 malloc
+    int *next_arr = NULL;
+
+    data->base_bits = NULL;
+    data->next_bits = NULL;
+    data->words_per_row = bitboard_words(data->cols);
+    //a halo adds one row above and below, one column left and right
+    data->stride = data->cols + 2*data->halo;
+
+    //one arena for the two boards and everything the threads step into:
+    //the temporal strips and the stream's bit-packed copy of an int board
+    size_t bits_bytes = sizeof(uint64_t) * (size_t)data->rows
+        * data->words_per_row;
+    size_t board_bytes = data->kernel == KERNEL_BITPACK ? bits_bytes
+        : sizeof(int) * (size_t)(data->rows + 2*data->halo) * data->stride;
+    size_t arena_bytes = arena_piece(board_bytes)
+        * (data->snap.addr && data->kernel == KERNEL_BITPACK ? 1 : 2);
+
+    if (data->tblock > 1) {
+        arena_bytes += 2 * (size_t)data->num_threads
+            * arena_piece(sizeof(uint64_t) * (size_t)(data->tblock_rows
+                        + 2*data->tblock) * data->words_per_row);
     }
-    
-
-    //populate initial board with initial alive cells
-    int count = 0;
-    int i = 0;
-    int j = 0; 
-    while (count < howmany) {
-        //get i and j
-        ret = fscanf(infile, "%d %d\n", &i, &j);
-        //check for file error
-        if(ret != 2){
-            printf("Improper file format. \n");
+    if (data->stream_file && data->kernel != KERNEL_BITPACK) {
+        arena_bytes += arena_piece(bits_bytes);
+    }
+    data->arena = arena_create(arena_bytes, data->pages);
+
+    if (data->kernel == KERNEL_BITPACK) {
+        //a snapshot's board is already in this layout and is used where
+        //it is mapped
+        data->base_bits = data->snap.addr ? data->snap.bits
+            : arena_alloc(data->arena, board_bytes);
+        data->next_bits = arena_alloc(data->arena, board_bytes);
+        if (!data->base_bits || !data->next_bits) {
+            printf("malloc failed, check file format\n");
             exit(1);
+        }
     }
-        //set the cell of i and j to 1
-        base_arr[(i)*data->cols+j] = 1;
-        count++;
+    else {
+        //zeroed by the threads in load_cells, which places their pages
+        base_arr = arena_alloc(data->arena, board_bytes);
+        next_arr = arena_alloc(data->arena, board_bytes);
+        if (!base_arr || !next_arr) {
+            printf("malloc failed, check file format\n");
+            exit(1);
+        }
     }
+    
 
-
-    //copy arr to struct
+    //copy arrs to struct
     data->base_arr = base_arr;
+    data->next_arr = next_arr;
 
-    int *next_arr;       // a dynamically allocated "2D" array using 1 malloc
+    //zero the boards and set the initial alive cells, in parallel
+    load_cells(data, &file, argv[1], howmany, load_start);
+    if (data->snap.addr) {
+        load_snapshot_board(data, base_arr);
+        total_live = howmany;
+    }
+    if (data->history) {
+        data->history[data->start_round] = total_live;
+    }
 
-    next_arr = malloc(sizeof(int)*data->rows*data->cols); //malloc memory
-    if (!base_arr) { //make sure malloc was succesful
-        printf("malloc failed\n");
-        exit(1);
+    //the first generation's halo, later ones are filled by the threads
+    if (data->halo) {
+        fill_halo(data, base_arr, 0, data->rows-1, 0, data->cols-1);
     }
 
-    //copy next arr to struct
-    data->next_arr = next_arr;
 
-    //close file
-    ret = fclose(infile);
-    check_error(ret);
+    board_file_close(&file);
 
 
     return 0;
@@ -383,24 +1055,54 @@ void *play_gol(void *args) {
     int rows = data->rows;
     int iters = data->iters;
     int output_mode = data->output_mode;
-    int round = 0;
+    int round = data->start_round;
     int *temp;
+    uint64_t *temp_bits;
+    unsigned char *temp_flags;
     int local_live_count = 0;
+    uint64_t local_hash = 0;
+    int hash_rows; //--cycle: rows stepped, then hashed, at a time
     int thread_num = data->thread_id;
     int row_start,row_end,col_start,col_end;
+    uint64_t *strip[2] = {NULL, NULL}; //temporal blocking scratch
+    int gens; //rounds computed this pass
+    struct trace *trace = data->trace;
+    uint64_t mark = 0; //start of the traced interval
+    struct stream_part *part = NULL; //our share of the round's --stream record
+
+    if (data->cpus && affinity_pin(data->cpus[thread_num-1])) {
+        printf("Warning: could not pin thread %d to cpu %d\n", thread_num,
+                data->cpus[thread_num-1]);
+    }
 
     if (data->printinfo == 1) {
         if(thread_num<num_threads+1) {
-            if (data->row_or_col == 0) {
+            if (data->row_or_col == 2) {
+                for (int t = data->start_index; t <= data->end_index; t++) {
+                    struct gol_tile *tile = &data->tiles[t];
+
+                    printf("tid %4d: tile %5d rows:  %5d:%-4d (%d) cols:  %5d:%-4d (%d)\n",
+                    thread_num, t, tile->r0, tile->r1, (tile->r1-tile->r0+1),
+                    tile->c0, tile->c1, (tile->c1-tile->c0+1));
+                }
+            } else if (data->row_or_col == 0) {
                 printf("tid %4d: rows:  %5d:%-4d (%d) cols:  %5d:%-4d (%d)\n", thread_num,
                 data->start_index, data->end_index, (data->end_index-data->start_index+1) , 0,cols-1, cols );
             } else {
                 printf("tid %4d: rows:  %5d:%-4d (%d) cols:  %5d:%-4d (%d)\n", thread_num,
                 0,rows-1, rows, data->start_index, data->end_index, (data->end_index-data->start_index+1) );
             }
+            if (data->cpus) {
+                printf("tid %4d: cpu %4d (node %d)\n", thread_num,
+                        data->cpus[thread_num-1],
+                        affinity_node(data->cpus[thread_num-1]));
+            }
         }
     }
     
+    double run_start, compute_start, round_end;
+
+    //in tile mode start/end_index are tile numbers, see data->tiles
     if(data->row_or_col == 0){
         row_start = data->start_index;
         row_end = data->end_index;
@@ -414,63 +1116,290 @@ void *play_gol(void *args) {
     }
 
 
+    //with a cycle hash, about HASH_CHUNK_BYTES of the band at a time
+    if (data->kernel == KERNEL_BITPACK) {
+        hash_rows = HASH_CHUNK_BYTES / (sizeof(uint64_t) * data->words_per_row);
+    }
+    else {
+        hash_rows = HASH_CHUNK_BYTES / (sizeof(int) * (col_end-col_start+1));
+    }
+    if (hash_rows < 1) {
+        hash_rows = 1;
+    }
+
+    //two bit-packed strips, tblock rows taller than a strip on each side
+    if (data->tblock > 1) {
+        size_t strip_bytes = sizeof(uint64_t) * (size_t)(data->tblock_rows
+                + 2*data->tblock) * data->words_per_row;
+
+        strip[0] = arena_alloc(data->arena, strip_bytes);
+        strip[1] = arena_alloc(data->arena, strip_bytes);
+        if (!strip[0] || !strip[1]) {
+            printf("malloc failed: temporal blocking strips\n");
+            exit(1);
+        }
+    }
+
+    //the board as loaded starts the history
+    if (data->cycle) {
+        data->live_counts[thread_num-1].hash = hash_partition(data);
+    }
+
+    //the board as loaded is the first frame
+    if (thread_num == 1 && data->render) {
+        render_plan(data->render, round, round < iters);
+    }
+
+    if (trace) {
+        trace_thread_start(trace, thread_num-1);
+        mark = trace_begin(trace, thread_num-1, TRACE_BARRIER);
+    }
     pthread_barrier_wait(&my_barrier);
+    if (trace) {
+        trace_end(trace, thread_num-1, TRACE_BARRIER, round, mark);
+    }
+    run_start = now_secs();
+    round_end = run_start;
+
+    if (thread_num == 1 && data->cycle) {
+        uint64_t sum = 0;
+
+        for (int t = 0; t < num_threads; t++) {
+            sum += data->live_counts[t].hash;
+        }
+        check_cycle(data, round, sum, total_live);
+    }
 
 
     //print initial board
-    animation_action(data, output_mode, round);
+    if (data->render && data->render->take) {
+        if (trace) {
+            mark = trace_begin(trace, thread_num-1, TRACE_OUTPUT);
+        }
+        animation_action(data, output_mode, round);
+        if (trace) {
+            trace_end(trace, thread_num-1, TRACE_OUTPUT, round, mark);
+        }
+    }
     
     //increment round from 0 to 1
     round++;
 
     while (round <= iters) {
-    
-        if(data->thread_id == 1){
-            total_live=0;
+
+        //refill our queue, nobody steals between rounds
+        if (data->steal) {
+            struct tile_queue *q = &data->queues[data->thread_id-1];
+
+            __atomic_store_n(&q->range,
+                    ((uint64_t)(q->last+1) << 32) | (uint32_t)q->first,
+                    __ATOMIC_RELEASE);
         }
 
 
-        pthread_barrier_wait(&my_barrier);
+        if (trace) {
+            mark = trace_begin(trace, thread_num-1, data->neighbor_sync
+                    ? TRACE_NEIGHBOR : TRACE_BARRIER);
+        }
+        if (data->neighbor_sync) {
+            //we read their last round, and overwrite the rows they read
+            //to compute it, so both neighbors must be done with it
+            wait_for_round(&data->syncs[data->nbr_before], round-1,
+                    data->sync_spins);
+            wait_for_round(&data->syncs[data->nbr_after], round-1,
+                    data->sync_spins);
+        }
+        else {
+            pthread_barrier_wait(&my_barrier);
+        }
+        if (trace) {
+            trace_end(trace, thread_num-1, data->neighbor_sync
+                    ? TRACE_NEIGHBOR : TRACE_BARRIER, round, mark);
+        }
+        //thread 1 set this before the barrier, if the board repeated
+        if (data->cycle && round > data->cycle->end_round) {
+            break;
+        }
+        //waits only if the writer is STREAM_DEPTH rounds behind
+        if (data->stream) {
+            part = stream_part_begin(data->stream, thread_num-1, round);
+        }
+        if (trace) {
+            mark = trace_begin(trace, thread_num-1, TRACE_COMPUTE);
+        }
 
 
         local_live_count = 0;
-        for (int j = col_start; j <= col_end;j++) {
-            for (int i = row_start; i <= row_end; i++) {
-                    
-                    //update next board, using our functions. We call alive our dead, with  get_neighbors called inside
-                data->next_arr[(i)*cols+(j)] = alive_or_dead(data->base_arr[(i)*cols+(j)], (get_neighbors(data,i,j)));
-                    
-                    //update alive count if cell is alive
-                local_live_count+=data->next_arr[(i)*data->cols+(j)];
+        local_hash = 0;
+        gens = 1;
+        compute_start = now_secs();
+        if (data->tblock > 1) {
+            //up to tblock rounds of each strip while it sits in cache
+            gens = (iters - round + 1 < data->tblock) ? iters - round + 1
+                : data->tblock;
+            for (int r = row_start; r <= row_end; r += data->tblock_rows) {
+                int last = r + data->tblock_rows - 1;
+
+                local_live_count += step_temporal(data, strip, r,
+                        (last < row_end) ? last : row_end, gens);
+            }
+        }
+        else if (data->steal) {
+            //our tiles first, then the back of whoever still has some
+            int t;
+
+            while ((t = take_tile(data)) >= 0) {
+                local_live_count += step_tile(data, t);
+                if (data->cycle) {
+                    local_hash += hash_tile(data, t);
+                }
+                if (part) {
+                    stream_tile(data, part, t);
+                }
+            }
+        }
+        else if (data->row_or_col == 2) {
+            //our tiles, one after the other, each in row-major order
+            for (int t = data->start_index; t <= data->end_index; t++) {
+                local_live_count += step_tile(data, t);
+                if (data->cycle) {
+                    local_hash += hash_tile(data, t);
+                }
+                if (part) {
+                    stream_tile(data, part, t);
+                }
+            }
+        }
+        else if (data->cycle || part) {
+            //hash (and stream) each chunk of rows while it is still in cache
+            for (int r = row_start; r <= row_end; r += hash_rows) {
+                int last = (r + hash_rows - 1 < row_end) ? r + hash_rows - 1
+                    : row_end;
+
+                local_live_count += step_region(data, r, last, col_start,
+                        col_end);
+                if (data->cycle) {
+                    local_hash += hash_region(data, 1, r, last, col_start,
+                            col_end);
+                }
+                if (part) {
+                    stream_region(data, part, r, last, col_start, col_end);
+                }
             }
         }
+        else {
+            local_live_count = step_region(data, row_start, row_end,
+                    col_start, col_end);
+        }
+        data->busy_secs += now_secs() - compute_start;
+        if (trace) {
+            trace_end(trace, thread_num-1, TRACE_COMPUTE, round, mark);
+        }
+        //next now holds the last round of the pass
+        round += gens - 1;
+
+        //thread 1 decides for everyone, the barrier below publishes it
+        if (thread_num == 1 && data->ckpt) {
+            snapshot_writer_plan(data->ckpt, round);
+        }
+        //the last round is printed by main, not animated
+        if (thread_num == 1 && data->render) {
+            render_plan(data->render, round, round < iters);
+        }
+
+        //our own cache line, no lock needed
+        data->live_counts[thread_num-1].count = local_live_count;
+        data->live_counts[thread_num-1].hash = local_hash;
 
-        //using mutex lock to lock one threads actions
-        pthread_mutex_lock(&my_mutex);
-        //incriment global variable total_live
-        total_live += local_live_count;
-        
-        pthread_mutex_unlock(&my_mutex);  
         //copy next array to base array
         temp = data->base_arr;
         data->base_arr = data->next_arr;
         data->next_arr = temp;
+        temp_bits = data->base_bits;
+        data->base_bits = data->next_bits;
+        data->next_bits = temp_bits;
+        temp_flags = data->tile_changed;
+        data->tile_changed = data->tile_changed_next;
+        data->tile_changed_next = temp_flags;
         
         
-        //printf("total live: %d\n", total_live);
+        if (data->neighbor_sync) {
+            finish_round(&data->syncs[thread_num-1], round);
+        }
+        else {
+            if (trace) {
+                mark = trace_begin(trace, thread_num-1, TRACE_BARRIER);
+            }
+            pthread_barrier_wait(&my_barrier);
+            if (trace) {
+                trace_end(trace, thread_num-1, TRACE_BARRIER, round, mark);
+            }
+        }
 
-        //unlock the threads actions
-        
-        pthread_barrier_wait(&my_barrier);
+        //every count is in; nobody writes one again until thread 1 has
+        //passed the next round's first barrier
+        if (thread_num == 1 && !data->neighbor_sync) {
+            int sum = 0;
+
+            for (int t = 0; t < num_threads; t++) {
+                sum += data->live_counts[t].count;
+            }
+            total_live = sum;
+            if (data->history) {
+                data->history[round] = sum;
+            }
+            if (data->stream) {
+                stream_post(data->stream, round, sum);
+            }
+            if (data->cycle) {
+                uint64_t hash = 0;
+
+                for (int t = 0; t < num_threads; t++) {
+                    hash += data->live_counts[t].hash;
+                }
+                check_cycle(data, round, hash, sum);
+            }
+        }
+
+        //thread 1's clock, from the end of one round (or pass) to the
+        //next; a pass of gens rounds is split evenly between them
+        if (thread_num == 1 && data->round_secs) {
+            double now = now_secs();
+
+            for (int r = round - gens + 1; r <= round; r++) {
+                data->round_secs[r] = (now - round_end) / gens;
+            }
+            round_end = now;
+        }
+
+        //nobody writes this round's board until the round after next, so
+        //it is packed while the others go on
+        if (data->ckpt && data->ckpt->take) {
+            if (trace) {
+                mark = trace_begin(trace, thread_num-1, TRACE_CHECKPOINT);
+            }
+            checkpoint_rows(data);
+            if (trace) {
+                trace_end(trace, thread_num-1, TRACE_CHECKPOINT, round,
+                        mark);
+            }
+        }
 
 
 
 
 
 
-        //do correct animation step based on output mode at end of round
-        if (round < iters) {
+        //do correct animation step based on output mode at end of round,
+        //on the rounds the frame clock picked
+        if (data->render && data->render->take) {
+        if (trace) {
+            mark = trace_begin(trace, thread_num-1, TRACE_OUTPUT);
+        }
         animation_action(data, output_mode, round);
+        if (trace) {
+            trace_end(trace, thread_num-1, TRACE_OUTPUT, round, mark);
+        }
         }
         
         //increment round
@@ -479,6 +1408,12 @@ void *play_gol(void *args) {
 
 
     } 
+
+    //everything that was not computing was waiting on other threads
+    data->idle_secs = now_secs() - run_start - data->busy_secs;
+    if (trace) {
+        trace_thread_stop(trace, thread_num-1);
+    }
     
     return NULL;
 
@@ -487,34 +1422,105 @@ void *play_gol(void *args) {
 }
 
 /**************************************************************/
-/******************** Print Board **********************
- * print_board: Prints the current Game of Life board in ASCII format.
- * data: Pointer to a gol_data structure containing grid and state information.
- * round: The current round number of the simulation.
- * returns: void.
+/******************** Step Region **********************
+ * step_region: Computes one rectangle of the next generation with the
+ *       selected kernel, walking it in row-major order, then copies its
+ *       wrapped edges into next's halo if the board has one.
+ * data: Pointer to a gol_data structure containing grid information.
+ * r0, r1, c0, c1: The rows and columns of the region (inclusive).
+ * returns: The number of live cells in the region after the step.
  ***************************************************************/
 
-void print_board(struct gol_data *data, int round) {
+int step_region(struct gol_data *data, int r0, int r1, int c0, int c1) {
+    int rows = data->rows;
+    int cols = data->cols;
+    long origin = cell_index(data, 0, 0); //skips the halo, if any
+    int live = 0;
+
+    if (data->kernel == KERNEL_BITPACK) {
+        //64 cells per word, neighbors summed with a bit-sliced adder
+        live = bitboard_step_rows(data->base_bits, data->next_bits, rows,
+                cols, r0, r1, data->rule);
+    }
+    else if (data->kernel == KERNEL_SIMD && data->halo) {
+        //no wrapping columns to peel off, point the kernel at (0, 0)
+        live = data->simd_halo_step(data->base_arr + origin,
+                data->next_arr + origin, data->stride, r0, r1, c0, c1,
+                data->rule);
+    }
+    else if (data->kernel == KERNEL_SIMD) {
+        //whole row strips of the region per instruction stream
+        live = data->simd_step(data->base_arr, data->next_arr, rows, cols,
+                r0, r1, c0, c1, data->rule);
+    }
+    else if (data->halo) {
+        for (int i = r0; i <= r1; i++) {
+            for (int j = c0; j <= c1; j++) {
+                long index = cell_index(data, i, j);
+
+                //neighbors are fixed offsets, no wraparound math
+                data->next_arr[index] = alive_or_dead(data->base_arr[index], get_neighbors_halo(data, index), data->rule);
+                live+=data->next_arr[index];
+            }
+        }
+    }
+    else {
+        for (int i = r0; i <= r1; i++) {
+            for (int j = c0; j <= c1; j++) {
+
+                //update next board, using our functions. We call alive our dead, with  get_neighbors called inside
+                data->next_arr[(i)*cols+(j)] = alive_or_dead(data->base_arr[(i)*cols+(j)], (get_neighbors(data,i,j)), data->rule);
+
+                //update alive count if cell is alive
+                live+=data->next_arr[(i)*cols+(j)];
+            }
+        }
+    }
+
+    //copy our wrapped edges into next's halo before the barrier
+    if (data->halo) {
+        fill_halo(data, data->next_arr, r0, r1, c0, c1);
+    }
+
+    return live;
+}
+
+/**************************************************************/
+/******************** Print Board **********************
+ * print_board: Prints the current Game of Life board in ASCII format.
+ *       The board is formatted into one buffer and written at once, in
+ *       the same format the renderer uses for the animation frames.
+ * data: Pointer to a gol_data structure containing grid and state information.
+ * round: The current round number of the simulation.
+ * returns: void.
+ ***************************************************************/
+
+void print_board(struct gol_data *data, int round) {
 
     int i, j;
+    char *text = malloc(render_text_size(data->rows, data->cols));
+    char *p = text;
+
+    if (!text) {
+        printf("malloc failed: board text\n");
+        exit(1);
+    }
 
     /* Print the round number. */
-    fprintf(stderr, "Round: %d\n", round);
+    p += sprintf(p, "Round: %d\n", round);
 
     for (i = 0; i < data->rows; ++i) {
         for (j = 0; j < data->cols; ++j) {
-            if (data->base_arr[(i)*data->cols+j] == 1) {
-                fprintf(stderr, " @");
-            }
-            else {
-                fprintf(stderr, " .");
-            }
+            *p++ = ' ';
+            *p++ = (get_cell(data, i, j) == 1) ? '@' : '.';
         }
-        fprintf(stderr, "\n");
+        *p++ = '\n';
     }
 
     /* Print the total number of live cells. */
-    fprintf(stderr, "Live cells: %d\n\n", total_live);
+    p += sprintf(p, "Live cells: %d\n\n", total_live);
+    fwrite(text, 1, p - text, stderr);
+    free(text);
 }
 /**************************************************************/
 ///////////////////   HELPER FUNCTIONS     /////////////////////
@@ -534,8 +1540,364 @@ void check_error(int ret) {
     }
 }
 
+/******************** Parse Options **********************
+ * parse_options: Reads the optional flags that follow the 5 positional
+ *       args and sets their defaults first.
+ * data: Pointer to the gol_data structure to fill in.
+ * argc, argv: command line args
+ * returns: void.
+ ***************************************************************/
+
+void parse_options(struct gol_data *data, int argc, char **argv) {
+    static struct option long_opts[] = {
+        {"kernel", required_argument, NULL, 'k'},
+        {"rule", required_argument, NULL, 'r'},
+        {"isa", required_argument, NULL, 'i'},
+        {"halo", no_argument, NULL, 'H'},
+        {"tile-size", required_argument, NULL, OPT_TILE_SIZE},
+        {"steal", no_argument, NULL, 's'},
+        {"active", no_argument, NULL, 'A'},
+        {"engine", required_argument, NULL, 'e'},
+        {"hl-mem", required_argument, NULL, OPT_HL_MEM},
+        {"unbounded", no_argument, NULL, 'u'},
+        {"population", required_argument, NULL, 'P'},
+        {"sync", required_argument, NULL, OPT_SYNC},
+        {"temporal", required_argument, NULL, 'T'},
+        {"checkpoint", required_argument, NULL, 'C'},
+        {"checkpoint-file", required_argument, NULL, OPT_CKPT_FILE},
+        {"rounds", required_argument, NULL, 'n'},
+        {"pin", required_argument, NULL, OPT_PIN},
+        {"times", required_argument, NULL, OPT_TIMES},
+        {"trace", required_argument, NULL, OPT_TRACE},
+        {"trace-counters", no_argument, NULL, OPT_TRACE_COUNTERS},
+        {"cycle", required_argument, NULL, OPT_CYCLE},
+        {"fps", required_argument, NULL, OPT_FPS},
+        {"stream", required_argument, NULL, OPT_STREAM},
+        {"stream-state", no_argument, NULL, OPT_STREAM_STATE},
+        {"pages", required_argument, NULL, OPT_PAGES},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+
+    //defaults
+    data->kernel = KERNEL_INT;
+    data->isa = ISA_AUTO;
+    data->rule = RULE_LIFE;
+    data->rule_given = 0;
+    data->simd_step = NULL;
+    data->simd_halo_step = NULL;
+    data->halo = 0;
+    data->stride = 0;
+    data->tile_rows = 0; //0: size tiles from the L2 size
+    data->tile_cols = 0;
+    data->steal = 0;
+    data->queues = NULL;
+    data->active = 0;
+    data->tile_nbrs = NULL;
+    data->tile_changed = NULL;
+    data->tile_changed_next = NULL;
+    data->tile_live = NULL;
+    data->engine = ENGINE_THREADS;
+    data->hl_max_bytes = (size_t)DEFAULT_HL_MEM_MB << 20;
+    data->unbounded = 0;
+    data->live_keys = NULL;
+    data->num_keys = 0;
+    data->live_counts = NULL;
+    data->history = NULL;
+    data->history_file = NULL;
+    data->round_secs = NULL;
+    data->times_file = NULL;
+    data->trace_file = NULL;
+    data->trace_counters = 0;
+    data->trace = NULL;
+    data->cycle_window = 0;
+    data->cycle = NULL;
+    data->fps = DEFAULT_FPS;
+    data->render = NULL;
+    data->stream_file = NULL;
+    data->stream_state = 0;
+    data->stream = NULL;
+    data->pages = ARENA_AUTO;
+    data->arena = NULL;
+    data->tile_hashes = NULL;
+    data->neighbor_sync = 0;
+    data->syncs = NULL;
+    data->sync_spins = 0;
+    data->tblock = 1;
+    data->tblock_rows = 0;
+    data->rounds = -1;
+    data->pin_policy = NULL;
+    data->cpus = NULL;
+    data->start_round = 0;
+    data->snap.addr = NULL;
+    data->checkpoint_every = 0;
+    data->checkpoint_file = DEFAULT_CKPT_FILE;
+    data->ckpt = NULL;
+
+    //the positional args are read in init_game_data_from_args
+    optind = 6;
+    while ((opt = getopt_long(argc, argv, "k:r:i:HsAe:uP:T:C:n:", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 'r':
+                if (rule_parse(optarg, &data->rule)) {
+                    printf("Bad rule: %s (B/S notation like B36/S23, or life,"
+                            " highlife, daynight, seeds)\n", optarg);
+                    exit(1);
+                }
+                data->rule_given = 1;
+                break;
+            case 'k':
+                if (strcmp(optarg, "int") == 0) {
+                    data->kernel = KERNEL_INT;
+                }
+                else if (strcmp(optarg, "bitpack") == 0) {
+                    data->kernel = KERNEL_BITPACK;
+                }
+                else if (strcmp(optarg, "simd") == 0) {
+                    data->kernel = KERNEL_SIMD;
+                }
+                else {
+                    printf("Unknown kernel: %s (int, bitpack or simd)\n",
+                            optarg);
+                    exit(1);
+                }
+                break;
+            case 'H':
+                data->halo = 1;
+                break;
+            case 'u':
+                data->unbounded = 1;
+                break;
+            case 'P':
+                data->history_file = optarg;
+                break;
+            case 'T':
+                data->tblock = atoi(optarg);
+                if (data->tblock < 1) {
+                    printf("Bad temporal block: %s (use K >= 1)\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'C':
+                data->checkpoint_every = atoi(optarg);
+                if (data->checkpoint_every < 1) {
+                    printf("Bad checkpoint interval: %s (use N >= 1)\n",
+                            optarg);
+                    exit(1);
+                }
+                break;
+            case 'n':
+                data->rounds = atoi(optarg);
+                if (data->rounds < 0) {
+                    printf("Bad round count: %s (use N >= 0)\n", optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_PIN:
+                data->pin_policy = optarg;
+                break;
+            case OPT_TIMES:
+                data->times_file = optarg;
+                break;
+            case OPT_TRACE:
+                data->trace_file = optarg;
+                break;
+            case OPT_TRACE_COUNTERS:
+                data->trace_counters = 1;
+                break;
+            case OPT_CYCLE:
+                data->cycle_window = atoi(optarg);
+                if (data->cycle_window < 1) {
+                    printf("Bad cycle window: %s (use P >= 1)\n", optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_FPS:
+                data->fps = atoi(optarg);
+                if (data->fps < 0) {
+                    printf("Bad frame rate: %s (use N >= 0)\n", optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_STREAM:
+                data->stream_file = optarg;
+                break;
+            case OPT_STREAM_STATE:
+                data->stream_state = 1;
+                break;
+            case OPT_PAGES:
+                if (strcmp(optarg, "auto") == 0) {
+                    data->pages = ARENA_AUTO;
+                }
+                else if (strcmp(optarg, "thp") == 0) {
+                    data->pages = ARENA_THP;
+                }
+                else if (strcmp(optarg, "small") == 0) {
+                    data->pages = ARENA_SMALL;
+                }
+                else {
+                    printf("Unknown pages: %s (auto, thp or small)\n",
+                            optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_CKPT_FILE:
+                data->checkpoint_file = optarg;
+                break;
+            case OPT_SYNC:
+                if (strcmp(optarg, "barrier") == 0) {
+                    data->neighbor_sync = 0;
+                }
+                else if (strcmp(optarg, "neighbor") == 0) {
+                    data->neighbor_sync = 1;
+                }
+                else {
+                    printf("Unknown sync: %s (barrier or neighbor)\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 's':
+                data->steal = 1;
+                break;
+            case 'A':
+                data->active = 1;
+                break;
+            case 'e':
+                if (strcmp(optarg, "threads") == 0) {
+                    data->engine = ENGINE_THREADS;
+                }
+                else if (strcmp(optarg, "hashlife") == 0) {
+                    data->engine = ENGINE_HASHLIFE;
+                }
+                else if (strcmp(optarg, "sparse") == 0) {
+                    data->engine = ENGINE_SPARSE;
+                }
+                else {
+                    printf("Unknown engine: %s (threads, hashlife or sparse)\n",
+                            optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_HL_MEM: {
+                long mb = atol(optarg);
+
+                if (mb < 1) {
+                    printf("Bad hashlife memory cap: %s (use MB >= 1)\n",
+                            optarg);
+                    exit(1);
+                }
+                data->hl_max_bytes = (size_t)mb << 20;
+                break;
+            }
+            case OPT_TILE_SIZE:
+                if (sscanf(optarg, "%dx%d", &data->tile_rows,
+                            &data->tile_cols) != 2
+                        || data->tile_rows < 1 || data->tile_cols < 1) {
+                    printf("Bad tile size: %s (use ROWSxCOLS)\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'i':
+                data->isa = simd_parse_isa(optarg);
+                if (data->isa < ISA_AUTO) {
+                    printf("Unknown isa: %s (auto, sse2, avx2 or avx512)\n",
+                            optarg);
+                    exit(1);
+                }
+                break;
+            default:
+                exit(1);
+        }
+    }
+}
+
+/******************** Get Cell **********************
+ * get_cell: Reads one cell of the current board in either storage format.
+ * data: Pointer to a gol_data structure containing the board.
+ * i, j: Row and column of the cell.
+ * returns: 1 if the cell is alive, 0 otherwise.
+ ***************************************************************/
+
+int get_cell(struct gol_data *data, int i, int j) {
+    if (data->engine == ENGINE_SPARSE) {
+        return sparse_has(data->live_keys, data->num_keys, sparse_key(i, j));
+    }
+    if (data->kernel == KERNEL_BITPACK) {
+        return bitboard_get(data->base_bits, data->words_per_row, i, j);
+    }
+    return data->base_arr[cell_index(data, i, j)];
+}
+
+/******************** Cell Index **********************
+ * cell_index: Finds where a cell is stored in base_arr and next_arr.
+ *       With a halo every row is cols+2 ints wide and starts one row
+ *       down, so (0, 0) sits just inside the halo corner.
+ * data: Pointer to a gol_data structure containing the board layout.
+ * i, j: Row and column of the cell, -1 and rows/cols reach the halo.
+ * returns: The index of the cell.
+ ***************************************************************/
+
+long cell_index(struct gol_data *data, int i, int j) {
+    return (long)(i + data->halo) * data->stride + (j + data->halo);
+}
+
+/******************** Fill Halo **********************
+ * fill_halo: Copies the cells of a region that sit on the board's edges
+ *       into the halo on the opposite side, so the next round can read
+ *       wrapped neighbors at fixed offsets. Each thread calls this for
+ *       its own region only, so halo writes never overlap.
+ * data: Pointer to a gol_data structure containing the board layout.
+ * arr: The board (base_arr or next_arr) to fill.
+ * r0, r1, c0, c1: The region the caller owns (inclusive).
+ * returns: void.
+ ***************************************************************/
+
+void fill_halo(struct gol_data *data, int *arr, int r0, int r1, int c0,
+        int c1) {
+    int rows = data->rows;
+    int cols = data->cols;
+    long stride = data->stride;
+    int *o = arr + cell_index(data, 0, 0); //cell (0, 0)
+
+    //the halo row above mirrors the last row, the one below the first
+    if (r1 == rows-1) {
+        memcpy(o - stride + c0, o + (rows-1)*stride + c0,
+                sizeof(int)*(c1-c0+1));
+    }
+    if (r0 == 0) {
+        memcpy(o + rows*stride + c0, o + c0, sizeof(int)*(c1-c0+1));
+    }
+
+    //the halo column left mirrors the last column, the one right the first
+    for (int i = r0; i <= r1; i++) {
+        if (c1 == cols-1) {
+            o[i*stride - 1] = o[i*stride + cols-1];
+        }
+        if (c0 == 0) {
+            o[i*stride + cols] = o[i*stride];
+        }
+    }
+
+    //each corner mirrors the diagonally opposite board corner
+    if (r1 == rows-1 && c1 == cols-1) {
+        o[-stride - 1] = o[(rows-1)*stride + cols-1];
+    }
+    if (r1 == rows-1 && c0 == 0) {
+        o[-stride + cols] = o[(rows-1)*stride];
+    }
+    if (r0 == 0 && c1 == cols-1) {
+        o[rows*stride - 1] = o[cols-1];
+    }
+    if (r0 == 0 && c0 == 0) {
+        o[rows*stride + cols] = o[0];
+    }
+}
+
 /******************** Run Animation Steps **********************
- * animation_action: Executes the animation step based on output mode.
+ * animation_action: Executes the animation step based on output mode,
+ *       on a round the frame clock picked. Nobody writes this round's
+ *       board until the round after next, so every thread packs its share
+ *       of the frame and goes on; the renderer thread prints it.
  * data: Pointer to a gol_data structure.
  * output_mode: The mode of animation (1: ASCII, 2: ParaVisi).
  * round: The current simulation round.
@@ -543,18 +1905,24 @@ void check_error(int ret) {
  ***************************************************************/
 
 void animation_action(struct gol_data *data, int output_mode, int round) {
+    struct render *r = data->render;
+
     if (output_mode == 1) {
-        //system("clear");
-        if (data->thread_id == 1) {
-            print_board(data, round);
+        int first, n;
+
+        render_rows(r, data->thread_id - 1, &first, &n);
+        if (n > 0) {
+            load_strip(data, r->slots[r->slot]
+                    + (long)first * bitboard_words(data->cols), first, n);
         }
-        usleep(SLEEP_USECS);
+        render_packed(r);
     }
+#ifndef GOL_HEADLESS
     else if (output_mode == 2) {
         update_colors(data);
         draw_ready(data->handle);
-        usleep(SLEEP_USECS);
     }        
+#endif
 }
 /******************** Find Number of Neighbors **********************
  * get_neighbors: Counts live neighbors for a cell in the grid.
@@ -575,7 +1943,7 @@ int get_neighbors(struct gol_data *data, int x, int y) {
             //do not count origin as neighbor
             if (ny != 0 || nx != 0) {
                 // using mod to wrap around grid, check neighbors
-                num_neighbors += data->base_arr[((nx+x+cols)%cols)*data->cols+((y+ny+rows)%rows)];
+                num_neighbors += data->base_arr[((x+ny+rows)%rows)*cols+((y+nx+cols)%cols)];
 
             }
 
@@ -584,25 +1952,496 @@ int get_neighbors(struct gol_data *data, int x, int y) {
 
     return num_neighbors;
 } 
+/******************** Make Tiles **********************
+ * make_tiles: Splits the board into 2D tiles for row_or_col == 2. A tile
+ *       of base and next fills about half of L2, so it stays cached while
+ *       it is computed. Tiles are numbered row-major, and each thread gets
+ *       a contiguous run of them (like the row and column bands).
+ * data: Pointer to a gol_data structure, rows/cols/num_threads are set.
+ * returns: void.
+ ***************************************************************/
+
+void make_tiles(struct gol_data *data) {
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    long budget;
+    int tiles_down, tiles_across, t, min_tiles;
+
+    if (l2 <= 0) {
+        l2 = DEFAULT_L2_BYTES;
+    }
+    //cells per tile so that its base and next use half of L2
+    budget = l2 / (4 * sizeof(int));
+
+    //unless --tile-size picked one
+    if (data->tile_rows == 0) {
+        data->tile_cols = (data->cols < TILE_MAX_COLS) ? data->cols : TILE_MAX_COLS;
+        data->tile_rows = budget / data->tile_cols;
+    }
+    if (data->tile_rows < 1) {
+        data->tile_rows = 1;
+    }
+    if (data->tile_rows > data->rows) {
+        data->tile_rows = data->rows;
+    }
+    if (data->tile_cols > data->cols) {
+        data->tile_cols = data->cols;
+    }
+
+    //small boards: make sure every thread gets at least one tile, or
+    //enough of them to balance the load when stealing
+    min_tiles = data->num_threads;
+    if (data->steal) {
+        min_tiles *= STEAL_TILES_PER_THREAD;
+    }
+    while (1) {
+        tiles_down = (data->rows + data->tile_rows - 1) / data->tile_rows;
+        tiles_across = (data->cols + data->tile_cols - 1) / data->tile_cols;
+        if (tiles_down * tiles_across >= min_tiles
+                || data->tile_rows == 1) {
+            break;
+        }
+        data->tile_rows = (data->tile_rows + 1) / 2;
+    }
+
+    data->num_tiles = tiles_down * tiles_across;
+    data->tiles = malloc(sizeof(struct gol_tile) * data->num_tiles);
+    if (!data->tiles) {
+        printf("malloc failed\n");
+        exit(1);
+    }
+
+    data->tiles_down = tiles_down;
+    data->tiles_across = tiles_across;
+
+    t = 0;
+    for (int tr = 0; tr < tiles_down; tr++) {
+        for (int tc = 0; tc < tiles_across; tc++) {
+            data->tiles[t].r0 = tr * data->tile_rows;
+            data->tiles[t].r1 = data->tiles[t].r0 + data->tile_rows - 1;
+            if (data->tiles[t].r1 > data->rows - 1) {
+                data->tiles[t].r1 = data->rows - 1;
+            }
+            data->tiles[t].c0 = tc * data->tile_cols;
+            data->tiles[t].c1 = data->tiles[t].c0 + data->tile_cols - 1;
+            if (data->tiles[t].c1 > data->cols - 1) {
+                data->tiles[t].c1 = data->cols - 1;
+            }
+            t++;
+        }
+    }
+
+    if (data->active) {
+        make_tile_tracking(data);
+    }
+
+    if (data->printinfo == 1) {
+        printf("%d tiles of %d x %d (L2: %ld KB)\n", data->num_tiles,
+                data->tile_rows, data->tile_cols, l2 / 1024);
+    }
+}
+
+/******************** Make Tile Tracking **********************
+ * make_tile_tracking: Sets up active-region tracking once the tiles exist:
+ *       the wrapping 8-neighborhood of every tile, and change flags that
+ *       start out set so every tile is computed in the first round.
+ * data: Pointer to a gol_data structure, tiles already made.
+ * returns: void.
+ ***************************************************************/
+
+void make_tile_tracking(struct gol_data *data) {
+    int n = data->num_tiles;
+    int down = data->tiles_down;
+    int across = data->tiles_across;
+
+    data->tile_nbrs = malloc(sizeof(*data->tile_nbrs) * n);
+    data->tile_changed = malloc(n);
+    data->tile_changed_next = malloc(n);
+    data->tile_live = malloc(sizeof(int) * n);
+    if (data->cycle_window) {
+        data->tile_hashes = malloc(sizeof(uint64_t) * n);
+    }
+    if (!data->tile_nbrs || !data->tile_changed || !data->tile_changed_next
+            || !data->tile_live || (data->cycle_window && !data->tile_hashes)) {
+        printf("malloc failed\n");
+        exit(1);
+    }
+
+    for (int t = 0; t < n; t++) {
+        int tr = t / across;
+        int tc = t % across;
+        int k = 0;
+
+        for (int dr = -1; dr <= 1; dr++) {
+            for (int dc = -1; dc <= 1; dc++) {
+                if (dr != 0 || dc != 0) {
+                    data->tile_nbrs[t][k++] = ((tr+dr+down)%down)*across
+                        + (tc+dc+across)%across;
+                }
+            }
+        }
+        data->tile_changed[t] = 1;
+        data->tile_changed_next[t] = 1;
+        data->tile_live[t] = 0;
+    }
+}
+
+/******************** Step Tile **********************
+ * step_tile: Computes one tile, or with active-region tracking skips it
+ *       when neither it nor any tile around it changed last round: its
+ *       inputs are then the same as last round, so its cells and live
+ *       count are too. next_arr already holds those cells, because the
+ *       tile did not change between the two boards either.
+ * data: Pointer to this thread's gol_data structure.
+ * t: The tile number.
+ * returns: The number of live cells in the tile after the step.
+ ***************************************************************/
+
+int step_tile(struct gol_data *data, int t) {
+    struct gol_tile *tile = &data->tiles[t];
+    int live, dirty;
+
+    if (!data->active) {
+        return step_region(data, tile->r0, tile->r1, tile->c0, tile->c1);
+    }
+
+    dirty = data->tile_changed[t];
+    for (int k = 0; k < 8 && !dirty; k++) {
+        dirty = data->tile_changed[data->tile_nbrs[t][k]];
+    }
+    if (!dirty) {
+        data->tile_changed_next[t] = 0;
+        data->tiles_skipped++;
+        return data->tile_live[t];
+    }
+
+    live = step_region(data, tile->r0, tile->r1, tile->c0, tile->c1);
+    data->tile_changed_next[t] = region_changed(data, tile->r0, tile->r1,
+            tile->c0, tile->c1);
+    data->tile_live[t] = live;
+    return live;
+}
+
+/******************** Hash Mix **********************
+ * hash_mix: The splitmix64 finalizer, every input bit flips about half
+ *       the output bits.
+ ***************************************************************/
+
+static inline uint64_t hash_mix(uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+/******************** Hash Region **********************
+ * hash_region: Hashes a rectangle of one board. Every 64 cells of a row
+ *       are mixed with a key made from their position, and the results
+ *       are added up, so the mixes are independent of each other (they
+ *       pipeline) and the hash of a board is the sum of the hashes of the
+ *       parts it is cut into, whichever thread hashes them and in whatever
+ *       order, as long as the cut stays the same.
+ * data: Pointer to a gol_data structure containing the boards.
+ * next: 1 to hash the next board, 0 for base.
+ * r0, r1, c0, c1: The region (inclusive); whole rows for bitpack.
+ * returns: The hash.
+ ***************************************************************/
+
+uint64_t hash_region(struct gol_data *data, int next, int r0, int r1, int c0,
+        int c1) {
+    uint64_t sum = 0;
+
+    for (int i = r0; i <= r1; i++) {
+        //the key of word w of the row is key + w * step
+        uint64_t key = hash_mix(((uint64_t)i << 32) | (uint32_t)c0);
+        const uint64_t step = 0x9e3779b97f4a7c15ull;
+
+        if (data->kernel == KERNEL_BITPACK) {
+            //bits past the last column are always 0
+            const uint64_t *row = (next ? data->next_bits : data->base_bits)
+                + (long)i * data->words_per_row;
+
+            for (int w = 0; w < data->words_per_row; w++) {
+                sum += hash_mix(row[w] ^ (key + w * step));
+            }
+        }
+        else {
+            const int *row = (next ? data->next_arr : data->base_arr)
+                + cell_index(data, i, c0);
+            const uint64_t *keys = data->cycle->cell_keys;
+            int n = c1 - c0 + 1;
+
+            //rather than packing 64 cells into a word bit by bit, add
+            //up a random key for each live one: the same cells give the
+            //same word, and the masked adds vectorize
+            for (int j = 0; j < n; j += 64) {
+                int m = (n - j < 64) ? n - j : 64;
+                uint64_t word = 0;
+
+                for (int k = 0; k < m; k++) {
+                    word += keys[k] & -(uint64_t)row[j+k];
+                }
+                sum += hash_mix(word ^ (key + (j >> 6) * step));
+            }
+        }
+    }
+    return sum;
+}
+
+/******************** Hash Tile **********************
+ * hash_tile: Hashes one tile of the next board just after it was
+ *       computed. With active-region tracking a tile that did not change
+ *       this round (computed or skipped) still has last round's hash.
+ * data: Pointer to this thread's gol_data structure.
+ * t: The tile number.
+ * returns: The hash.
+ ***************************************************************/
+
+uint64_t hash_tile(struct gol_data *data, int t) {
+    struct gol_tile *tile = &data->tiles[t];
+    uint64_t h;
+
+    if (data->active && !data->tile_changed_next[t]) {
+        return data->tile_hashes[t];
+    }
+    h = hash_region(data, 1, tile->r0, tile->r1, tile->c0, tile->c1);
+    if (data->active) {
+        data->tile_hashes[t] = h;
+    }
+    return h;
+}
+
+/******************** Stream Region **********************
+ * stream_region: Adds a rectangle of the round just computed to this
+ *       thread's part of the --stream record: births and deaths (next
+ *       against base), the bounding box of next's live cells and, with
+ *       --stream-state, the changed words. Called right after the region
+ *       is stepped, while both boards are still in cache.
+ * data: Pointer to a gol_data structure containing the boards.
+ * part: This thread's part of the round.
+ * r0, r1, c0, c1: The region (inclusive); whole rows for bitpack, and
+ *       whole rows for any kernel with --stream-state.
+ * returns: void.
+ ***************************************************************/
+
+void stream_region(struct gol_data *data, struct stream_part *part, int r0,
+        int r1, int c0, int c1) {
+    int wpr = data->words_per_row;
+    int state = data->stream_state;
+
+    for (int i = r0; i <= r1; i++) {
+        if (data->kernel == KERNEL_BITPACK) {
+            const uint64_t *before = data->base_bits + (long)i * wpr;
+            const uint64_t *after = data->next_bits + (long)i * wpr;
+
+            stream_part_row(part, state, (long)i * wpr, i, before, after,
+                    wpr);
+        }
+        else {
+            const int *before = data->base_arr + cell_index(data, i, c0);
+            const int *after = data->next_arr + cell_index(data, i, c0);
+            int n = c1 - c0 + 1;
+
+            //64 cells at a time, packed like the bitpack board
+            for (int j = 0; j < n; j += 64) {
+                int m = (n - j < 64) ? n - j : 64;
+                uint64_t b = 0, a = 0;
+
+                for (int k = 0; k < m; k++) {
+                    b |= (uint64_t)(before[j+k] & 1) << k;
+                    a |= (uint64_t)(after[j+k] & 1) << k;
+                }
+                stream_part_word(part, state, (long)i * wpr + ((c0 + j) >> 6),
+                        i, c0 + j, b, a);
+            }
+        }
+    }
+}
+
+/******************** Stream Tile **********************
+ * stream_tile: stream_region over one tile.
+ ***************************************************************/
+
+void stream_tile(struct gol_data *data, struct stream_part *part, int t) {
+    struct gol_tile *tile = &data->tiles[t];
+
+    stream_region(data, part, tile->r0, tile->r1, tile->c0, tile->c1);
+}
+
+/******************** Hash Partition **********************
+ * hash_partition: Hashes this thread's part of the board as loaded, cut
+ *       the same way the rounds will hash it: its band, or its tiles
+ *       (every tile has one owner before any stealing).
+ * data: Pointer to this thread's gol_data structure.
+ * returns: The hash.
+ ***************************************************************/
+
+uint64_t hash_partition(struct gol_data *data) {
+    uint64_t h = 0;
+
+    if (data->row_or_col == 2) {
+        for (int t = data->start_index; t <= data->end_index; t++) {
+            struct gol_tile *tile = &data->tiles[t];
+            uint64_t th = hash_region(data, 0, tile->r0, tile->r1, tile->c0,
+                    tile->c1);
+
+            if (data->active) {
+                data->tile_hashes[t] = th;
+            }
+            h += th;
+        }
+    }
+    else if (data->row_or_col == 0) {
+        h = hash_region(data, 0, data->start_index, data->end_index, 0,
+                data->cols-1);
+    }
+    else {
+        h = hash_region(data, 0, 0, data->rows-1, data->start_index,
+                data->end_index);
+    }
+    return h;
+}
+
+/******************** Check Cycle **********************
+ * check_cycle: Thread 1, once a round's hashes are all in: looks for the
+ *       same hash and live count among the last window rounds. If round
+ *       repeats round s, the board has period p = round - s from s on, so
+ *       round iters is the same board as round + (iters - round) % p, and
+ *       only that many more rounds need computing. Otherwise the round
+ *       replaces the oldest one in the history.
+ * data: Pointer to thread 1's gol_data structure.
+ * round: The round just finished.
+ * hash, live: Its board's hash and live count.
+ * returns: void.
+ ***************************************************************/
+
+void check_cycle(struct gol_data *data, int round, uint64_t hash, int live) {
+    struct cycle_state *cyc = data->cycle;
+    int slot = round % cyc->window;
+
+    if (cyc->period) {
+        return;
+    }
+    for (int k = 0; k < cyc->window; k++) {
+        if (cyc->rounds[k] >= 0 && cyc->hashes[k] == hash
+                && cyc->lives[k] == live) {
+            cyc->period = round - cyc->rounds[k];
+            cyc->start = cyc->rounds[k];
+            cyc->found_at = round;
+            cyc->end_round = round + (data->iters - round) % cyc->period;
+            return;
+        }
+    }
+    cyc->hashes[slot] = hash;
+    cyc->lives[slot] = live;
+    cyc->rounds[slot] = round;
+}
+
+/******************** Region Changed **********************
+ * region_changed: Compares a just-computed region with the previous round,
+ *       a row at a time while it is still in cache.
+ * data: Pointer to a gol_data structure containing both boards.
+ * r0, r1, c0, c1: The region (inclusive).
+ * returns: 1 if any cell differs, 0 otherwise.
+ ***************************************************************/
+
+int region_changed(struct gol_data *data, int r0, int r1, int c0, int c1) {
+    for (int i = r0; i <= r1; i++) {
+        long index = cell_index(data, i, c0);
+
+        if (memcmp(data->base_arr + index, data->next_arr + index,
+                    sizeof(int)*(c1-c0+1)) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/******************** Take Tile **********************
+ * take_tile: Hands out the next tile to compute this round. A thread
+ *       first takes from the front of its own queue, in order, and once
+ *       that is empty steals from the back of the other queues, so the
+ *       owner keeps walking its tiles in order while thieves take the
+ *       ones it is farthest from. A queue that ran empty stays empty
+ *       until the next round, so one pass over the others is enough.
+ * data: Pointer to this thread's gol_data structure.
+ * returns: The tile number, or -1 when every queue is empty.
+ ***************************************************************/
+
+int take_tile(struct gol_data *data) {
+    int me = data->thread_id - 1;
+
+    for (int k = 0; k < data->num_threads; k++) {
+        struct tile_queue *q = &data->queues[(me + k) % data->num_threads];
+        uint64_t range = __atomic_load_n(&q->range, __ATOMIC_ACQUIRE);
+
+        while (1) {
+            uint32_t lo = (uint32_t)range;
+            uint32_t hi = (uint32_t)(range >> 32);
+            uint64_t taken;
+
+            if (lo >= hi) {
+                break; //this queue is empty for the rest of the round
+            }
+            if (k == 0) {
+                taken = ((uint64_t)hi << 32) | (lo + 1);
+            } else {
+                taken = ((uint64_t)(hi - 1) << 32) | lo;
+            }
+            //on failure range is reloaded and we try again
+            if (__atomic_compare_exchange_n(&q->range, &range, taken, 0,
+                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                if (k == 0) {
+                    data->tiles_own++;
+                    return lo;
+                }
+                data->tiles_stolen++;
+                return hi - 1;
+            }
+        }
+    }
+    return -1;
+}
+
+/******************** Monotonic Time **********************
+ * now_secs: Reads CLOCK_MONOTONIC, for measuring intervals.
+ * returns: The current time in seconds.
+ ***************************************************************/
+
+double now_secs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/******************** Find Number of Neighbors (Halo) **********************
+ * get_neighbors_halo: Counts live neighbors for a cell of a halo board.
+ *       The halo holds the wrapped edges, so every neighbor is a fixed
+ *       offset from the cell: no branches and no division.
+ * data: Pointer to a gol_data structure containing grid information.
+ * index: Index of the cell in base_arr (from cell_index).
+ * returns: Number of live neighbors (0-8).
+ ***************************************************************/
+
+int get_neighbors_halo(struct gol_data *data, long index) {
+    const int *c = data->base_arr + index;
+    long s = data->stride;
+
+    return c[-s-1] + c[-s] + c[-s+1] + c[-1] + c[1] + c[s-1] + c[s] + c[s+1];
+}
 /******************** Game Logic Determinator **********************
  * alive_or_dead: Determines the next state of a cell.
  * cell_status: Current status of the cell (1: alive, 0: dead).
  * num_neighbors: Number of live neighbors for the cell.
+ * rule: The rule, see rule.h.
  * returns: 1 if the cell is alive in the next generation, 0 otherwise.
  ***************************************************************/
 
-int alive_or_dead(int cell_status, int num_neighbors) {
-    // checking the cell status based on gol rules
-    if ((num_neighbors == 2 && cell_status == 1) || num_neighbors == 3) {
-        return 1;
-    }
-    else {
-        return 0;
-    }
-   
-
+int alive_or_dead(int cell_status, int num_neighbors, uint32_t rule) {
+    //the rule word has a bit for every (status, neighbors) pair
+    return rule_next(rule, cell_status, num_neighbors);
 }
 
+#ifndef GOL_HEADLESS
 /******************** Update ParaVisi Colors **********************
  * update_colors: Updates the ParaVisi animation buffer based on grid state.
  * data: Pointer to a gol_data structure containing grid and thread information.
@@ -612,35 +2451,52 @@ int alive_or_dead(int cell_status, int num_neighbors) {
 
 void update_colors(struct gol_data *data) {
 
-    int rows, cols, index, buff_i, row_start,row_end,col_start,col_end;
-    color3 *buff;
+    int rows, cols;
 
-    buff = data->image_buff;  // just for readability
     rows = data->rows;
     cols = data->cols;
 
-    if(data->row_or_col == 0){
-        row_start = data->start_index;
-        row_end = data->end_index;
-        col_start = 0;
-        col_end = cols-1;
+    if (data->row_or_col == 2) {
+        for (int t = data->start_index; t <= data->end_index; t++) {
+            struct gol_tile *tile = &data->tiles[t];
+
+            update_colors_region(data, tile->r0, tile->r1, tile->c0, tile->c1);
+        }
+    } else if(data->row_or_col == 0){
+        update_colors_region(data, data->start_index, data->end_index, 0,
+                cols-1);
     } else {
-        col_start = data->start_index;
-        col_end = data->end_index;
-        row_start = 0;
-        row_end = rows-1;
+        update_colors_region(data, 0, rows-1, data->start_index,
+                data->end_index);
     }
+}
+
+/******************** Update ParaVisi Colors (Region) **********************
+ * update_colors_region: Colors one rectangle of the animation buffer.
+ * data: Pointer to a gol_data structure containing grid and thread information.
+ * row_start, row_end, col_start, col_end: The region (inclusive).
+ * returns: void.
+ ***************************************************************/
+
+void update_colors_region(struct gol_data *data, int row_start, int row_end,
+        int col_start, int col_end) {
+
+    int rows, cols, buff_i;
+    color3 *buff;
+
+    buff = data->image_buff;  // just for readability
+    rows = data->rows;
+    cols = data->cols;
 
     for (int j = col_start; j <= col_end;j++) {
         for (int i = row_start; i <= row_end; i++) {
-        index = i*cols + j;
         // translate row index to y-coordinate value because in
         // the image buffer, (r,c)=(0,0) is the _lower_ left but
         // in the grid, (r,c)=(0,0) is _upper_ left.
         buff_i = (rows - (i+1))*cols + j;
 
         // update animation buffer, set to black if alive, colored if dead
-        if (data->base_arr[index] == 1) {
+        if (get_cell(data, i, j) == 1) {
             buff[buff_i] = c3_black;
         } 
         else {
@@ -649,6 +2505,7 @@ void update_colors(struct gol_data *data) {
         }
     }  
 }
+#endif
 
 /******************** Threading Implementation **********************
  * partition_threads: Divides grid data among threads and creates threads.
@@ -669,10 +2526,95 @@ void partition_threads(struct gol_data *data) {
     targs = malloc(sizeof(struct gol_data) * num_threads);
     if (!targs) { perror("malloc: int array"); exit(1); }
 
-    //assign partition info while we create threads
-    for(int i = 0; i<num_threads; i++) {
-        targs[i] = *data;
-        targs[i].thread_id = i+1;
+    //set before the copies in targs are made, they share the writer
+    //and the trace; a round has at most 6 intervals (2 neighbor waits
+    //or a barrier, compute, barrier, checkpoint, output)
+    if (data->trace_file) {
+        long events = 6L * (data->iters - data->start_round + 1) + 2;
+
+        data->trace = trace_create(num_threads, (events < TRACE_MAX_EVENTS)
+                ? events : TRACE_MAX_EVENTS, data->trace_counters);
+    }
+    if (data->cycle_window) {
+        struct cycle_state *cyc = malloc(sizeof(*cyc));
+        int w = data->cycle_window;
+
+        if (!cyc) { perror("malloc: cycle history"); exit(1); }
+        cyc->window = w;
+        cyc->hashes = malloc(sizeof(uint64_t) * w);
+        cyc->lives = malloc(sizeof(int) * w);
+        cyc->rounds = malloc(sizeof(int) * w);
+        if (!cyc->hashes || !cyc->lives || !cyc->rounds) {
+            perror("malloc: cycle history");
+            exit(1);
+        }
+        for (int k = 0; k < w; k++) {
+            cyc->rounds[k] = -1;
+        }
+        cyc->end_round = data->iters;
+        cyc->period = 0;
+        cyc->start = 0;
+        cyc->found_at = 0;
+        for (int k = 0; k < 64; k++) {
+            cyc->cell_keys[k] = hash_mix(0x9e3779b97f4a7c15ull * (k + 1));
+        }
+        data->cycle = cyc;
+    }
+    if (data->checkpoint_every) {
+        data->ckpt = snapshot_writer_start(data->checkpoint_file, data->rows,
+                data->cols, data->iters, data->rule, data->checkpoint_every,
+                num_threads);
+    }
+    //the board as loaded is the stream's first record
+    if (data->stream_file) {
+        uint64_t *bits = data->base_bits;
+
+        if (data->kernel != KERNEL_BITPACK) {
+            bits = arena_alloc(data->arena, sizeof(uint64_t)
+                    * (size_t)data->rows * data->words_per_row);
+            if (!bits) {
+                printf("malloc failed: stream board\n");
+                exit(1);
+            }
+            load_strip(data, bits, 0, data->rows);
+        }
+        data->stream = stream_start(data->stream_file, data->rows, data->cols,
+                data->rule, data->stream_state, num_threads,
+                data->start_round, bits);
+    }
+    //ASCII frames are drawn by the renderer, ParaVisi only needs the clock
+    if (data->output_mode != OUTPUT_NONE) {
+        data->render = render_start(data->rows, data->cols, num_threads,
+                data->fps, data->output_mode == OUTPUT_ASCII
+                ? STDERR_FILENO : -1);
+    }
+
+    //one cache line per thread's live count
+    data->live_counts = aligned_alloc(64, sizeof(struct live_count) * num_threads);
+    if (!data->live_counts) { perror("malloc: live counts"); exit(1); }
+
+    //and per thread's last finished round, for neighbor sync
+    if (data->neighbor_sync) {
+        data->syncs = aligned_alloc(64, sizeof(struct part_sync) * num_threads);
+        if (!data->syncs) { perror("malloc: partition syncs"); exit(1); }
+        for (int i = 0; i < num_threads; i++) {
+            data->syncs[i].done = 0;
+            data->syncs[i].sleepers = 0;
+        }
+        data->sync_spins = (num_threads > sysconf(_SC_NPROCESSORS_ONLN))
+            ? 0 : SYNC_SPINS;
+    }
+
+    //one cache line per thread's tile queue
+    if (data->steal) {
+        data->queues = aligned_alloc(64, sizeof(struct tile_queue) * num_threads);
+        if (!data->queues) { perror("malloc: tile queues"); exit(1); }
+    }
+
+    //assign partition info while we create threads
+    for(int i = 0; i<num_threads; i++) {
+        targs[i] = *data;
+        targs[i].thread_id = i+1;
 
         if (i < targs[i].extra_data) {
             targs[i].data_per_thread++;
@@ -685,24 +2627,161 @@ void partition_threads(struct gol_data *data) {
             targs[i].start_index =  targs[i-1].end_index+1;
             targs[i].end_index = targs[i].start_index + targs[i].data_per_thread - 1;
         }
+        targs[i].busy_secs = 0.0;
+        targs[i].idle_secs = 0.0;
+        targs[i].tiles_own = 0;
+        targs[i].tiles_stolen = 0;
+        targs[i].tiles_skipped = 0;
+        targs[i].nbr_before = (i - 1 + num_threads) % num_threads;
+        targs[i].nbr_after = (i + 1) % num_threads;
+        if (data->steal) {
+            //each thread refills its queue with these at the top of a round
+            data->queues[i].first = targs[i].start_index;
+            data->queues[i].last = targs[i].end_index;
+        }
 
 
         ret = pthread_create(&tid[i], NULL, play_gol, &targs[i]);
         if (ret) { perror("Error: pthread_create"); exit(1); }
     }
     
+#ifndef GOL_HEADLESS
     // start ParaVisi animation
     if (data->output_mode == 2) {
-        run_animation(data->handle, data->iters);
+        run_animation(data->handle, data->iters - data->start_round);
     }
+#endif
     //join threads
     for(int i = 0; i<num_threads;i++) {
         pthread_join(tid[i],0);
     }
 
-    pthread_mutex_destroy(&my_mutex);
     pthread_barrier_destroy(&my_barrier);
 
+    if (data->trace) {
+        trace_finish(data->trace);
+        trace_write_json(data->trace, data->trace_file);
+        trace_print_summary(data->trace);
+        trace_destroy(data->trace);
+        data->trace = NULL;
+    }
+
+    //with neighbor sync the last round's counts were never added up
+    if (data->neighbor_sync && data->iters > data->start_round) {
+        total_live = 0;
+        for (int i = 0; i < num_threads; i++) {
+            total_live += data->live_counts[i].count;
+        }
+    }
+    //the threads swapped their copies of the board pointers once per
+    //pass (per round, unless temporal blocking), so after an odd number of
+    //passes the last round is in our next board. A cycle ends the run at
+    //its end_round, which is the same board as iters
+    int last_round = data->cycle ? data->cycle->end_round : data->iters;
+
+    if (((last_round - data->start_round + data->tblock - 1) / data->tblock)
+            % 2 != 0) {
+        int *temp = data->base_arr;
+        uint64_t *temp_bits = data->base_bits;
+
+        data->base_arr = data->next_arr;
+        data->next_arr = temp;
+        data->base_bits = data->next_bits;
+        data->next_bits = temp_bits;
+    }
+
+    free(data->live_counts);
+    data->live_counts = NULL;
+    free(data->syncs);
+    data->syncs = NULL;
+
+    if (data->cycle) {
+        struct cycle_state *cyc = data->cycle;
+
+        if (cyc->period) {
+            printf("Cycle: period %d from round %d (seen at round %d),"
+                    " rounds %d to %d skipped\n", cyc->period, cyc->start,
+                    cyc->found_at, cyc->end_round + 1, data->iters);
+            //the skipped rounds repeat the cycle's counts
+            if (data->history) {
+                for (int r = cyc->end_round + 1; r <= data->iters; r++) {
+                    data->history[r] = data->history[cyc->start
+                        + (r - cyc->start) % cyc->period];
+                }
+            }
+        }
+        else {
+            printf("Cycle: none with period <= %d in %d rounds\n",
+                    cyc->window, data->iters - data->start_round);
+        }
+        free(cyc->hashes);
+        free(cyc->lives);
+        free(cyc->rounds);
+        free(cyc);
+        data->cycle = NULL;
+    }
+
+    //the last checkpoint may still be on its way to disk
+    if (data->ckpt) {
+        long written, skipped;
+
+        snapshot_writer_stop(data->ckpt, &written, &skipped);
+        data->ckpt = NULL;
+        if (data->printinfo == 1) {
+            printf("Checkpoints: %ld written to %s, %ld skipped (writer"
+                    " busy)\n", written, data->checkpoint_file, skipped);
+        }
+    }
+
+    //the writer may be a few rounds behind
+    if (data->stream) {
+        long long last, bytes;
+        long waits;
+
+        if (stream_stop(data->stream, &last, &bytes, &waits)) {
+            printf("Warning: failed to write %s\n", data->stream_file);
+        }
+        data->stream = NULL;
+        if (data->printinfo == 1) {
+            printf("Stream: rounds %d to %lld, %lld bytes to %s, %ld waits"
+                    " for the writer\n", data->start_round, last, bytes,
+                    data->stream_file, waits);
+        }
+    }
+
+    //the last frame may still be on its way to the terminal
+    if (data->render) {
+        long frames, dropped;
+
+        render_stop(data->render, &frames, &dropped);
+        data->render = NULL;
+        if (data->printinfo == 1) {
+            printf("Frames: %ld drawn, %ld dropped\n", frames, dropped);
+        }
+    }
+
+    if (data->active) {
+        long skipped = 0;
+        long steps = (long)data->num_tiles
+            * (last_round - data->start_round);
+
+        for (int i = 0; i < num_threads; i++) {
+            skipped += targs[i].tiles_skipped;
+        }
+        printf("Tiles skipped: %ld of %ld (%.1f%%)\n", skipped, steps,
+                steps ? 100.0 * skipped / steps : 0.0);
+    }
+
+    if (data->steal) {
+        for (int i = 0; i < num_threads; i++) {
+            printf("tid %4d: busy %8.3f s  idle %8.3f s  tiles: %ld own, %ld stolen\n",
+                    targs[i].thread_id, targs[i].busy_secs, targs[i].idle_secs,
+                    targs[i].tiles_own, targs[i].tiles_stolen);
+        }
+        free(data->queues);
+        data->queues = NULL;
+    }
+
     free(tid);
     free(targs);
     targs = NULL;
@@ -711,9 +2790,658 @@ void partition_threads(struct gol_data *data) {
 
 }
 
+/******************** Run Engine **********************
+ * run_engine: Runs all data->iters rounds with the engine picked on the
+ *       command line.
+ * data: Pointer to the gol_data structure with the initial board.
+ * returns: void, the final board is in base_arr/base_bits and total_live.
+ ***************************************************************/
+
+void run_engine(struct gol_data *data) {
+    if (data->engine == ENGINE_HASHLIFE) {
+        run_hashlife(data);
+    }
+    else if (data->engine == ENGINE_SPARSE) {
+        run_sparse(data);
+    }
+    else {
+        partition_threads(data);
+    }
+}
+
+/******************** Run HashLife **********************
+ * run_hashlife: Runs all the rounds with the hashlife engine. The board
+ *       is copied out to one byte per cell, advanced, and copied back
+ *       into whichever format the kernel uses, so printing and the live
+ *       count work as they do after the threaded engine.
+ * data: Pointer to the gol_data structure with the initial board.
+ * returns: void.
+ ***************************************************************/
+
+void run_hashlife(struct gol_data *data) {
+    int rows = data->rows;
+    int cols = data->cols;
+    struct hashlife_stats stats;
+    unsigned char *cells;
+    long long live;
+
+    cells = malloc((size_t)rows * cols);
+    if (!cells) { perror("malloc: hashlife cells"); exit(1); }
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            cells[(long)i*cols + j] = get_cell(data, i, j);
+        }
+    }
+
+    live = hashlife_run(cells, rows, cols, data->iters - data->start_round,
+            data->rule, data->hl_max_bytes, &stats);
+    if (live < 0) {
+        printf("hashlife: the board needs more than the %zu MB node cache"
+                " (raise --hl-mem)\n", data->hl_max_bytes >> 20);
+        exit(1);
+    }
+
+    //write the final board back
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            int alive = cells[(long)i*cols + j];
+
+            if (data->kernel == KERNEL_BITPACK) {
+                if (alive) {
+                    bitboard_set(data->base_bits, data->words_per_row, i, j);
+                }
+                else {
+                    data->base_bits[(long)i*data->words_per_row + (j >> 6)]
+                        &= ~((uint64_t)1 << (j & 63));
+                }
+            }
+            else {
+                data->base_arr[cell_index(data, i, j)] = alive;
+            }
+        }
+    }
+    if (data->halo && data->kernel != KERNEL_BITPACK) {
+        fill_halo(data, data->base_arr, 0, rows-1, 0, cols-1);
+    }
+    total_live = live;
+    free(cells);
+
+    if (data->printinfo == 1) {
+        printf("hashlife: %lld macro steps of %lld rounds, %ld nodes,"
+                " peak cache %.1f MB, %d gcs\n", stats.macro_steps,
+                stats.step_gens, stats.nodes, stats.peak_bytes / 1048576.0,
+                stats.gc_runs);
+        if (stats.period) {
+            printf("hashlife: period %lld found at round %lld,"
+                    " skipped %lld rounds\n", stats.period,
+                    stats.cycle_start, stats.skipped_gens);
+        }
+    }
+}
+/******************** Thread Share **********************
+ * thread_share: Splits total rows (or tiles) between n threads the way
+ *       partition_threads does: the first total % n threads get one more.
+ * total: The number of rows or tiles.
+ * n: The number of threads.
+ * t: The thread, 0 to n-1.
+ * first, last: Set to thread t's first and last item.
+ * returns: void.
+ ***************************************************************/
+
+void thread_share(int total, int n, int t, int *first, int *last) {
+    int share = total / n;
+    int extra = total % n;
+
+    *first = t * share + (t < extra ? t : extra);
+    *last = *first + share + (t < extra) - 1;
+}
+
+/******************** First Touch **********************
+ * first_touch: Zeroes the part of both boards thread t will compute, so
+ *       the kernel places those pages on t's NUMA node when the thread is
+ *       pinned there. That is t's row band, or with tiles each of its
+ *       tiles (its first tiles, if tiles are stolen). Column bands share
+ *       every page, so they get row bands here. The halo rows go to the
+ *       first and last threads.
+ * data: Pointer to the gol_data structure with the boards allocated.
+ * t: The thread, 0 to num_threads-1.
+ * returns: void.
+ ***************************************************************/
+
+void first_touch(struct gol_data *data, int t) {
+    int last = data->num_threads - 1;
+    int r0, r1;
+
+    if (data->kernel == KERNEL_BITPACK) {
+        thread_share(data->rows, data->num_threads, t, &r0, &r1);
+        size_t bytes = sizeof(uint64_t) * (size_t)(r1 - r0 + 1)
+            * data->words_per_row;
+        long first = (long)r0 * data->words_per_row;
+
+        //a mapped snapshot is the board, it is not ours to zero
+        if (!data->snap.addr) {
+            memset(data->base_bits + first, 0, bytes);
+        }
+        memset(data->next_bits + first, 0, bytes);
+        return;
+    }
+
+    if (data->row_or_col == 2) {
+        int t0, t1;
+        int h = data->halo;
+
+        thread_share(data->num_tiles, data->num_threads, t, &t0, &t1);
+        for (int k = t0; k <= t1; k++) {
+            struct gol_tile *tile = &data->tiles[k];
+            //tiles on the board's edge also own the halo column beside them
+            int c0 = tile->c0 - (tile->c0 == 0 ? h : 0);
+            int c1 = tile->c1 + (tile->c1 == data->cols - 1 ? h : 0);
+
+            for (int i = tile->r0; i <= tile->r1; i++) {
+                memset(data->base_arr + cell_index(data, i, c0), 0,
+                        sizeof(int) * (c1 - c0 + 1));
+                memset(data->next_arr + cell_index(data, i, c0), 0,
+                        sizeof(int) * (c1 - c0 + 1));
+            }
+        }
+        if (h && t == 0) {
+            memset(data->base_arr, 0, sizeof(int) * data->stride);
+            memset(data->next_arr, 0, sizeof(int) * data->stride);
+        }
+        if (h && t == last) {
+            long bottom = cell_index(data, data->rows, -1);
+
+            memset(data->base_arr + bottom, 0, sizeof(int) * data->stride);
+            memset(data->next_arr + bottom, 0, sizeof(int) * data->stride);
+        }
+        return;
+    }
+
+    //the first and last threads also take the halo rows
+    thread_share(data->rows, data->num_threads, t, &r0, &r1);
+    long first = (long)(r0 + (t ? data->halo : 0)) * data->stride;
+    long end = (long)(r1 + 1 + data->halo + (t == last ? data->halo : 0))
+        * data->stride;
+
+    memset(data->base_arr + first, 0, sizeof(int) * (end - first));
+    memset(data->next_arr + first, 0, sizeof(int) * (end - first));
+}
+
+/******************** Set Loaded Cell **********************
+ * set_int_cell, set_bit_cell, add_sparse_cell: board_cell_fn callbacks
+ *       that set one cell from the file, called by every load thread at
+ *       once. Distinct cells share bit-packed words, so those are set with
+ *       an atomic or.
+ ***************************************************************/
+
+void set_int_cell(void *ctx, long i, long j) {
+    struct gol_data *data = ctx;
+
+    data->base_arr[cell_index(data, i, j)] = 1;
+}
+
+void set_bit_cell(void *ctx, long i, long j) {
+    struct gol_data *data = ctx;
+
+    __atomic_fetch_or(&data->base_bits[i * data->words_per_row + (j >> 6)],
+            (uint64_t)1 << (j & 63), __ATOMIC_RELAXED);
+}
+
+void add_sparse_cell(void *ctx, long i, long j) {
+    struct load_part *part = ctx;
+
+    if (part->num_keys == part->cap_keys) {
+        part->cap_keys = part->cap_keys ? 2 * part->cap_keys : 1024;
+        part->keys = realloc(part->keys, sizeof(uint64_t) * part->cap_keys);
+        if (!part->keys) {
+            printf("malloc failed: sparse cells\n");
+            exit(1);
+        }
+    }
+    part->keys[part->num_keys++] = sparse_key(i, j);
+}
+
+/******************** Load Thread **********************
+ * load_worker: One load thread: zeroes its part of both boards first,
+ *       on the CPU its worker will be pinned to, so the pages are placed
+ *       where they will be used, then parses its part of the file.
+ * args: The load_part of this thread.
+ * returns: NULL.
+ ***************************************************************/
+
+void *load_worker(void *args) {
+    struct load_part *part = args;
+    struct gol_data *data = part->data;
+
+    if (data->cpus && affinity_pin(data->cpus[part->part])) {
+        printf("Warning: could not pin load thread %d to cpu %d\n",
+                part->part + 1, data->cpus[part->part]);
+    }
+    if (data->engine != ENGINE_SPARSE) {
+        first_touch(data, part->part);
+    }
+
+    //nobody sets a cell until every row is zeroed
+    pthread_barrier_wait(part->barrier);
+    if (!part->file->addr) {
+        part->cells = 0;
+        return NULL;
+    }
+    if (data->engine == ENGINE_SPARSE) {
+        part->cells = board_file_cells(part->file, part->part,
+                data->num_threads, data->unbounded, add_sparse_cell, part);
+    }
+    else {
+        part->cells = board_file_cells(part->file, part->part,
+                data->num_threads, 0, data->kernel == KERNEL_BITPACK
+                ? set_bit_cell : set_int_cell, data);
+    }
+    return NULL;
+}
+
+/******************** Load Cells **********************
+ * load_cells: Zeroes the allocated boards and sets the file's live cells
+ *       with num_threads threads, or builds the sparse engine's key list.
+ *       Sets total_live, and prints the load rate with printinfo.
+ * data: Pointer to the gol_data structure with the boards allocated.
+ * file: The mapped board file (not mapped when loading a snapshot).
+ * path: The file name, for messages.
+ * howmany: The live cells the file header promises, -1 if it has none.
+ * load_start: When loading began, from now_secs.
+ * returns: void.
+ ***************************************************************/
+
+void load_cells(struct gol_data *data, struct board_file *file,
+        const char *path, long howmany, double load_start) {
+    int n = data->num_threads;
+    struct load_part *parts;
+    pthread_t *tid;
+    pthread_barrier_t barrier;
+    long cells = 0;
+    double secs;
+
+    parts = calloc(n, sizeof(struct load_part));
+    tid = malloc(sizeof(pthread_t) * n);
+    if (!parts || !tid) {
+        printf("malloc failed: load threads\n");
+        exit(1);
+    }
+    pthread_barrier_init(&barrier, NULL, n);
+    for (int t = 0; t < n; t++) {
+        parts[t].data = data;
+        parts[t].file = file;
+        parts[t].barrier = &barrier;
+        parts[t].part = t;
+        if (pthread_create(&tid[t], NULL, load_worker, &parts[t])) {
+            perror("Error: pthread_create");
+            exit(1);
+        }
+    }
+    for (int t = 0; t < n; t++) {
+        pthread_join(tid[t], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+
+    for (int t = 0; t < n; t++) {
+        if (parts[t].cells < 0) {
+            exit(1);
+        }
+        cells += parts[t].cells;
+    }
+    if (file->addr && howmany >= 0 && cells != howmany) {
+        printf("Improper file format: %s lists %ld cells, its header says"
+                " %ld\n", path, cells, howmany);
+        exit(1);
+    }
+    if (cells > INT_MAX) {
+        printf("Too many live cells in %s\n", path);
+        exit(1);
+    }
+
+    //the sparse engine takes the parts' cells as one list
+    if (data->engine == ENGINE_SPARSE) {
+        long k = 0;
+
+        data->live_keys = malloc(sizeof(uint64_t) * (cells > 0 ? cells : 1));
+        if (!data->live_keys) {
+            printf("malloc failed, check file format\n");
+            exit(1);
+        }
+        for (int t = 0; t < n; t++) {
+            memcpy(data->live_keys + k, parts[t].keys,
+                    sizeof(uint64_t) * parts[t].num_keys);
+            k += parts[t].num_keys;
+            free(parts[t].keys);
+        }
+        data->num_keys = cells;
+    }
+    total_live = cells;
+
+    if (data->printinfo == 1 && file->addr) {
+        secs = now_secs() - load_start;
+        printf("Loaded %s: %.1f MB, %ld cells in %.3f s (%.1f MB/s)\n",
+                path, file->len / 1e6, cells, secs,
+                secs > 0 ? file->len / 1e6 / secs : 0.0);
+    }
+    free(parts);
+    free(tid);
+}
+
+/******************** Run Sparse **********************
+ * run_sparse: Runs all the rounds with the sparse engine. With an
+ *       unbounded plane, printing shows the rows x cols window at (0, 0).
+ * data: Pointer to the gol_data structure with the live cells.
+ * returns: void, the final cells are in live_keys and total_live.
+ ***************************************************************/
+
+void run_sparse(struct gol_data *data) {
+    struct sparse_stats stats;
+    long live;
+
+    live = sparse_run(&data->live_keys, data->num_keys, data->rows,
+            data->cols, data->unbounded, data->iters, data->rule, &stats);
+    if (live < 0) {
+        printf("sparse: a cell went past %d from (0, 0)\n", SPARSE_MAX_COORD);
+        exit(1);
+    }
+    data->num_keys = live;
+    total_live = live;
+
+    if (data->printinfo == 1) {
+        printf("sparse: peak %ld live cells, peak memory %.1f MB\n",
+                stats.peak_live, stats.peak_bytes / 1048576.0);
+        if (live > 0) {
+            long r0 = sparse_row(data->live_keys[0]);
+            long r1 = sparse_row(data->live_keys[live-1]);
+            long c0 = sparse_col(data->live_keys[0]);
+            long c1 = c0;
+
+            for (long k = 1; k < live; k++) {
+                long c = sparse_col(data->live_keys[k]);
+
+                c0 = c < c0 ? c : c0;
+                c1 = c > c1 ? c : c1;
+            }
+            printf("sparse: live cells within rows %ld..%ld, cols %ld..%ld\n",
+                    r0, r1, c0, c1);
+        }
+    }
+}
+/******************** Step Temporal **********************
+ * step_temporal: Temporal blocking: advances board rows r0..r1 by gens
+ *       rounds in one pass. The rows plus gens more on each side (the
+ *       cells that can reach the strip in gens rounds) are copied into a
+ *       bit-packed strip, stepped gens times in cache with the valid rows
+ *       shrinking by one on each side per round, and the middle is
+ *       written to the next board. Strips span whole rows, so columns
+ *       wrap inside the kernel as usual.
+ * data: Pointer to the gol_data structure with the boards.
+ * strip: This thread's two scratch strips.
+ * r0, r1: The rows to compute (inclusive).
+ * gens: Rounds to advance, at most data->tblock.
+ * returns: The live cells in rows r0..r1 after gens rounds.
+ ***************************************************************/
+
+int step_temporal(struct gol_data *data, uint64_t *strip[2], int r0, int r1,
+        int gens) {
+    int height = r1 - r0 + 1 + 2*gens;
+    int cur = 0;
+    int live = 0;
+
+    load_strip(data, strip[0], r0 - gens, height);
+    for (int t = 1; t <= gens; t++) {
+        //rows t-1..height-t are valid, so t..height-1-t can be computed
+        live = bitboard_step_rows(strip[cur], strip[1-cur], height,
+                data->cols, t, height - 1 - t, data->rule);
+        cur = 1 - cur;
+    }
+    store_strip(data, strip[cur] + (long)gens * bitboard_words(data->cols),
+            r0, r1);
+    return live;
+}
+
+/******************** Load Strip **********************
+ * load_strip: Copies board rows first..first+n-1 of the current board
+ *       (wrapping around the torus) into a bit-packed strip, packing int
+ *       boards 64 cells per word.
+ * data: Pointer to the gol_data structure with the boards.
+ * strip: Where to put the rows.
+ * first: The first board row, may be negative or past the last row.
+ * n: The number of rows.
+ * returns: void.
+ ***************************************************************/
+
+void load_strip(struct gol_data *data, uint64_t *strip, int first, int n) {
+    int rows = data->rows;
+    int cols = data->cols;
+    int wpr = bitboard_words(cols);
+
+    for (int s = 0; s < n; s++) {
+        int i = ((first + s) % rows + rows) % rows;
+        uint64_t *out = strip + (long)s * wpr;
+
+        if (data->kernel == KERNEL_BITPACK) {
+            memcpy(out, data->base_bits + (long)i * wpr, sizeof(uint64_t) * wpr);
+            continue;
+        }
+        const int *row = data->base_arr + cell_index(data, i, 0);
+
+        for (int w = 0; w < wpr; w++) {
+            int n_bits = (cols - w*64 < 64) ? cols - w*64 : 64;
+            uint64_t word = 0;
+
+            for (int b = 0; b < n_bits; b++) {
+                word |= (uint64_t)(row[w*64 + b] & 1) << b;
+            }
+            out[w] = word;
+        }
+    }
+}
+
+/******************** Store Strip **********************
+ * store_strip: Copies the rows of a strip into board rows r0..r1 of the
+ *       next board, unpacking them for int boards (and filling the halo).
+ * data: Pointer to the gol_data structure with the boards.
+ * strip: The strip row that goes to board row r0.
+ * r0, r1: The board rows to write (inclusive).
+ * returns: void.
+ ***************************************************************/
+
+void store_strip(struct gol_data *data, const uint64_t *strip, int r0,
+        int r1) {
+    int cols = data->cols;
+    int wpr = bitboard_words(cols);
+
+    for (int i = r0; i <= r1; i++) {
+        const uint64_t *in = strip + (long)(i - r0) * wpr;
+
+        if (data->kernel == KERNEL_BITPACK) {
+            memcpy(data->next_bits + (long)i * wpr, in, sizeof(uint64_t) * wpr);
+            continue;
+        }
+        int *row = data->next_arr + cell_index(data, i, 0);
+
+        for (int j = 0; j < cols; j++) {
+            row[j] = (in[j >> 6] >> (j & 63)) & 1;
+        }
+    }
+    if (data->halo) {
+        fill_halo(data, data->next_arr, r0, r1, 0, cols - 1);
+    }
+}
+
+/******************** Wait For Round **********************
+ * wait_for_round: Neighbor sync: returns once a partition has finished
+ *       round gen. Spins for a while first, since a neighbor is usually
+ *       close behind, then sleeps on the partition's done futex.
+ * sync: The partition to wait for.
+ * gen: The round it must have finished.
+ * spins: How many times to look before sleeping.
+ * returns: void.
+ ***************************************************************/
+
+void wait_for_round(struct part_sync *sync, int gen, int spins) {
+    int seen;
+
+    for (int spin = 0; spin < spins; spin++) {
+        if (__atomic_load_n(&sync->done, __ATOMIC_ACQUIRE) >= gen) {
+            return;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    //say we are going to sleep before the last look, so finish_round
+    //either sees us or we see its round
+    while (1) {
+        __atomic_store_n(&sync->sleepers, 1, __ATOMIC_SEQ_CST);
+        seen = __atomic_load_n(&sync->done, __ATOMIC_SEQ_CST);
+        if (seen >= gen) {
+            return;
+        }
+        syscall(SYS_futex, &sync->done, FUTEX_WAIT_PRIVATE, seen, NULL,
+                NULL, 0);
+    }
+}
+
+/******************** Finish Round **********************
+ * finish_round: Neighbor sync: publishes that a partition has finished
+ *       round gen (all its cells are written) and wakes any neighbor
+ *       asleep on it.
+ * sync: Our partition.
+ * gen: The round we finished.
+ * returns: void.
+ ***************************************************************/
+
+void finish_round(struct part_sync *sync, int gen) {
+    __atomic_store_n(&sync->done, gen, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sync->sleepers, __ATOMIC_SEQ_CST)
+            && __atomic_exchange_n(&sync->sleepers, 0, __ATOMIC_SEQ_CST)) {
+        syscall(SYS_futex, &sync->done, FUTEX_WAKE_PRIVATE, INT_MAX, NULL,
+                NULL, 0);
+    }
+}
+
+/******************** Write History **********************
+ * write_history: Writes the live cells after every round, one
+ *       "round live_cells" line per round from the round the board
+ *       was loaded at (0 unless it came from a snapshot).
+ * data: Pointer to the gol_data structure with the history.
+ * returns: void.
+ ***************************************************************/
+
+void write_history(struct gol_data *data) {
+    FILE *out = fopen(data->history_file, "w");
+
+    if (out == NULL) {
+        printf("Error: failed to open file: %s\n", data->history_file);
+        exit(1);
+    }
+    for (int r = data->start_round; r <= data->iters; r++) {
+        fprintf(out, "%d %d\n", r, data->history[r]);
+    }
+    check_error(fclose(out));
+}
+
+/******************** Write Round Times **********************
+ * write_times: Writes how long every round took, one "round seconds"
+ *       line each, measured by thread 1 from the end of the previous
+ *       round. Rounds of one temporal blocking pass get equal shares.
+ * data: Pointer to the gol_data structure with the times.
+ * returns: void.
+ ***************************************************************/
+
+void write_times(struct gol_data *data) {
+    FILE *out = fopen(data->times_file, "w");
+
+    if (out == NULL) {
+        printf("Error: failed to open file: %s\n", data->times_file);
+        exit(1);
+    }
+    for (int r = data->start_round + 1; r <= data->iters; r++) {
+        fprintf(out, "%d %.9f\n", r, data->round_secs[r]);
+    }
+    check_error(fclose(out));
+}
+
+/******************** Print Board Pages **********************
+ * print_pages: Prints the pages the board arena was mapped with and, for
+ *       transparent huge pages (which the kernel gives where it can, when
+ *       a page is first touched), how much of it actually got them.
+ * data: Pointer to the gol_data structure with the arena.
+ * returns: void.
+ ***************************************************************/
+
+void print_pages(struct gol_data *data) {
+    const struct arena *a = data->arena;
+    long page_kb, thp_kb;
+    double mb = a->size / (1024.0 * 1024.0);
+
+    if (arena_usage(a, &page_kb, &thp_kb)) {
+        printf("Pages: %s, %.1f MB arena\n", arena_pages_name(a->pages), mb);
+        return;
+    }
+    if (a->pages == ARENA_PAGES_THP) {
+        printf("Pages: %s, %.1f of %.1f MB arena on huge pages\n",
+                arena_pages_name(a->pages), thp_kb / 1024.0, mb);
+    }
+    else {
+        printf("Pages: %s (%ld KB), %.1f MB arena\n",
+                arena_pages_name(a->pages), page_kb, mb);
+    }
+}
+
+/******************** Load Snapshot Board **********************
+ * load_snapshot_board: Fills the new board from the mapped snapshot. A
+ *       bitpack board already is the mapping, so there is nothing to do;
+ *       int boards are unpacked and the mapping is dropped.
+ * data: Pointer to the gol_data structure, with data->snap mapped.
+ * base_arr: The zeroed int board (NULL for the bitpack kernel).
+ * returns: void.
+ ***************************************************************/
+
+void load_snapshot_board(struct gol_data *data, int *base_arr) {
+    int wpr = bitboard_words(data->cols);
+
+    if (data->kernel == KERNEL_BITPACK) {
+        return;
+    }
+    for (int i = 0; i < data->rows; i++) {
+        int *row = base_arr + cell_index(data, i, 0);
+
+        for (int j = 0; j < data->cols; j++) {
+            row[j] = bitboard_get(data->snap.bits, wpr, i, j);
+        }
+    }
+    snapshot_unmap(&data->snap);
+}
+
+/******************** Checkpoint Rows **********************
+ * checkpoint_rows: Packs this thread's share of the current board into
+ *       the checkpoint writer's board. Shares are whole rows split evenly
+ *       between the threads whatever the partition, since every thread
+ *       can read all of base once a round is done.
+ * data: Pointer to a thread's gol_data, after a planned round.
+ * returns: void.
+ ***************************************************************/
+
+void checkpoint_rows(struct gol_data *data) {
+    struct snap_writer *w = data->ckpt;
+    long t = data->thread_id - 1;
+    int r0 = data->rows * t / data->num_threads;
+    int r1 = data->rows * (t + 1) / data->num_threads;
+
+    if (r1 > r0) {
+        load_strip(data, w->bits + (long)r0 * bitboard_words(data->cols), r0,
+                r1 - r0);
+    }
+    snapshot_writer_packed(w);
+}
 
     //   if ParaVis animation:
 /**************************************************************/
+#ifndef GOL_HEADLESS
 /***** START: DO NOT MODIFY THIS CODE *****/
 /* initialize ParaVisi animation */
 int setup_animation(struct gol_data* data) {
@@ -755,3 +3483,4 @@ void* seq_do_something(void * args){
 //     return 0;
 // }
 /***** END: DO NOT MODIFY THIS CODE *****/
+#endif
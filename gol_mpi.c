@@ -0,0 +1,905 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Distributed Game of Life over MPI, for boards too big for one machine.
+ * The board is cut into a 2D grid of blocks, one per process (rank), on a
+ * periodic Cartesian communicator so the edges still wrap around. Each
+ * rank only ever holds its own block, bit-packed (the bitboard.h layout)
+ * inside a halo of --halo=K cells that are copies of its neighbors' edges;
+ * it parses its cells straight out of the board file and keeps no others.
+ *
+ * Every K rounds the ranks swap halos with their 8 neighbors (sides and
+ * corners) with non-blocking sends and receives. While the halos are in
+ * flight the rank's threads step the inner part of the block, the cells
+ * whose neighbors are all its own; once the halos are in they step the
+ * rest. With K > 1 the next K-1 rounds need no exchange at all: each one
+ * steps one ring of halo less, which the round before computed too.
+ *
+ * Within a rank the block is stepped by <num_threads> pthreads, each
+ * taking an even band of its rows, with the same SWAR rule kernel as the
+ * bitpack kernel of gol. The live cells after the last round are summed
+ * over the ranks with a reduction.
+ *
+ * To run (one process per block, here 4 on this machine):
+ * mpirun -np 4 ./gol_mpi file1.txt 2       # 2 threads per rank
+ * mpirun -np 6 ./gol_mpi file1.txt 1 --grid=2x3 --halo=4 -n 1000
+ * mpirun -np 4 ./gol_mpi file1.txt 1 --print   # small boards: show it
+ *
+ * Options after the positional args:
+ * -r, --rule=RULE        Life-like rule, see gol (default the file's)
+ * -n, --rounds=N         rounds to run (default the file's; RLE needs it)
+ * --halo=K               halo width, rounds between exchanges (default 1)
+ * --grid=PxQ             P rows by Q columns of ranks (default: MPI picks)
+ * -p, --print            gather the last round on rank 0 and print it
+ */
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <pthread.h>
+#include "arena.h"
+#include "bitboard.h"
+#include "loader.h"
+#include "render.h"
+#include "rule.h"
+
+/* the 3x3 directions around a block, dir = (dr+1)*3 + (dc+1), BLOCK_SELF
+ * being the block itself. The message from direction d is tagged 8-d, the
+ * direction its sender sent it in */
+#define BLOCK_DIRS (9)
+#define BLOCK_SELF (4)
+
+/* getopt ids of the long only options */
+enum {
+    OPT_HALO = 256, OPT_GRID
+};
+
+/* what to run, from the command line */
+struct mpi_opts {
+    const char *infile;
+    int num_threads;
+    int rounds; //-1 for the file's
+    int rule_given;
+    uint32_t rule;
+    int halo;
+    int grid[2]; //0 for MPI_Dims_create to pick
+    int print;
+};
+
+/* one rank's block and everything its threads share */
+struct mpi_block {
+    int rows, cols; //the whole board
+    int grid[2]; //rows and columns of ranks
+    int r0, c0; //the block's first row and column on the board
+    int lr, lc; //the block's size
+    int k; //halo width
+    int lrows; //stored rows, lr + 2k
+    int wpr; //words of a stored row of lc + 2k cells
+    int stride; //wpr and a 0 guard word at each end, so no word has edges
+    struct arena *arena; //everything below that is per block
+    uint64_t *base, *next; //lrows x stride words
+    uint64_t *masks; //k rows of wpr words, row d keeps the block and d
+                     //cells of halo around it
+    int inner_w0, inner_w1; //words whose neighbors are all the block's
+    uint32_t rule;
+    int rounds;
+    int num_threads;
+
+    MPI_Comm comm;
+    int nbr[BLOCK_DIRS]; //the rank in each direction
+    uint64_t *send[BLOCK_DIRS], *recv[BLOCK_DIRS];
+    int count[BLOCK_DIRS]; //words sent to and received from each direction
+    MPI_Request reqs[2 * BLOCK_DIRS];
+    long exchanges;
+    double wait_secs; //time thread 0 spent waiting for halos
+    double secs; //time of the run
+    long long live; //the block's, added by the threads with an atomic add
+    long long total_live; //the board's
+    long file_cells; //cells in the board file, added by the threads
+    int load_failed; //set by a thread whose part of the file is bad
+    pthread_barrier_t barrier;
+};
+
+/* one thread */
+struct mpi_thread {
+    struct mpi_block *b;
+    int t; //from 0, thread 0 is the only one that calls MPI
+    int first, last; //its band of stored rows
+    const struct board_file *file; //the board, while loading
+    const char *path; //its name, for messages
+};
+
+/****************** Function Prototypes **********************/
+
+/* end the run after an error every rank found, once rank 0 printed it */
+void mpi_quit(void);
+
+/* read the options into opts, exits on a bad one */
+void parse_mpi_options(struct mpi_opts *opts, int argc, char **argv);
+
+/* lay out this rank's block of the board and allocate it */
+void make_block(struct mpi_block *b, const struct mpi_opts *opts,
+        const struct board_file *f);
+
+/* the threads' main loop: load the block, then run every round */
+void *mpi_worker(void *arg);
+
+/* end the run if any rank found the board file bad, after loading */
+void check_load(const struct mpi_block *b, const struct board_file *f,
+        const char *path);
+
+/* pack the block's edges and start the halo exchange */
+void start_exchange(struct mpi_block *b);
+
+/* wait for the halo exchange and unpack what came in */
+void finish_exchange(struct mpi_block *b);
+
+/* gather every block on rank 0 and print the board as gol does */
+void print_board(const struct mpi_block *b, long long gen);
+
+/**************************************************************/
+
+int main(int argc, char **argv) {
+    struct mpi_opts opts;
+    struct mpi_block b;
+    struct board_file f;
+    struct mpi_thread *threads;
+    pthread_t *tids;
+    int provided, rank, nprocs;
+    long long sent = 0, sent_all;
+    double wait_max;
+    long page_kb, thp_kb;
+
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    if (provided < MPI_THREAD_FUNNELED) {
+        printf("Error: MPI has no thread support\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+
+    parse_mpi_options(&opts, argc, argv);
+    if (board_file_open(opts.infile, &f)) {
+        mpi_quit();
+    }
+    //every rank finds the same format errors, check_load prints them once
+    f.quiet = 1;
+    make_block(&b, &opts, &f);
+
+    threads = malloc(sizeof(struct mpi_thread) * b.num_threads);
+    tids = malloc(sizeof(pthread_t) * b.num_threads);
+    if (!threads || !tids) {
+        printf("malloc failed: threads\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    pthread_barrier_init(&b.barrier, NULL, b.num_threads);
+    for (int t = 0; t < b.num_threads; t++) {
+        threads[t].b = &b;
+        threads[t].t = t;
+        //every stored row but the outermost two, which are never stepped
+        threads[t].first = 1 + (long)(b.lrows - 2) * t / b.num_threads;
+        threads[t].last = (long)(b.lrows - 2) * (t + 1) / b.num_threads;
+        threads[t].file = &f;
+        threads[t].path = opts.infile;
+    }
+    //the main thread is thread 0, so MPI is only called from it
+    for (int t = 1; t < b.num_threads; t++) {
+        if (pthread_create(&tids[t], NULL, mpi_worker, &threads[t])) {
+            printf("pthread_create failed\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    mpi_worker(&threads[0]);
+    for (int t = 1; t < b.num_threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    board_file_close(&f);
+
+    for (int d = 0; d < BLOCK_DIRS; d++) {
+        sent += (long long)b.count[d] * sizeof(uint64_t) * b.exchanges;
+    }
+    MPI_Reduce(&sent, &sent_all, 1, MPI_LONG_LONG, MPI_SUM, 0, b.comm);
+    MPI_Reduce(&b.wait_secs, &wait_max, 1, MPI_DOUBLE, MPI_MAX, 0, b.comm);
+    if (opts.print) {
+        print_board(&b, b.rounds);
+    }
+    MPI_Comm_rank(b.comm, &rank);
+    if (rank == 0) {
+        fprintf(stdout, "Ranks: %d in a %dx%d grid, %d threads each, "
+                "halo %d\n", nprocs, b.grid[0], b.grid[1], b.num_threads,
+                b.k);
+        fprintf(stdout, "Halos: %ld exchanges, %lld bytes sent, "
+                "%0.3f seconds waiting (most of any rank)\n", b.exchanges,
+                sent_all, wait_max);
+        //as gol -p prints them, for rank 0's arena
+        arena_usage(b.arena, &page_kb, &thp_kb);
+        if (b.arena->pages == ARENA_PAGES_THP) {
+            fprintf(stdout, "Pages: %s, %.1f of %.1f MB arena on huge "
+                    "pages\n", arena_pages_name(b.arena->pages),
+                    thp_kb / 1024.0, b.arena->size / (1024.0 * 1024.0));
+        }
+        else {
+            fprintf(stdout, "Pages: %s (%ld KB), %.1f MB arena\n",
+                    arena_pages_name(b.arena->pages), page_kb,
+                    b.arena->size / (1024.0 * 1024.0));
+        }
+        fprintf(stdout, "Total time: %0.3f seconds\n", b.secs);
+        fprintf(stdout, "Number of live cells after %d rounds: %lld\n\n",
+                b.rounds, b.total_live);
+    }
+
+    pthread_barrier_destroy(&b.barrier);
+    arena_destroy(b.arena);
+    free(threads);
+    free(tids);
+    MPI_Comm_free(&b.comm);
+    MPI_Finalize();
+    return 0;
+}
+
+/******************** Quit **********************
+ * mpi_quit: Ends the run after a bad command line or board, which every
+ *       rank finds the same way: they all finalize and exit, where an
+ *       abort could kill rank 0 before it printed why.
+ ***************************************************************/
+
+void mpi_quit(void) {
+    MPI_Finalize();
+    exit(1);
+}
+
+/******************** Parse Options **********************
+ * parse_mpi_options: Reads the command line, see the top of the file.
+ *       Every rank reads it, and only rank 0 of MPI_COMM_WORLD prints
+ *       what is wrong with it.
+ * opts: Filled in, defaults first.
+ * argc, argv: The command line.
+ * returns: void, ends the run on a bad option.
+ ***************************************************************/
+
+void parse_mpi_options(struct mpi_opts *opts, int argc, char **argv) {
+    static struct option long_opts[] = {
+        {"rule", required_argument, NULL, 'r'},
+        {"rounds", required_argument, NULL, 'n'},
+        {"halo", required_argument, NULL, OPT_HALO},
+        {"grid", required_argument, NULL, OPT_GRID},
+        {"print", no_argument, NULL, 'p'},
+        {NULL, 0, NULL, 0}
+    };
+    const char *bad = NULL;
+    int rank, opt;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    memset(opts, 0, sizeof(*opts));
+    opts->rounds = -1;
+    opts->rule = RULE_LIFE;
+    opts->halo = 1;
+
+    if (argc < 3) {
+        if (rank == 0) {
+            printf("usage: mpirun -np N %s <infile.txt> <num_threads> "
+                    "[options]\n", argv[0]);
+        }
+        mpi_quit();
+    }
+    opts->infile = argv[1];
+    opts->num_threads = atoi(argv[2]);
+    if (opts->num_threads < 1) {
+        bad = "num_threads must be at least 1";
+    }
+
+    //the options come after the two positional args
+    optind = 3;
+    opterr = rank == 0;
+    while (!bad && (opt = getopt_long(argc, argv, "r:n:p", long_opts,
+                    NULL)) != -1) {
+        switch (opt) {
+            case 'r':
+                if (rule_parse(optarg, &opts->rule)) {
+                    bad = "Bad rule (use B3/S23, 23/3 or a name)";
+                }
+                opts->rule_given = 1;
+                break;
+            case 'n':
+                opts->rounds = atoi(optarg);
+                if (opts->rounds < 0) {
+                    bad = "Bad rounds";
+                }
+                break;
+            case OPT_HALO:
+                opts->halo = atoi(optarg);
+                if (opts->halo < 1) {
+                    bad = "Bad halo (use 1 or more)";
+                }
+                break;
+            case OPT_GRID:
+                if (sscanf(optarg, "%dx%d", &opts->grid[0],
+                            &opts->grid[1]) != 2 || opts->grid[0] < 1
+                        || opts->grid[1] < 1) {
+                    bad = "Bad grid (use PxQ)";
+                }
+                break;
+            case 'p':
+                opts->print = 1;
+                break;
+            default:
+                bad = "";
+                break;
+        }
+    }
+    if (!bad && optind < argc) {
+        bad = "Too many arguments";
+    }
+    if (bad) {
+        if (rank == 0 && bad[0]) {
+            printf("%s\n", bad);
+        }
+        mpi_quit();
+    }
+}
+
+/******************** Make Block **********************
+ * make_block: Builds the periodic grid of ranks, finds this rank's block
+ *       and its neighbors, and allocates the block, its halo masks and
+ *       the exchange buffers from one arena (on huge pages if it can).
+ * b: Filled in.
+ * opts: The options.
+ * f: The board file, for its size, rounds and rule.
+ * returns: void, ends the run if the board cannot be cut that way.
+ ***************************************************************/
+
+void make_block(struct mpi_block *b, const struct mpi_opts *opts,
+        const struct board_file *f) {
+    int nprocs, rank, coords[2], periods[2] = {1, 1};
+    int k = opts->halo;
+    size_t block_bytes, halo_bytes = 0;
+
+    memset(b, 0, sizeof(*b));
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    b->rows = f->rows;
+    b->cols = f->cols;
+    b->k = k;
+    b->num_threads = opts->num_threads;
+    b->rule = opts->rule_given ? opts->rule
+        : f->has_rule ? f->rule : RULE_LIFE;
+    b->rounds = opts->rounds >= 0 ? opts->rounds : f->iters;
+    if (b->rounds < 0) {
+        if (rank == 0) {
+            printf("RLE patterns have no rounds, use -n\n");
+        }
+        mpi_quit();
+    }
+
+    b->grid[0] = opts->grid[0];
+    b->grid[1] = opts->grid[1];
+    if (b->grid[0] * b->grid[1] != 0
+            && b->grid[0] * b->grid[1] != nprocs) {
+        if (rank == 0) {
+            printf("A %dx%d grid needs %d ranks, not %d\n", b->grid[0],
+                    b->grid[1], b->grid[0] * b->grid[1], nprocs);
+        }
+        mpi_quit();
+    }
+    MPI_Dims_create(nprocs, 2, b->grid);
+    MPI_Cart_create(MPI_COMM_WORLD, 2, b->grid, periods, 1, &b->comm);
+    MPI_Comm_rank(b->comm, &rank);
+    MPI_Cart_coords(b->comm, rank, 2, coords);
+
+    //even blocks, the rest spread one each over the first ones
+    b->r0 = (long)b->rows * coords[0] / b->grid[0];
+    b->lr = (long)b->rows * (coords[0] + 1) / b->grid[0] - b->r0;
+    b->c0 = (long)b->cols * coords[1] / b->grid[1];
+    b->lc = (long)b->cols * (coords[1] + 1) / b->grid[1] - b->c0;
+    if (b->rows / b->grid[0] < k || b->cols / b->grid[1] < k) {
+        if (rank == 0) {
+            printf("A %dx%d board in a %dx%d grid has blocks smaller "
+                    "than the halo (%d)\n", b->rows, b->cols, b->grid[0],
+                    b->grid[1], k);
+        }
+        mpi_quit();
+    }
+
+    for (int d = 0; d < BLOCK_DIRS; d++) {
+        int at[2] = {coords[0] + d / 3 - 1, coords[1] + d % 3 - 1};
+
+        MPI_Cart_rank(b->comm, at, &b->nbr[d]);
+    }
+
+    b->lrows = b->lr + 2 * k;
+    b->wpr = bitboard_words(b->lc + 2 * k);
+    b->stride = b->wpr + 2;
+    for (int d = 0; d < BLOCK_DIRS; d++) {
+        int n_rows = d / 3 == 1 ? b->lr : k;
+        int n_cols = d % 3 == 1 ? b->lc : k;
+
+        //the halo strip in direction d is the size of the edge sent there
+        b->count[d] = d == BLOCK_SELF ? 0 : n_rows * bitboard_words(n_cols);
+        halo_bytes += 2 * arena_piece(sizeof(uint64_t) * b->count[d]);
+    }
+
+    //the block, its masks and its halo buffers, all in one arena
+    block_bytes = sizeof(uint64_t) * (size_t)b->lrows * b->stride;
+    b->arena = arena_create(2 * arena_piece(block_bytes)
+            + arena_piece(sizeof(uint64_t) * (size_t)k * b->wpr)
+            + halo_bytes, ARENA_AUTO);
+    b->base = arena_alloc(b->arena, block_bytes);
+    b->next = arena_alloc(b->arena, block_bytes);
+    b->masks = arena_alloc(b->arena, sizeof(uint64_t) * (size_t)k * b->wpr);
+    for (int d = 0; d < BLOCK_DIRS; d++) {
+        b->send[d] = arena_alloc(b->arena, sizeof(uint64_t) * b->count[d]);
+        b->recv[d] = arena_alloc(b->arena, sizeof(uint64_t) * b->count[d]);
+        if (!b->send[d] || !b->recv[d]) {
+            printf("malloc failed: halo buffers\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    if (!b->base || !b->next || !b->masks) {
+        printf("malloc failed: block\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int d = 0; d < k; d++) {
+        for (int j = k - d; j < k + b->lc + d; j++) {
+            bitboard_set(b->masks + (long)d * b->wpr, b->wpr, 0, j);
+        }
+    }
+    //word w reads columns 64w-1 to 64w+64, all of them the block's
+    b->inner_w0 = (k + 1 + 63) / 64;
+    b->inner_w1 = (k + b->lc - 1 - 64) >= 0 ? (k + b->lc - 1 - 64) / 64
+        : -1;
+}
+
+/******************** Block Row **********************
+ * block_row: The words of a stored row, past its west guard word.
+ ***************************************************************/
+
+static inline uint64_t *block_row(const struct mpi_block *b, uint64_t *cells,
+        int i) {
+    return cells + (long)i * b->stride + 1;
+}
+
+/******************** Load Cell **********************
+ * load_cell: Keeps a cell of the board file if it is on this rank's
+ *       block. Threads parse parts of the file at once, and two of them
+ *       may set cells in the same word, so the bit is set with an atomic
+ *       or.
+ ***************************************************************/
+
+static void load_cell(void *ctx, long i, long j) {
+    struct mpi_block *b = ctx;
+    long li = i - b->r0, lj = j - b->c0;
+
+    if (li < 0 || li >= b->lr || lj < 0 || lj >= b->lc) {
+        return;
+    }
+    li += b->k;
+    lj += b->k;
+    __atomic_fetch_or(&block_row(b, b->base, li)[lj >> 6],
+            (uint64_t)1 << (lj & 63), __ATOMIC_RELAXED);
+}
+
+/******************** Copy Cells Out **********************
+ * pack_region: Copies a rectangle of the stored block into a buffer,
+ *       bit-packed the same way with rows of bitboard_words(n_cols).
+ * b: The block.
+ * cells: Its stored rows.
+ * i0, n_rows, j0, n_cols: The rectangle, in stored rows and columns.
+ * buf: Where to copy it.
+ * returns: void.
+ ***************************************************************/
+
+static void pack_region(const struct mpi_block *b, uint64_t *cells, int i0,
+        int n_rows, int j0, int n_cols, uint64_t *buf) {
+    for (int i = i0; i < i0 + n_rows; i++) {
+        const uint64_t *row = block_row(b, cells, i);
+
+        for (int j = 0; j < n_cols; j += 64) {
+            int at = j0 + j, sh = at & 63, n = n_cols - j < 64 ? n_cols - j
+                : 64;
+            uint64_t word = row[at >> 6] >> sh;
+
+            if (sh + n > 64) {
+                word |= row[(at >> 6) + 1] << (64 - sh);
+            }
+            *buf++ = n < 64 ? word & ((((uint64_t)1) << n) - 1) : word;
+        }
+    }
+}
+
+/******************** Copy Cells In **********************
+ * unpack_region: The reverse of pack_region, overwriting the rectangle.
+ ***************************************************************/
+
+static void unpack_region(const struct mpi_block *b, uint64_t *cells,
+        int i0, int n_rows, int j0, int n_cols, const uint64_t *buf) {
+    for (int i = i0; i < i0 + n_rows; i++) {
+        uint64_t *row = block_row(b, cells, i);
+
+        for (int j = 0; j < n_cols; j += 64) {
+            int at = j0 + j, sh = at & 63, n = n_cols - j < 64 ? n_cols - j
+                : 64;
+            uint64_t keep = n < 64 ? (((uint64_t)1) << n) - 1
+                : ~(uint64_t)0;
+            uint64_t word = *buf++;
+
+            row[at >> 6] = (row[at >> 6] & ~(keep << sh)) | (word << sh);
+            if (sh + n > 64) {
+                row[(at >> 6) + 1] = (row[(at >> 6) + 1]
+                        & ~(keep >> (64 - sh))) | (word >> (64 - sh));
+            }
+        }
+    }
+}
+
+/******************** Edge Rectangles **********************
+ * edge_region: The rectangle of the stored block that is sent in
+ *       direction d (its edge on that side) or, for a halo, received
+ *       from it (the halo on that side).
+ * b: The block.
+ * d: The direction.
+ * halo: 1 for the halo, 0 for the edge.
+ * i0, n_rows, j0, n_cols: Set to the rectangle.
+ * returns: void.
+ ***************************************************************/
+
+static void edge_region(const struct mpi_block *b, int d, int halo, int *i0,
+        int *n_rows, int *j0, int *n_cols) {
+    int k = b->k;
+    int first[3] = {halo ? 0 : k, k, halo ? k + b->lr : b->lr};
+    int left[3] = {halo ? 0 : k, k, halo ? k + b->lc : b->lc};
+
+    *i0 = first[d / 3];
+    *n_rows = d / 3 == 1 ? b->lr : k;
+    *j0 = left[d % 3];
+    *n_cols = d % 3 == 1 ? b->lc : k;
+}
+
+/******************** Start Exchange **********************
+ * start_exchange: Posts every receive first, then packs each edge and
+ *       sends it. Called by thread 0 only.
+ ***************************************************************/
+
+void start_exchange(struct mpi_block *b) {
+    int i0, n_rows, j0, n_cols, n = 0;
+
+    for (int d = 0; d < BLOCK_DIRS; d++) {
+        if (d != BLOCK_SELF) {
+            MPI_Irecv(b->recv[d], b->count[d], MPI_UINT64_T, b->nbr[d],
+                    BLOCK_DIRS - 1 - d, b->comm, &b->reqs[n++]);
+        }
+    }
+    for (int d = 0; d < BLOCK_DIRS; d++) {
+        if (d == BLOCK_SELF) {
+            continue;
+        }
+        edge_region(b, d, 0, &i0, &n_rows, &j0, &n_cols);
+        pack_region(b, b->base, i0, n_rows, j0, n_cols, b->send[d]);
+        MPI_Isend(b->send[d], b->count[d], MPI_UINT64_T, b->nbr[d], d,
+                b->comm, &b->reqs[n++]);
+    }
+    b->exchanges++;
+}
+
+/******************** Finish Exchange **********************
+ * finish_exchange: Waits for the halos and unpacks them around the block.
+ *       Called by thread 0 only, while the others wait at a barrier.
+ ***************************************************************/
+
+void finish_exchange(struct mpi_block *b) {
+    int i0, n_rows, j0, n_cols;
+    double start = MPI_Wtime();
+
+    MPI_Waitall(2 * (BLOCK_DIRS - 1), b->reqs, MPI_STATUSES_IGNORE);
+    b->wait_secs += MPI_Wtime() - start;
+    for (int d = 0; d < BLOCK_DIRS; d++) {
+        if (d == BLOCK_SELF) {
+            continue;
+        }
+        edge_region(b, d, 1, &i0, &n_rows, &j0, &n_cols);
+        unpack_region(b, b->base, i0, n_rows, j0, n_cols, b->recv[d]);
+    }
+}
+
+/******************** Step Words Under a Rule **********************
+ * step_words: Computes the next generation of words w0 to w1 of a stored
+ *       row. The guard words make the west and east neighbors of the
+ *       first and last word 0, so no word is a special case. Always
+ *       inlined, so each call with a constant rule is a kernel of its own.
+ * b: The block.
+ * base, next: The current and next generation.
+ * i: The stored row, not the first or last one.
+ * w0, w1: The words to compute (inclusive).
+ * mask: The cells of the row that are kept, the others are set to 0.
+ * rule: The rule, see rule.h.
+ * returns: void.
+ ***************************************************************/
+
+static inline __attribute__((always_inline)) void step_words(
+        const struct mpi_block *b, uint64_t *base, uint64_t *next, int i,
+        int w0, int w1, const uint64_t *mask, uint32_t rule) {
+    const uint64_t *up = block_row(b, base, i - 1);
+    const uint64_t *mid = block_row(b, base, i);
+    const uint64_t *down = block_row(b, base, i + 1);
+    uint64_t *out = block_row(b, next, i);
+
+    for (int w = w0; w <= w1; w++) {
+        uint64_t res = bitboard_rule_word(
+                (up[w] << 1) | (up[w-1] >> 63), up[w],
+                (up[w] >> 1) | (up[w+1] << 63),
+                (mid[w] << 1) | (mid[w-1] >> 63), mid[w],
+                (mid[w] >> 1) | (mid[w+1] << 63),
+                (down[w] << 1) | (down[w-1] >> 63), down[w],
+                (down[w] >> 1) | (down[w+1] << 63), rule);
+
+        out[w] = res & mask[w];
+    }
+}
+
+/******************** Step Band **********************
+ * step_band: Steps a thread's rows of one round, or part of them.
+ *       The round keeps the block and d cells of halo around it; with
+ *       inner 1 only the inner words of the inner rows are stepped (their
+ *       neighbors are all the block's, so the halo may still be on its
+ *       way), with inner 0 whatever inner 1 left. With inner -1 the whole
+ *       band is stepped.
+ * th: The thread.
+ * d: The halo cells kept.
+ * inner: See above.
+ * rule: The rule, see rule.h.
+ * returns: void.
+ ***************************************************************/
+
+static inline __attribute__((always_inline)) void step_band_rule(
+        const struct mpi_thread *th, int d, int inner, uint32_t rule) {
+    const struct mpi_block *b = th->b;
+    const uint64_t *mask = b->masks + (long)d * b->wpr;
+    int first = b->k - d > th->first ? b->k - d : th->first;
+    int last = b->k + b->lr - 1 + d < th->last ? b->k + b->lr - 1 + d
+        : th->last;
+    int w0 = b->inner_w0, w1 = b->inner_w1;
+
+    for (int i = first; i <= last; i++) {
+        //rows next to a halo row are never inner
+        int in = i > b->k && i < b->k + b->lr - 1 && w0 <= w1;
+
+        if (inner < 0 || (inner == 0 && !in)) {
+            step_words(b, b->base, b->next, i, 0, b->wpr - 1, mask, rule);
+        }
+        else if (inner == 1 && in) {
+            step_words(b, b->base, b->next, i, w0, w1, mask, rule);
+        }
+        else if (inner == 0) {
+            step_words(b, b->base, b->next, i, 0, w0 - 1, mask, rule);
+            step_words(b, b->base, b->next, i, w1 + 1, b->wpr - 1, mask,
+                    rule);
+        }
+    }
+}
+
+/* step_band_rule, the common rules specialized */
+static void step_band(const struct mpi_thread *th, int d, int inner) {
+    switch (th->b->rule) {
+        case RULE_LIFE:
+            step_band_rule(th, d, inner, RULE_LIFE);
+            break;
+        case RULE_HIGHLIFE:
+            step_band_rule(th, d, inner, RULE_HIGHLIFE);
+            break;
+        case RULE_DAY_NIGHT:
+            step_band_rule(th, d, inner, RULE_DAY_NIGHT);
+            break;
+        case RULE_SEEDS:
+            step_band_rule(th, d, inner, RULE_SEEDS);
+            break;
+        default:
+            step_band_rule(th, d, inner, th->b->rule);
+            break;
+    }
+}
+
+/******************** Skip Cell **********************
+ * skip_cell: A board_file_cells callback that keeps nothing.
+ ***************************************************************/
+
+static void skip_cell(void *ctx, long i, long j) {
+}
+
+/******************** Check Load **********************
+ * check_load: Called by thread 0 once every thread has parsed its part
+ *       of the board file. Every rank parses the whole file, so each one
+ *       has the file's full cell count and finds the same errors; they
+ *       agree on whether any failed, and if so rank 0 says why, as gol
+ *       would, and the run ends. Since the threads parsed quietly, rank 0
+ *       parses the file again in one part to print its first error.
+ * b: The block, with the threads' file_cells and load_failed.
+ * f: The board file.
+ * path: Its name.
+ * returns: void, ends the run on a bad file.
+ ***************************************************************/
+
+void check_load(const struct mpi_block *b, const struct board_file *f,
+        const char *path) {
+    int bad = b->load_failed;
+    int rank;
+
+    if (!bad && f->howmany >= 0 && b->file_cells != f->howmany) {
+        bad = 2;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &bad, 1, MPI_INT, MPI_MAX, b->comm);
+    if (!bad) {
+        return;
+    }
+    MPI_Comm_rank(b->comm, &rank);
+    if (rank == 0) {
+        if (bad == 2) {
+            printf("Improper file format: %s lists %ld cells, its header"
+                    " says %ld\n", path, b->file_cells, f->howmany);
+        }
+        else {
+            struct board_file loud = *f;
+
+            loud.quiet = 0;
+            board_file_cells(&loud, 0, 1, 0, skip_cell, NULL);
+        }
+    }
+    mpi_quit();
+}
+
+/******************** Worker **********************
+ * mpi_worker: Loads the thread's part of the board file, then runs the
+ *       rounds, K at a time: thread 0 starts the halo exchange, every
+ *       thread steps its inner words, thread 0 finishes the exchange,
+ *       every thread steps the rest of the first round and then the
+ *       other K-1 rounds whole. Barriers keep the threads together.
+ *       At the end the block's live cells are counted and thread 0 sums
+ *       them over the ranks.
+ * arg: The thread.
+ * returns: NULL.
+ ***************************************************************/
+
+void *mpi_worker(void *arg) {
+    struct mpi_thread *th = arg;
+    struct mpi_block *b = th->b;
+    long long live = 0;
+    double start = 0;
+    long cells;
+    int first, last;
+
+    cells = board_file_cells(th->file, th->t, b->num_threads, 0, load_cell,
+            b);
+    if (cells < 0) {
+        __atomic_store_n(&b->load_failed, 1, __ATOMIC_RELAXED);
+    }
+    else {
+        __atomic_fetch_add(&b->file_cells, cells, __ATOMIC_RELAXED);
+    }
+    pthread_barrier_wait(&b->barrier);
+    if (th->t == 0) {
+        check_load(b, th->file, th->path);
+        MPI_Barrier(b->comm);
+        start = MPI_Wtime();
+    }
+    pthread_barrier_wait(&b->barrier);
+
+    for (int gen = 0; gen < b->rounds; gen++) {
+        //s rounds since the last exchange, keeping k-s-1 cells of halo
+        int s = gen % b->k;
+
+        if (s == 0) {
+            if (th->t == 0) {
+                start_exchange(b);
+            }
+            step_band(th, b->k - 1, 1);
+            pthread_barrier_wait(&b->barrier);
+            if (th->t == 0) {
+                finish_exchange(b);
+            }
+            pthread_barrier_wait(&b->barrier);
+            step_band(th, b->k - 1, 0);
+        }
+        else {
+            step_band(th, b->k - s - 1, -1);
+        }
+        pthread_barrier_wait(&b->barrier);
+        if (th->t == 0) {
+            uint64_t *tmp = b->base;
+
+            b->base = b->next;
+            b->next = tmp;
+        }
+        pthread_barrier_wait(&b->barrier);
+    }
+
+    //the block's own cells of its rows
+    first = b->k > th->first ? b->k : th->first;
+    last = b->k + b->lr - 1 < th->last ? b->k + b->lr - 1 : th->last;
+    for (int i = first; i <= last; i++) {
+        const uint64_t *row = block_row(b, b->base, i);
+
+        for (int w = 0; w < b->wpr; w++) {
+            live += __builtin_popcountll(row[w] & b->masks[w]);
+        }
+    }
+    __atomic_add_fetch(&b->live, live, __ATOMIC_RELAXED);
+    pthread_barrier_wait(&b->barrier);
+    if (th->t == 0) {
+        b->secs = MPI_Wtime() - start;
+        MPI_Allreduce(&b->live, &b->total_live, 1, MPI_LONG_LONG, MPI_SUM,
+                b->comm);
+    }
+    return NULL;
+}
+
+/******************** Print Board **********************
+ * print_board: Every rank sends its block to rank 0, which puts the
+ *       board together and prints it with render_format, the way gol
+ *       prints its last round. Only for boards that fit on rank 0.
+ * b: The block.
+ * gen: The round.
+ * returns: void.
+ ***************************************************************/
+
+void print_board(const struct mpi_block *b, long long gen) {
+    int rank, nprocs, wpr = bitboard_words(b->cols);
+    int words = b->lr * bitboard_words(b->lc);
+    int max_words = (b->rows / b->grid[0] + 1)
+        * bitboard_words(b->cols / b->grid[1] + 1);
+    uint64_t *buf, *board;
+    char *text;
+
+    MPI_Comm_rank(b->comm, &rank);
+    MPI_Comm_size(b->comm, &nprocs);
+    buf = malloc(sizeof(uint64_t) * max_words);
+    if (!buf) {
+        printf("malloc failed: print buffer\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (rank != 0) {
+        int at[4] = {b->r0, b->lr, b->c0, b->lc};
+
+        pack_region(b, b->base, b->k, b->lr, b->k, b->lc, buf);
+        MPI_Send(at, 4, MPI_INT, 0, 0, b->comm);
+        MPI_Send(buf, words, MPI_UINT64_T, 0, 1, b->comm);
+        free(buf);
+        return;
+    }
+
+    board = bitboard_alloc(b->rows, b->cols);
+    text = malloc(render_text_size(b->rows, b->cols));
+    if (!board || !text) {
+        printf("malloc failed: board\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int r = 0; r < nprocs; r++) {
+        int at[4] = {b->r0, b->lr, b->c0, b->lc};
+
+        if (r == 0) {
+            pack_region(b, b->base, b->k, b->lr, b->k, b->lc, buf);
+        }
+        else {
+            MPI_Recv(at, 4, MPI_INT, r, 0, b->comm, MPI_STATUS_IGNORE);
+            MPI_Recv(buf, at[1] * bitboard_words(at[3]), MPI_UINT64_T, r,
+                    1, b->comm, MPI_STATUS_IGNORE);
+        }
+        for (int i = 0; i < at[1]; i++) {
+            const uint64_t *row = buf + (long)i * bitboard_words(at[3]);
+
+            for (int j = 0; j < at[3]; j++) {
+                if ((row[j >> 6] >> (j & 63)) & 1) {
+                    bitboard_set(board, wpr, at[0] + i, at[2] + j);
+                }
+            }
+        }
+    }
+    fwrite(text, 1, render_format(board, b->rows, b->cols, gen, text),
+            stderr);
+    free(board);
+    free(text);
+    free(buf);
+}
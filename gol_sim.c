@@ -0,0 +1,394 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Game of Life simulation library, see gol_sim.h. The workers are made by
+ * gol_sim_create and sleep on a condition variable between calls. Each
+ * gol_sim_step call posts one job (a generation count); every worker steps
+ * its band of rows that many times, meeting the others at the context's
+ * barrier after each generation, and the last one to finish wakes the
+ * caller. Live counts go in one cache line per worker, so the only shared
+ * writes in a generation are the barrier's.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "bitboard.h"
+#include "loader.h"
+#include "rule.h"
+#include "gol_sim.h"
+
+/* one worker's live cell count, on a cache line of its own */
+struct sim_count {
+    long count;
+} __attribute__((aligned(64)));
+
+/* one pool thread */
+struct sim_worker {
+    struct gol_sim *sim;
+    int id;
+    pthread_t tid;
+};
+
+/* the cells of a board file, while gol_sim_load_file reads it */
+struct sim_cells {
+    int *cells; //(i, j) pairs, as gol_sim_load takes them
+    long num;
+};
+
+struct gol_sim {
+    int num_threads;
+    struct sim_worker *workers;
+    struct sim_count *counts; //one per worker
+    pthread_barrier_t barrier; //between generations of a job
+
+    //job hand-off, all guarded by lock
+    pthread_mutex_t lock;
+    pthread_cond_t start; //workers wait here for a job
+    pthread_cond_t done; //the caller waits here for the job to finish
+    long job; //bumped for every job posted
+    int job_gens; //generations in the current job
+    uint32_t rule; //see rule.h, changed only between jobs
+    int finished; //workers done with the current job
+    int quit;
+
+    //the board, only touched by the caller while no job is running
+    int rows, cols;
+    uint64_t *base;
+    uint64_t *next;
+    long live;
+    long generation;
+};
+
+/******************** Band of Rows **********************
+ * band: Finds the rows a worker steps, splitting the rows as evenly as
+ *       possible. Workers past the last row get an empty band.
+ * sim: The context.
+ * id: The worker.
+ * r0, r1: Set to the first and last row (r0 > r1 if none).
+ * returns: void.
+ ***************************************************************/
+
+static void band(const struct gol_sim *sim, int id, int *r0, int *r1) {
+    int n = sim->num_threads;
+    int share = sim->rows / n;
+    int extra = sim->rows % n;
+
+    *r0 = id * share + (id < extra ? id : extra);
+    *r1 = *r0 + share + (id < extra) - 1;
+}
+
+/******************** Worker Thread **********************
+ * worker_main: Waits for jobs and runs its band of each one, until the
+ *       context is destroyed.
+ * arg: The sim_worker of this thread.
+ * returns: NULL.
+ ***************************************************************/
+
+static void *worker_main(void *arg) {
+    struct sim_worker *me = arg;
+    struct gol_sim *sim = me->sim;
+    long seen = 0;
+
+    while (1) {
+        int gens, r0, r1;
+        uint64_t *cur, *nxt;
+        uint32_t rule;
+
+        pthread_mutex_lock(&sim->lock);
+        while (sim->job == seen && !sim->quit) {
+            pthread_cond_wait(&sim->start, &sim->lock);
+        }
+        if (sim->quit) {
+            pthread_mutex_unlock(&sim->lock);
+            return NULL;
+        }
+        seen = sim->job;
+        gens = sim->job_gens;
+        rule = sim->rule;
+        cur = sim->base;
+        nxt = sim->next;
+        band(sim, me->id, &r0, &r1);
+        pthread_mutex_unlock(&sim->lock);
+
+        for (int g = 0; g < gens; g++) {
+            sim->counts[me->id].count =
+                bitboard_step_rows(cur, nxt, sim->rows, sim->cols, r0, r1,
+                        rule);
+
+            //every band must be done before anyone reads nxt as the base
+            pthread_barrier_wait(&sim->barrier);
+            uint64_t *tmp = cur;
+            cur = nxt;
+            nxt = tmp;
+        }
+
+        pthread_mutex_lock(&sim->lock);
+        if (++sim->finished == sim->num_threads) {
+            pthread_cond_signal(&sim->done);
+        }
+        pthread_mutex_unlock(&sim->lock);
+    }
+}
+
+/******************** Create Context **********************
+ * gol_sim_create: See gol_sim.h.
+ ***************************************************************/
+
+struct gol_sim *gol_sim_create(int num_threads) {
+    struct gol_sim *sim;
+
+    if (num_threads < 1) {
+        return NULL;
+    }
+    sim = calloc(1, sizeof(struct gol_sim));
+    if (!sim) {
+        return NULL;
+    }
+    sim->num_threads = num_threads;
+    sim->rule = RULE_LIFE;
+    sim->workers = calloc(num_threads, sizeof(struct sim_worker));
+    sim->counts = aligned_alloc(64, sizeof(struct sim_count) * num_threads);
+    if (!sim->workers || !sim->counts) {
+        free(sim->workers);
+        free(sim->counts);
+        free(sim);
+        return NULL;
+    }
+    memset(sim->counts, 0, sizeof(struct sim_count) * num_threads);
+
+    pthread_mutex_init(&sim->lock, NULL);
+    pthread_cond_init(&sim->start, NULL);
+    pthread_cond_init(&sim->done, NULL);
+    pthread_barrier_init(&sim->barrier, NULL, num_threads);
+
+    for (int t = 0; t < num_threads; t++) {
+        sim->workers[t].sim = sim;
+        sim->workers[t].id = t;
+        if (pthread_create(&sim->workers[t].tid, NULL, worker_main,
+                    &sim->workers[t])) {
+            //stop the ones already running
+            sim->num_threads = t;
+            gol_sim_destroy(sim);
+            return NULL;
+        }
+    }
+    return sim;
+}
+
+/******************** Load Board **********************
+ * gol_sim_load: See gol_sim.h. The old board is kept if anything is wrong
+ *       with the new one.
+ ***************************************************************/
+
+int gol_sim_load(struct gol_sim *sim, int rows, int cols, const int *cells,
+        long num_cells) {
+    uint64_t *base, *next;
+    int wpr = bitboard_words(cols);
+    long live = 0;
+
+    if (rows < 1 || cols < 1) {
+        return -1;
+    }
+    base = bitboard_alloc(rows, cols);
+    next = bitboard_alloc(rows, cols);
+    if (!base || !next) {
+        free(base);
+        free(next);
+        return -1;
+    }
+
+    for (long k = 0; k < num_cells; k++) {
+        int i = cells[2*k];
+        int j = cells[2*k+1];
+
+        if (i < 0 || i >= rows || j < 0 || j >= cols) {
+            free(base);
+            free(next);
+            return -1;
+        }
+        //a cell listed twice is only alive once
+        if (!bitboard_get(base, wpr, i, j)) {
+            bitboard_set(base, wpr, i, j);
+            live++;
+        }
+    }
+
+    free(sim->base);
+    free(sim->next);
+    sim->base = base;
+    sim->next = next;
+    sim->rows = rows;
+    sim->cols = cols;
+    sim->live = live;
+    sim->generation = 0;
+    return 0;
+}
+
+/******************** Collect Cell **********************
+ * collect_cell: A board_file_cells callback adding a cell to a
+ *       sim_cells list (which has room for all of them).
+ ***************************************************************/
+
+static void collect_cell(void *ctx, long i, long j) {
+    struct sim_cells *c = ctx;
+
+    c->cells[2*c->num] = i;
+    c->cells[2*c->num+1] = j;
+    c->num++;
+}
+
+/******************** Count Cell **********************
+ * count_cell: A board_file_cells callback that only lets it count.
+ ***************************************************************/
+
+static void count_cell(void *ctx, long i, long j) {
+}
+
+/******************** Load Board File **********************
+ * gol_sim_load_file: See gol_sim.h. The file is read with the loader gol
+ *       uses (loader.h), in one part: once to count the cells and once
+ *       to keep them, since an RLE header does not say how many there are.
+ ***************************************************************/
+
+int gol_sim_load_file(struct gol_sim *sim, const char *path, int *iters) {
+    struct board_file f;
+    struct sim_cells c;
+    long howmany;
+    int ret;
+
+    if (board_file_open(path, &f)) {
+        return -1;
+    }
+    howmany = board_file_cells(&f, 0, 1, 0, count_cell, NULL);
+    if (howmany < 0 || (f.howmany >= 0 && howmany != f.howmany)) {
+        board_file_close(&f);
+        return -1;
+    }
+    c.num = 0;
+    c.cells = malloc(sizeof(int) * 2 * ((size_t)howmany + 1));
+    if (!c.cells) {
+        board_file_close(&f);
+        return -1;
+    }
+    board_file_cells(&f, 0, 1, 0, collect_cell, &c);
+    board_file_close(&f);
+
+    ret = gol_sim_load(sim, f.rows, f.cols, c.cells, c.num);
+    free(c.cells);
+    if (ret == 0 && f.has_rule) {
+        sim->rule = f.rule;
+    }
+    if (ret == 0 && iters) {
+        *iters = f.iters;
+    }
+    return ret;
+}
+
+/******************** Set Rule **********************
+ * gol_sim_set_rule: See gol_sim.h.
+ ***************************************************************/
+
+int gol_sim_set_rule(struct gol_sim *sim, const char *text) {
+    uint32_t rule;
+
+    if (rule_parse(text, &rule)) {
+        return -1;
+    }
+    sim->rule = rule;
+    return 0;
+}
+
+/******************** Step Board **********************
+ * gol_sim_step: See gol_sim.h. Posts the job, waits for every worker to
+ *       finish it, then sums their counts from the last generation.
+ ***************************************************************/
+
+long gol_sim_step(struct gol_sim *sim, int gens) {
+    if (!sim->base) {
+        return -1;
+    }
+    if (gens <= 0) {
+        return sim->live;
+    }
+
+    pthread_mutex_lock(&sim->lock);
+    sim->job_gens = gens;
+    sim->finished = 0;
+    sim->job++;
+    pthread_cond_broadcast(&sim->start);
+    while (sim->finished < sim->num_threads) {
+        pthread_cond_wait(&sim->done, &sim->lock);
+    }
+    pthread_mutex_unlock(&sim->lock);
+
+    //the workers swapped their own copies of the pointers once per round
+    if (gens % 2) {
+        uint64_t *tmp = sim->base;
+        sim->base = sim->next;
+        sim->next = tmp;
+    }
+    sim->live = 0;
+    for (int t = 0; t < sim->num_threads; t++) {
+        sim->live += sim->counts[t].count;
+    }
+    sim->generation += gens;
+    return sim->live;
+}
+
+/******************** Query Board **********************/
+
+long gol_sim_live(const struct gol_sim *sim) {
+    return sim->live;
+}
+
+long gol_sim_generation(const struct gol_sim *sim) {
+    return sim->generation;
+}
+
+int gol_sim_get_cell(const struct gol_sim *sim, int i, int j) {
+    if (!sim->base || i < 0 || i >= sim->rows || j < 0 || j >= sim->cols) {
+        return 0;
+    }
+    return bitboard_get(sim->base, bitboard_words(sim->cols), i, j);
+}
+
+int gol_sim_rows(const struct gol_sim *sim) {
+    return sim->rows;
+}
+
+int gol_sim_cols(const struct gol_sim *sim) {
+    return sim->cols;
+}
+
+/******************** Destroy Context **********************
+ * gol_sim_destroy: See gol_sim.h. Wakes the workers with quit set and
+ *       joins them before freeing anything they could touch.
+ ***************************************************************/
+
+void gol_sim_destroy(struct gol_sim *sim) {
+    if (!sim) {
+        return;
+    }
+    pthread_mutex_lock(&sim->lock);
+    sim->quit = 1;
+    pthread_cond_broadcast(&sim->start);
+    pthread_mutex_unlock(&sim->lock);
+    for (int t = 0; t < sim->num_threads; t++) {
+        pthread_join(sim->workers[t].tid, NULL);
+    }
+
+    pthread_barrier_destroy(&sim->barrier);
+    pthread_cond_destroy(&sim->done);
+    pthread_cond_destroy(&sim->start);
+    pthread_mutex_destroy(&sim->lock);
+    free(sim->base);
+    free(sim->next);
+    free(sim->counts);
+    free(sim->workers);
+    free(sim);
+}
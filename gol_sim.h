@@ -0,0 +1,70 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Game of Life simulation library. A context owns a toroidal board and a
+ * pool of worker threads that lives as long as the context, so many short
+ * simulations can run one after another (or side by side, one context
+ * each) without creating threads per run. There is no global state: every
+ * lock, barrier and counter lives in the context.
+ *
+ * Boards are bit-packed and stepped with the bitboard kernel, each worker
+ * owning a band of rows. A context must only be used from one thread at a
+ * time. Functions return -1 (or NULL) on errors instead of exiting.
+ *
+ *     struct gol_sim *sim = gol_sim_create(8);
+ *     gol_sim_load_file(sim, "world.txt", &iters);
+ *     gol_sim_step(sim, iters);
+ *     printf("%ld\n", gol_sim_live(sim));
+ *     gol_sim_destroy(sim);
+ */
+#ifndef GOL_SIM_H
+#define GOL_SIM_H
+
+struct gol_sim;
+
+/* make a context with a pool of num_threads workers (started right away).
+ * returns NULL if num_threads < 1 or the threads cannot be made */
+struct gol_sim *gol_sim_create(int num_threads);
+
+/* replace the board with a rows x cols torus where the num_cells cells at
+ * (cells[2k], cells[2k+1]) are alive, and reset the generation to 0.
+ * returns 0, or -1 on a bad size, a cell off the board or no memory */
+int gol_sim_load(struct gol_sim *sim, int rows, int cols, const int *cells,
+        long num_cells);
+
+/* same, from a board file in the gol text format or RLE, read as gol
+ * reads it (see loader.h, whose message is printed for a bad file). The
+ * file's round count (-1 for RLE, which has none) is stored in *iters
+ * unless iters is NULL, and its rule (if it names one) replaces the
+ * context's. returns 0 or -1 */
+int gol_sim_load_file(struct gol_sim *sim, const char *path, int *iters);
+
+/* run the next steps under a Life-like rule, like "B36/S23" (see rule.h).
+ * A new context runs B3/S23. returns 0, or -1 if text is not a rule */
+int gol_sim_set_rule(struct gol_sim *sim, const char *text);
+
+/* advance the board gens generations using the worker pool.
+ * returns the number of live cells after, or -1 if no board is loaded */
+long gol_sim_step(struct gol_sim *sim, int gens);
+
+/* number of live cells now */
+long gol_sim_live(const struct gol_sim *sim);
+
+/* generations advanced since the board was loaded */
+long gol_sim_generation(const struct gol_sim *sim);
+
+/* returns 1 if cell (i, j) is alive, 0 if dead or off the board */
+int gol_sim_get_cell(const struct gol_sim *sim, int i, int j);
+
+/* board size, 0 if no board is loaded */
+int gol_sim_rows(const struct gol_sim *sim);
+int gol_sim_cols(const struct gol_sim *sim);
+
+/* stop the workers and free everything */
+void gol_sim_destroy(struct gol_sim *sim);
+
+#endif
@@ -0,0 +1,857 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * HashLife engine.
+ *
+ * Nodes are squares of 2^level cells. Leaves (level 3) hold 8x8 cells in
+ * one uint64_t, bigger nodes point at their four quadrants. Every node is
+ * hash-consed, so equal squares are the same node anywhere in the tree and
+ * in time, and each node remembers its center square advanced 2^step_exp
+ * generations (or 2^(level-2), whichever is less). Computing that for a
+ * big node reuses the memoized results of its sub-squares, which is what
+ * makes regular patterns cheap.
+ *
+ * The torus is handled as the periodic tiling of the plane it is the
+ * same as. A macro step builds a 2^K square window of the tiling, offset
+ * so the window's result square starts at board cell (0, 0), and takes
+ * that result (2^(K-2) generations ahead) as the new board. When rows and
+ * cols are powers of two the board itself is a node and the window is made
+ * of four copies of it rolled by half, so a macro step is a few hash
+ * lookups. Otherwise the window is rebuilt from a byte board every step.
+ *
+ * Since nodes are canonical, a repeated board is a repeated pointer, so
+ * Brent's algorithm finds cycles between macro steps for free and the
+ * rest of the run is skipped modulo the period.
+ *
+ * The node cache never grows past its cap. When it is full in the middle
+ * of a macro step, the step is abandoned (a longjmp out of the recursion,
+ * before anything half made is in the hash table), garbage is collected
+ * with the board as the root, and the step is tried again; if it fills up
+ * again right after a collection, steps of half the size are taken from
+ * then on, which need fewer nodes. Node blocks left empty by a collection
+ * are unmapped, so the process shrinks too.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+#include "bitboard.h"
+#include "hashlife.h"
+
+#define HL_LEAF_LEVEL   (3)    // 8x8 cells, one uint64_t
+#define HL_MAX_LEVEL    (40)
+#define HL_BLOCK_NODES  (4096) // nodes mapped at a time
+#define HL_MIN_BUCKETS  (1 << 12)
+
+struct hl_node {
+    struct hl_node *nw, *ne, *sw, *se; //quadrants, all NULL for a leaf
+    struct hl_node *result; //memoized center advanced by the step size
+    struct hl_node *chain; //next node in the hash bucket (or free list)
+    uint64_t bits; //leaf cells, bit r*8+c is row r column c
+    uint64_t pop; //live cells in the square
+    int level; //the square is 2^level cells on a side
+    unsigned int mark; //gc epoch the node was last reached in
+};
+
+struct hl_block {
+    struct hl_block *next;
+    struct hl_node nodes[HL_BLOCK_NODES];
+};
+
+struct hl_universe {
+    struct hl_node **buckets; //hash table of every live node
+    size_t num_buckets;
+    size_t num_nodes; //nodes in the hash table
+    size_t num_blocks; //node blocks mapped
+    int block_used; //nodes used in the newest block
+    struct hl_block *blocks;
+    struct hl_node *free_list; //nodes freed by gc, reused first
+    jmp_buf full; //where new_node goes when the cache is at its cap
+    struct hl_node *empty[HL_MAX_LEVEL+1]; //the empty square of each level
+    int step_exp; //results are at most 2^step_exp generations ahead
+    size_t max_bytes; //node cache cap
+    unsigned int epoch; //gc epoch
+    uint32_t rule; //see rule.h, never born with 0 neighbors
+    struct hashlife_stats *stats;
+};
+
+/******************** Hashes **********************
+ * hash_node, hash_leaf: Hash a node by its quadrants' addresses (they
+ *       are canonical) or a leaf by its cells.
+ ***************************************************************/
+
+static inline size_t hash_node(struct hl_node *nw, struct hl_node *ne,
+        struct hl_node *sw, struct hl_node *se) {
+    uint64_t h = (uintptr_t)nw;
+
+    h = h * 0x9e3779b97f4a7c15ULL + (uintptr_t)ne;
+    h = h * 0x9e3779b97f4a7c15ULL + (uintptr_t)sw;
+    h = h * 0x9e3779b97f4a7c15ULL + (uintptr_t)se;
+    return h ^ (h >> 29);
+}
+
+static inline size_t hash_leaf(uint64_t bits) {
+    uint64_t h = (bits + 1) * 0x9e3779b97f4a7c15ULL;
+
+    return h ^ (h >> 32);
+}
+
+/******************** Node Cache Bytes **********************
+ * cache_bytes: Memory held by the node cache (blocks plus buckets).
+ * note_peak: Records the most it has held.
+ ***************************************************************/
+
+static size_t cache_bytes(struct hl_universe *u) {
+    return u->num_blocks * sizeof(struct hl_block)
+        + u->num_buckets * sizeof(struct hl_node *);
+}
+
+static void note_peak(struct hl_universe *u, size_t bytes) {
+    if (u->stats && bytes > u->stats->peak_bytes) {
+        u->stats->peak_bytes = bytes;
+    }
+}
+
+/******************** New Node **********************
+ * new_node: Gets a zeroed node from the free list or the newest block,
+ *       mapping a new block if there is room under the cap. If there is
+ *       not, jumps to u->full instead of returning.
+ * u: The universe.
+ * returns: The node, not yet in the hash table.
+ ***************************************************************/
+
+static struct hl_node *new_node(struct hl_universe *u) {
+    struct hl_node *n;
+
+    if (u->free_list) {
+        n = u->free_list;
+        u->free_list = n->chain;
+    }
+    else {
+        if (!u->blocks || u->block_used == HL_BLOCK_NODES) {
+            struct hl_block *b;
+
+            if (cache_bytes(u) + sizeof(struct hl_block) > u->max_bytes) {
+                longjmp(u->full, 1);
+            }
+            b = mmap(NULL, sizeof(struct hl_block), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (b == MAP_FAILED) {
+                printf("mmap failed: hashlife node block\n");
+                exit(1);
+            }
+            b->next = u->blocks;
+            u->blocks = b;
+            u->block_used = 0;
+            u->num_blocks++;
+            note_peak(u, cache_bytes(u));
+        }
+        n = &u->blocks->nodes[u->block_used++];
+    }
+    memset(n, 0, sizeof(*n));
+    return n;
+}
+
+/******************** Grow Hash Table **********************
+ * grow_table: Doubles the bucket array once nodes outnumber buckets, if
+ *       the old and new arrays fit under the cap together (else the
+ *       chains just get longer).
+ * u: The universe.
+ * returns: void.
+ ***************************************************************/
+
+static void grow_table(struct hl_universe *u) {
+    size_t nb = u->num_buckets * 2;
+    size_t bytes = cache_bytes(u) + nb * sizeof(struct hl_node *);
+    struct hl_node **buckets;
+
+    if (bytes > u->max_bytes) {
+        return;
+    }
+    note_peak(u, bytes);
+    buckets = calloc(nb, sizeof(struct hl_node *));
+    if (!buckets) {
+        printf("malloc failed: hashlife buckets\n");
+        exit(1);
+    }
+    for (size_t b = 0; b < u->num_buckets; b++) {
+        struct hl_node *n = u->buckets[b];
+
+        while (n) {
+            struct hl_node *next = n->chain;
+            size_t h = (n->level == HL_LEAF_LEVEL) ? hash_leaf(n->bits)
+                : hash_node(n->nw, n->ne, n->sw, n->se);
+
+            n->chain = buckets[h & (nb - 1)];
+            buckets[h & (nb - 1)] = n;
+            n = next;
+        }
+    }
+    free(u->buckets);
+    u->buckets = buckets;
+    u->num_buckets = nb;
+}
+
+/******************** Find Leaf / Find Node **********************
+ * find_leaf, find_node: Return the canonical node for a square, making
+ *       it if this is the first time we have seen it.
+ ***************************************************************/
+
+static struct hl_node *find_leaf(struct hl_universe *u, uint64_t bits) {
+    size_t b = hash_leaf(bits) & (u->num_buckets - 1);
+    struct hl_node *n;
+
+    for (n = u->buckets[b]; n; n = n->chain) {
+        if (n->level == HL_LEAF_LEVEL && n->bits == bits) {
+            return n;
+        }
+    }
+    n = new_node(u);
+    n->level = HL_LEAF_LEVEL;
+    n->bits = bits;
+    n->pop = __builtin_popcountll(bits);
+    n->chain = u->buckets[b];
+    u->buckets[b] = n;
+    if (++u->num_nodes > u->num_buckets) {
+        grow_table(u);
+    }
+    return n;
+}
+
+static struct hl_node *find_node(struct hl_universe *u, struct hl_node *nw,
+        struct hl_node *ne, struct hl_node *sw, struct hl_node *se) {
+    size_t b = hash_node(nw, ne, sw, se) & (u->num_buckets - 1);
+    struct hl_node *n;
+
+    for (n = u->buckets[b]; n; n = n->chain) {
+        if (n->nw == nw && n->ne == ne && n->sw == sw && n->se == se) {
+            return n;
+        }
+    }
+    n = new_node(u);
+    n->level = nw->level + 1;
+    n->nw = nw;
+    n->ne = ne;
+    n->sw = sw;
+    n->se = se;
+    n->pop = nw->pop + ne->pop + sw->pop + se->pop;
+    n->chain = u->buckets[b];
+    u->buckets[b] = n;
+    if (++u->num_nodes > u->num_buckets) {
+        grow_table(u);
+    }
+    return n;
+}
+
+/******************** Empty Square **********************
+ * empty_node: The canonical all-dead square of a level.
+ ***************************************************************/
+
+static struct hl_node *empty_node(struct hl_universe *u, int level) {
+    if (!u->empty[level]) {
+        if (level == HL_LEAF_LEVEL) {
+            u->empty[level] = find_leaf(u, 0);
+        }
+        else {
+            struct hl_node *e = empty_node(u, level - 1);
+
+            u->empty[level] = find_node(u, e, e, e, e);
+        }
+    }
+    return u->empty[level];
+}
+
+/******************** 16x16 Helpers **********************
+ * expand16: Lays a level 4 node (four leaves) out as 16 rows of 16 bits.
+ * center16: Takes the 8x8 center of 16 rows as a leaf's cells.
+ * step16: Advances 16 rows one generation, cells outside count as dead
+ *       (only the center is used, and it is far enough from the edge).
+ ***************************************************************/
+
+static void expand16(struct hl_node *n, uint32_t rows[16]) {
+    for (int r = 0; r < 8; r++) {
+        rows[r] = ((n->nw->bits >> (8*r)) & 0xff)
+            | (((n->ne->bits >> (8*r)) & 0xff) << 8);
+        rows[r+8] = ((n->sw->bits >> (8*r)) & 0xff)
+            | (((n->se->bits >> (8*r)) & 0xff) << 8);
+    }
+}
+
+static uint64_t center16(const uint32_t rows[16]) {
+    uint64_t bits = 0;
+
+    for (int r = 0; r < 8; r++) {
+        bits |= (uint64_t)((rows[r+4] >> 4) & 0xff) << (8*r);
+    }
+    return bits;
+}
+
+static void step16(uint32_t rows[16], uint32_t rule) {
+    uint32_t out[16];
+
+    for (int r = 0; r < 16; r++) {
+        uint64_t up = (r > 0) ? rows[r-1] : 0;
+        uint64_t mid = rows[r];
+        uint64_t down = (r < 15) ? rows[r+1] : 0;
+
+        out[r] = bitboard_rule_word(up << 1, up, up >> 1, mid << 1, mid,
+                mid >> 1, down << 1, down, down >> 1, rule) & 0xffff;
+    }
+    memcpy(rows, out, sizeof(out));
+}
+
+/******************** Center **********************
+ * center_node: The square of half the size in the middle of a node,
+ *       not advanced in time.
+ ***************************************************************/
+
+static struct hl_node *center_node(struct hl_universe *u, struct hl_node *n) {
+    if (n->level == HL_LEAF_LEVEL + 1) {
+        uint32_t rows[16];
+
+        expand16(n, rows);
+        return find_leaf(u, center16(rows));
+    }
+    return find_node(u, n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+}
+
+/******************** Step Node **********************
+ * step_node: The center of a node (level >= 4) advanced by
+ *       2^min(step_exp, level-2) generations, memoized in the node.
+ *       The node is split into 9 overlapping sub-squares of half its
+ *       size, each advanced recursively; at full speed the four squares
+ *       made from those are advanced again, otherwise their centers are
+ *       taken as they are.
+ * u: The universe.
+ * n: The node.
+ * returns: The result node, one level below n.
+ ***************************************************************/
+
+static struct hl_node *step_node(struct hl_universe *u, struct hl_node *n) {
+    struct hl_node *res;
+
+    if (n->result) {
+        return n->result;
+    }
+
+    if (n->pop == 0) {
+        //nothing is born in empty space under B3/S23
+        res = empty_node(u, n->level - 1);
+    }
+    else if (n->level == HL_LEAF_LEVEL + 1) {
+        int gens = 1 << (u->step_exp < 2 ? u->step_exp : 2);
+        uint32_t rows[16];
+
+        expand16(n, rows);
+        for (int g = 0; g < gens; g++) {
+            step16(rows, u->rule);
+        }
+        res = find_leaf(u, center16(rows));
+    }
+    else {
+        struct hl_node *r00, *r01, *r02, *r10, *r11, *r12, *r20, *r21, *r22;
+
+        r00 = step_node(u, n->nw);
+        r01 = step_node(u, find_node(u, n->nw->ne, n->ne->nw, n->nw->se, n->ne->sw));
+        r02 = step_node(u, n->ne);
+        r10 = step_node(u, find_node(u, n->nw->sw, n->nw->se, n->sw->nw, n->sw->ne));
+        r11 = step_node(u, center_node(u, n));
+        r12 = step_node(u, find_node(u, n->ne->sw, n->ne->se, n->se->nw, n->se->ne));
+        r20 = step_node(u, n->sw);
+        r21 = step_node(u, find_node(u, n->sw->ne, n->se->nw, n->sw->se, n->se->sw));
+        r22 = step_node(u, n->se);
+
+        if (u->step_exp >= n->level - 2) {
+            //full speed: advance the four combined squares again
+            res = find_node(u,
+                    step_node(u, find_node(u, r00, r01, r10, r11)),
+                    step_node(u, find_node(u, r01, r02, r11, r12)),
+                    step_node(u, find_node(u, r10, r11, r20, r21)),
+                    step_node(u, find_node(u, r11, r12, r21, r22)));
+        }
+        else {
+            //smaller steps: the sub-squares already went far enough
+            res = find_node(u,
+                    center_node(u, find_node(u, r00, r01, r10, r11)),
+                    center_node(u, find_node(u, r01, r02, r11, r12)),
+                    center_node(u, find_node(u, r10, r11, r20, r21)),
+                    center_node(u, find_node(u, r11, r12, r21, r22)));
+        }
+    }
+
+    n->result = res;
+    return res;
+}
+
+/******************** Clear Results **********************
+ * clear_results: Forgets every memoized result, needed when the step
+ *       size changes.
+ ***************************************************************/
+
+static void clear_results(struct hl_universe *u) {
+    for (size_t b = 0; b < u->num_buckets; b++) {
+        for (struct hl_node *n = u->buckets[b]; n; n = n->chain) {
+            n->result = NULL;
+        }
+    }
+}
+
+/******************** Set Step Size **********************
+ * set_step: Makes step_node advance 2^exp generations per macro step.
+ ***************************************************************/
+
+static void set_step(struct hl_universe *u, int exp) {
+    if (u->step_exp != exp) {
+        clear_results(u);
+        u->step_exp = exp;
+    }
+}
+
+/******************** Garbage Collection **********************
+ * mark_node: Marks a node and everything below it as reachable.
+ * collect: Frees every node not reachable from the empty squares or the
+ *       given roots, and drops memoized results that pointed at freed
+ *       nodes. Results do not keep nodes alive: they can be recomputed.
+ *       Then unmaps the blocks with no live node left and makes the free
+ *       list out of the rest. Only called between macro steps (or after
+ *       one was abandoned), when no node is in use on the C stack.
+ ***************************************************************/
+
+static void mark_node(struct hl_node *n, unsigned int epoch) {
+    while (n && n->mark != epoch) {
+        n->mark = epoch;
+        if (n->level == HL_LEAF_LEVEL) {
+            return;
+        }
+        mark_node(n->nw, epoch);
+        mark_node(n->ne, epoch);
+        mark_node(n->sw, epoch);
+        n = n->se;
+    }
+}
+
+static void collect(struct hl_universe *u, struct hl_node **roots,
+        int num_roots) {
+    unsigned int epoch = ++u->epoch;
+
+    for (int l = 0; l <= HL_MAX_LEVEL; l++) {
+        mark_node(u->empty[l], epoch);
+    }
+    for (int r = 0; r < num_roots; r++) {
+        mark_node(roots[r], epoch);
+    }
+
+    for (size_t b = 0; b < u->num_buckets; b++) {
+        struct hl_node **link = &u->buckets[b];
+
+        while (*link) {
+            struct hl_node *n = *link;
+
+            if (n->mark != epoch) {
+                *link = n->chain;
+                u->num_nodes--;
+            }
+            else {
+                if (n->result && n->result->mark != epoch) {
+                    n->result = NULL;
+                }
+                link = &n->chain;
+            }
+        }
+    }
+
+    //every node is now live (marked) or free: empty blocks go, the free
+    //nodes of the others make the new free list
+    u->free_list = NULL;
+    for (struct hl_block **link = &u->blocks; *link; ) {
+        struct hl_block *b = *link;
+        int used = (b == u->blocks) ? u->block_used : HL_BLOCK_NODES;
+        int live = 0;
+
+        for (int i = 0; i < used; i++) {
+            live += b->nodes[i].mark == epoch;
+        }
+        if (live == 0) {
+            if (b == u->blocks) {
+                //the blocks left are all carved out
+                u->block_used = HL_BLOCK_NODES;
+            }
+            *link = b->next;
+            munmap(b, sizeof(struct hl_block));
+            u->num_blocks--;
+            continue;
+        }
+        for (int i = 0; i < used; i++) {
+            if (b->nodes[i].mark != epoch) {
+                b->nodes[i].chain = u->free_list;
+                u->free_list = &b->nodes[i];
+            }
+        }
+        link = &b->next;
+    }
+    if (u->stats) {
+        u->stats->gc_runs++;
+    }
+}
+
+/******************** Build From Cells **********************
+ * build: Makes the node for a 2^level square of a byte board, where
+ *       square row y is board row ymap[y] and column x is xmap[x] (this
+ *       is how the window wraps around the torus).
+ * u: The universe.
+ * level: Level of the node to build.
+ * y0, x0: The square's corner in window coordinates.
+ * cells, cols: The byte board.
+ * ymap, xmap: Window coordinate to board coordinate.
+ * returns: The node.
+ ***************************************************************/
+
+static struct hl_node *build(struct hl_universe *u, int level, long y0,
+        long x0, const unsigned char *cells, int cols, const int *ymap,
+        const int *xmap) {
+    long half;
+
+    if (level == HL_LEAF_LEVEL) {
+        uint64_t bits = 0;
+
+        for (int r = 0; r < 8; r++) {
+            const unsigned char *row = cells + (long)ymap[y0+r] * cols;
+
+            for (int c = 0; c < 8; c++) {
+                if (row[xmap[x0+c]]) {
+                    bits |= (uint64_t)1 << (8*r + c);
+                }
+            }
+        }
+        return find_leaf(u, bits);
+    }
+
+    half = 1L << (level - 1);
+    return find_node(u,
+            build(u, level-1, y0, x0, cells, cols, ymap, xmap),
+            build(u, level-1, y0, x0+half, cells, cols, ymap, xmap),
+            build(u, level-1, y0+half, x0, cells, cols, ymap, xmap),
+            build(u, level-1, y0+half, x0+half, cells, cols, ymap, xmap));
+}
+
+/******************** Extract To Cells **********************
+ * extract: Writes the part of a node that falls on a rows x cols byte
+ *       board (the board must be cleared first, empty squares are
+ *       skipped).
+ * n: The node.
+ * y0, x0: Where its corner lands on the board.
+ * cells, rows, cols: The byte board.
+ * returns: void.
+ ***************************************************************/
+
+static void extract(struct hl_node *n, long y0, long x0, unsigned char *cells,
+        int rows, int cols) {
+    long half;
+
+    if (n->pop == 0 || y0 >= rows || x0 >= cols) {
+        return;
+    }
+    if (n->level == HL_LEAF_LEVEL) {
+        for (int r = 0; r < 8 && y0 + r < rows; r++) {
+            for (int c = 0; c < 8 && x0 + c < cols; c++) {
+                cells[(y0+r)*cols + x0+c] = (n->bits >> (8*r + c)) & 1;
+            }
+        }
+        return;
+    }
+    half = 1L << (n->level - 1);
+    extract(n->nw, y0, x0, cells, rows, cols);
+    extract(n->ne, y0, x0+half, cells, rows, cols);
+    extract(n->sw, y0+half, x0, cells, rows, cols);
+    extract(n->se, y0+half, x0+half, cells, rows, cols);
+}
+
+/******************** Roll By Half **********************
+ * roll_half: The torus node shifted by half its size in both directions
+ *       (quadrants swapped diagonally, or a leaf's rows and nibbles).
+ ***************************************************************/
+
+static struct hl_node *roll_half(struct hl_universe *u, struct hl_node *n) {
+    if (n->level == HL_LEAF_LEVEL) {
+        uint64_t b = (n->bits >> 32) | (n->bits << 32);
+
+        b = ((b >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((b << 4) & 0xf0f0f0f0f0f0f0f0ULL);
+        return find_leaf(u, b);
+    }
+    return find_node(u, n->se, n->sw, n->ne, n->nw);
+}
+
+/* the state of a run, passed to macro_step */
+struct hl_run {
+    int pow2; //1 if the board itself is a node (rows, cols powers of 2)
+    int window_level; //K: the window is 2^K cells on a side
+    struct hl_node *state; //the board now (pow2) or the last result
+    unsigned char *cells; //byte board (not pow2)
+    int rows, cols;
+    int *ymap, *xmap; //window to board coordinates (not pow2)
+};
+
+/******************** Macro Step **********************
+ * macro_step: Advances the board by 2^step_exp generations.
+ * u: The universe.
+ * run: The run, state (and cells) are updated.
+ * returns: void.
+ ***************************************************************/
+
+static void macro_step(struct hl_universe *u, struct hl_run *run) {
+    if (run->pow2) {
+        //four copies of the board rolled by half: the result is the board
+        struct hl_node *q = roll_half(u, run->state);
+
+        run->state = step_node(u, find_node(u, q, q, q, q));
+    }
+    else {
+        struct hl_node *window = build(u, run->window_level, 0, 0,
+                run->cells, run->cols, run->ymap, run->xmap);
+
+        run->state = step_node(u, window);
+        memset(run->cells, 0, (size_t)run->rows * run->cols);
+        extract(run->state, 0, 0, run->cells, run->rows, run->cols);
+    }
+    if (u->stats) {
+        u->stats->macro_steps++;
+    }
+}
+
+/******************** Guarded Build / Step **********************
+ * try_build: Builds the board node (powers of two only).
+ * try_step: Runs one macro step.
+ *       Both return 0, or -1 if the node cache filled up on the way, in
+ *       which case nothing was changed but the cache. Kept apart from
+ *       run_steps so none of its locals live across the setjmp.
+ ***************************************************************/
+
+static int try_build(struct hl_universe *u, struct hl_run *run) {
+    if (setjmp(u->full)) {
+        return -1;
+    }
+    run->state = build(u, run->window_level - 1, 0, 0, run->cells,
+            run->cols, run->ymap, run->xmap);
+    return 0;
+}
+
+static int try_step(struct hl_universe *u, struct hl_run *run) {
+    if (setjmp(u->full)) {
+        return -1;
+    }
+    macro_step(u, run);
+    return 0;
+}
+
+/******************** Free Universe **********************
+ * free_universe: Unmaps every node block and frees the hash table.
+ ***************************************************************/
+
+static void free_universe(struct hl_universe *u) {
+    while (u->blocks) {
+        struct hl_block *b = u->blocks;
+
+        u->blocks = b->next;
+        munmap(b, sizeof(struct hl_block));
+    }
+    free(u->buckets);
+}
+
+/******************** Is Power Of Two **********************/
+static int is_pow2(int n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+/******************** Run Steps **********************
+ * run_steps: Advances the board gens generations, biggest steps that fit
+ *       first (at most 2^max_exp), with Brent's cycle detection while the
+ *       step size stays the same. A step that fills the cache is retried
+ *       after a collection, and steps of half the size are taken from then
+ *       on if it fills it again.
+ * u: The universe.
+ * run: The run, state (and cells) are updated.
+ * gens: Generations to go.
+ * max_exp: The biggest step, 2^max_exp generations.
+ * returns: 0, or -1 if the cache is too small even for single steps.
+ ***************************************************************/
+
+static int run_steps(struct hl_universe *u, struct hl_run *run,
+        long long gens, int max_exp) {
+    struct hl_node *tortoise, *roots[2];
+    long long left, power, lam;
+    int retried;
+
+    left = gens;
+    tortoise = NULL;
+    power = 1;
+    lam = 0;
+    retried = 0;
+    while (left > 0) {
+        int e = max_exp;
+
+        while ((1LL << e) > left) {
+            e--;
+        }
+        if (e != u->step_exp) {
+            set_step(u, e);
+            tortoise = NULL;
+            power = 1;
+            lam = 0;
+        }
+        if (try_step(u, run) != 0) {
+            //the cache is full: collect, and if that did not make room
+            //for this step, take smaller ones
+            roots[0] = run->state;
+            roots[1] = tortoise;
+            collect(u, roots, 2);
+            if (retried) {
+                if (e == 0) {
+                    return -1;
+                }
+                max_exp = e - 1;
+                if (u->stats) {
+                    u->stats->step_gens = 1LL << max_exp;
+                }
+            }
+            retried = 1;
+            continue;
+        }
+        retried = 0;
+        left -= 1LL << e;
+        lam++;
+        if (tortoise != NULL && run->state == tortoise) {
+            //the board repeats every lam steps, skip whole cycles
+            long long period = lam << e;
+            long long skip = (left / period) * period;
+
+            if (u->stats && u->stats->period == 0) {
+                u->stats->period = period;
+                u->stats->cycle_start = gens - left;
+                u->stats->skipped_gens = skip;
+            }
+            left -= skip;
+            tortoise = NULL;
+            power = gens + 1; //detect no more, just finish the remainder
+            lam = 0;
+        }
+        else if (tortoise == NULL && power <= gens) {
+            tortoise = run->state;
+            lam = 0;
+        }
+        else if (lam == power) {
+            tortoise = run->state;
+            power *= 2;
+            lam = 0;
+        }
+    }
+
+    return 0;
+}
+
+/******************** Run HashLife **********************
+ * hashlife_run: See hashlife.h. Builds the board (or the maps the window
+ *       is built with) and runs the steps.
+ ***************************************************************/
+
+long long hashlife_run(unsigned char *cells, int rows, int cols,
+        long long gens, uint32_t rule, size_t max_bytes,
+        struct hashlife_stats *stats) {
+    struct hl_universe u;
+    struct hl_run run;
+    long long live;
+    int max_exp;
+    long side;
+
+    memset(&u, 0, sizeof(u));
+    u.num_buckets = HL_MIN_BUCKETS;
+    u.buckets = calloc(u.num_buckets, sizeof(struct hl_node *));
+    if (!u.buckets) {
+        printf("malloc failed: hashlife buckets\n");
+        exit(1);
+    }
+    u.max_bytes = max_bytes;
+    u.step_exp = -1;
+    u.rule = rule;
+    u.stats = stats;
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+        stats->peak_bytes = cache_bytes(&u);
+    }
+
+    memset(&run, 0, sizeof(run));
+    run.cells = cells;
+    run.rows = rows;
+    run.cols = cols;
+    run.pow2 = is_pow2(rows) && is_pow2(cols);
+
+    //smallest window whose result square covers the whole board
+    run.window_level = HL_LEAF_LEVEL + 1;
+    while ((1L << (run.window_level - 1)) < rows
+            || (1L << (run.window_level - 1)) < cols) {
+        run.window_level++;
+    }
+    side = 1L << run.window_level;
+
+    if (run.pow2) {
+        //the board tiled up to a square (rows and cols divide it)
+        int n = 1 << (run.window_level - 1);
+
+        run.ymap = malloc(sizeof(int) * n);
+        run.xmap = malloc(sizeof(int) * n);
+        if (!run.ymap || !run.xmap) {
+            printf("malloc failed: hashlife maps\n");
+            exit(1);
+        }
+        for (int y = 0; y < n; y++) {
+            run.ymap[y] = y % rows;
+            run.xmap[y] = y % cols;
+        }
+    }
+    else {
+        //the window starts a quarter of its size before board cell (0, 0)
+        long off = side / 4;
+
+        run.ymap = malloc(sizeof(int) * side);
+        run.xmap = malloc(sizeof(int) * side);
+        if (!run.ymap || !run.xmap) {
+            printf("malloc failed: hashlife maps\n");
+            exit(1);
+        }
+        for (long y = 0; y < side; y++) {
+            run.ymap[y] = (int)(((y - off) % rows + rows) % rows);
+            run.xmap[y] = (int)(((y - off) % cols + cols) % cols);
+        }
+    }
+
+    max_exp = run.window_level - 2;
+    if (stats) {
+        stats->step_gens = 1LL << max_exp;
+    }
+    live = -1;
+    if ((!run.pow2 || try_build(&u, &run) == 0)
+            && run_steps(&u, &run, gens, max_exp) == 0) {
+        if (run.pow2) {
+            memset(cells, 0, (size_t)rows * cols);
+            extract(run.state, 0, 0, cells, rows, cols);
+        }
+        live = 0;
+        for (long i = 0; i < (long)rows * cols; i++) {
+            live += cells[i];
+        }
+    }
+
+    if (stats) {
+        stats->nodes = u.num_nodes;
+    }
+    free_universe(&u);
+    free(run.ymap);
+    free(run.xmap);
+
+    return live;
+}
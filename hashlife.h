@@ -0,0 +1,43 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * HashLife engine: the board is a quadtree of hash-consed (canonical)
+ * nodes, and the center of every node advanced 2^k generations is
+ * memoized, so regular patterns run astronomically many generations in
+ * little time. The toroidal board is simulated as the periodic tiling of
+ * the plane that it is equivalent to.
+ */
+#ifndef HASHLIFE_H
+#define HASHLIFE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* what a run did, filled in by hashlife_run */
+struct hashlife_stats {
+    long long macro_steps; //quadtree steps actually computed
+    long long step_gens; //generations per full macro step
+    long long period; //generations in the detected cycle, 0 if none
+    long long cycle_start; //generation the cycle was found at
+    long long skipped_gens; //generations jumped over thanks to the cycle
+    long nodes; //live nodes at the end
+    size_t peak_bytes; //most node cache memory in use at once
+    int gc_runs; //garbage collections of the node cache
+};
+
+/* advance a toroidal rows x cols board by gens generations under rule,
+ * in place. The rule must not give birth with 0 neighbors, since empty
+ * space has to stay empty. cells holds one byte per cell (row-major, 0
+ * dead, 1 alive), max_bytes caps the node cache (it never holds more:
+ * when full it is collected, then steps are made smaller), stats may be
+ * NULL. returns the number of live cells, or -1 if max_bytes is too small
+ * even for one generation at a time */
+long long hashlife_run(unsigned char *cells, int rows, int cols,
+        long long gens, uint32_t rule, size_t max_bytes,
+        struct hashlife_stats *stats);
+
+#endif
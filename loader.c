@@ -0,0 +1,373 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Board file loader, see loader.h. A text file is cut into parts at line
+ * boundaries by byte offset, so parts are found without reading the file
+ * and each thread only ever reads its own part.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "rule.h"
+#include "loader.h"
+
+/******************** Scan Integer **********************
+ * scan_long: Skips whitespace and reads one (possibly negative) decimal
+ *       integer, as fscanf("%d") would but without the locale and FILE
+ *       overhead.
+ * p: The read position, moved past the number.
+ * end: Where the text ends.
+ * out: Set to the number.
+ * returns: 1 if a number was read, 0 if only whitespace was left, -1 if
+ *       something else was found or the number does not fit in an int.
+ ***************************************************************/
+
+static int scan_long(const char **p, const char *end, long *out) {
+    const char *s = *p;
+    long v = 0;
+    int neg = 0;
+
+    while (s < end && (*s == ' ' || *s == '\n' || *s == '\t' || *s == '\r')) {
+        s++;
+    }
+    if (s == end) {
+        *p = s;
+        return 0;
+    }
+    if (*s == '-') {
+        neg = 1;
+        s++;
+    }
+    if (s == end || *s < '0' || *s > '9') {
+        *p = s;
+        return -1;
+    }
+    while (s < end && *s >= '0' && *s <= '9') {
+        v = v * 10 + (*s - '0');
+        if (v > INT_MAX) {
+            *p = s;
+            return -1;
+        }
+        s++;
+    }
+    *p = s;
+    *out = neg ? -v : v;
+    return 1;
+}
+
+/******************** Line Start **********************
+ * line_start: Finds the first line that starts at or after a byte offset.
+ * f: The file.
+ * pos: The offset, never before the cells.
+ * returns: The offset of the line.
+ ***************************************************************/
+
+static size_t line_start(const struct board_file *f, size_t pos) {
+    if (pos <= f->body) {
+        return f->body;
+    }
+    while (pos < f->len && f->addr[pos-1] != '\n') {
+        pos++;
+    }
+    return pos;
+}
+
+/******************** Scan Rule **********************
+ * scan_rule: Reads the "= <rule>" after the word rule, up to the end of
+ *       the line, ignoring spaces.
+ * p: The read position, just past "rule"; moved to eol.
+ * eol: Where the line ends.
+ * f: Its rule and has_rule are set.
+ * returns: 0, or -1 (with a message printed) if the rule is bad.
+ ***************************************************************/
+
+static int scan_rule(const char **p, const char *eol, struct board_file *f) {
+    const char *s = *p;
+    char text[32];
+    int n = 0;
+
+    while (s < eol && (*s == ' ' || *s == '=')) {
+        s++;
+    }
+    for (; s < eol && n < (int)sizeof(text) - 1; s++) {
+        if (*s != ' ' && *s != '\r') {
+            text[n++] = *s;
+        }
+    }
+    text[n] = '\0';
+    *p = eol;
+    if (rule_parse(text, &f->rule)) {
+        printf("Rule %s is not a Life-like rule (like B3/S23)\n", text);
+        return -1;
+    }
+    f->has_rule = 1;
+    return 0;
+}
+
+/******************** Parse RLE Header **********************
+ * parse_rle_header: Reads the "x = cols, y = rows, rule = ..." line of an
+ *       RLE file. The rule may be any Life-like rule, see rule.h.
+ * f: The file, with body at the start of the line; body is moved past it.
+ * returns: 0, or -1 if the line is bad.
+ ***************************************************************/
+
+static int parse_rle_header(struct board_file *f) {
+    const char *p = f->addr + f->body;
+    const char *end = f->addr + f->len;
+    const char *eol = memchr(p, '\n', end - p);
+    long x, y;
+
+    if (!eol) {
+        eol = end;
+    }
+    //x = <cols>, y = <rows>
+    while (p < eol && (*p == ' ' || *p == 'x' || *p == '=')) {
+        p++;
+    }
+    if (scan_long(&p, eol, &x) != 1) {
+        return -1;
+    }
+    while (p < eol && (*p == ' ' || *p == ',' || *p == 'y' || *p == '=')) {
+        p++;
+    }
+    if (scan_long(&p, eol, &y) != 1 || x < 1 || y < 1) {
+        return -1;
+    }
+
+    //the rule is optional, without spaces and case
+    while (p < eol && (*p == ' ' || *p == ',')) {
+        p++;
+    }
+    if (p < eol && eol - p > 4 && strncmp(p, "rule", 4) == 0) {
+        p += 4;
+        if (scan_rule(&p, eol, f)) {
+            return -1;
+        }
+    }
+
+    f->cols = x;
+    f->rows = y;
+    f->body = (eol < end) ? eol - f->addr + 1 : f->len;
+    return 0;
+}
+
+/******************** Open Board File **********************
+ * board_file_open: See loader.h. An RLE file is told apart from a text
+ *       file by its first line that is not a # comment starting with x.
+ ***************************************************************/
+
+int board_file_open(const char *path, struct board_file *f) {
+    struct stat st;
+    const char *p, *end;
+    long v[4];
+    int fd;
+
+    memset(f, 0, sizeof(*f));
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        printf("Error: failed to open file: %s\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    f->len = st.st_size;
+    if (f->len > 0) {
+        f->addr = mmap(NULL, f->len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (f->addr == MAP_FAILED) {
+            printf("Error: failed to map file: %s\n", path);
+            f->addr = NULL;
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+
+    //skip # comment lines (RLE files start with them)
+    p = f->addr;
+    end = f->addr + f->len;
+    while (p < end && (*p == '#' || *p == ' ' || *p == '\n' || *p == '\r')) {
+        if (*p == '#') {
+            const char *eol = memchr(p, '\n', end - p);
+
+            p = eol ? eol : end;
+        }
+        else {
+            p++;
+        }
+    }
+    f->body = p - f->addr;
+
+    if (p < end && *p == 'x') {
+        f->rle = 1;
+        f->iters = -1;
+        f->howmany = -1;
+        if (parse_rle_header(f)) {
+            printf("Improper RLE header in %s\n", path);
+            board_file_close(f);
+            return -1;
+        }
+        return 0;
+    }
+
+    //rows, cols, rounds, number of live cells
+    for (int k = 0; k < 4; k++) {
+        if (scan_long(&p, end, &v[k]) != 1) {
+            printf("Improper file format\n");
+            board_file_close(f);
+            return -1;
+        }
+    }
+    if (v[0] < 1 || v[1] < 1 || v[2] < 0 || v[3] < 0) {
+        printf("Improper file format\n");
+        board_file_close(f);
+        return -1;
+    }
+    f->rows = v[0];
+    f->cols = v[1];
+    f->iters = v[2];
+    f->howmany = v[3];
+
+    //an optional "rule = <rule>" line before the cells
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    if (end - p > 4 && strncmp(p, "rule", 4) == 0) {
+        const char *eol = memchr(p, '\n', end - p);
+
+        p += 4;
+        if (scan_rule(&p, eol ? eol : end, f)) {
+            board_file_close(f);
+            return -1;
+        }
+    }
+    f->body = p - f->addr;
+    return 0;
+}
+
+/******************** Close Board File **********************/
+void board_file_close(struct board_file *f) {
+    if (f->addr) {
+        munmap((void *)f->addr, f->len);
+        f->addr = NULL;
+    }
+}
+
+/******************** Parse RLE Cells **********************
+ * rle_cells: Walks the tags of an RLE pattern: an optional run count,
+ *       then b (dead), o or any other letter (alive), $ (end of row) or !
+ *       (end of pattern).
+ * f, unbounded, fn, ctx: As for board_file_cells.
+ * returns: The number of live cells, or -1 on a bad tag or a cell off the
+ *       board.
+ ***************************************************************/
+
+static long rle_cells(const struct board_file *f, int unbounded,
+        board_cell_fn fn, void *ctx) {
+    const char *p = f->addr + f->body;
+    const char *end = f->addr + f->len;
+    long run = 0, i = 0, j = 0, count = 0;
+
+    for (; p < end && *p != '!'; p++) {
+        char c = *p;
+        long n = run ? run : 1;
+
+        if (c >= '0' && c <= '9') {
+            run = run * 10 + (c - '0');
+            if (run > INT_MAX) {
+                break;
+            }
+            continue;
+        }
+        if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            continue;
+        }
+        run = 0;
+        if (c == 'b' || c == '.') {
+            j += n;
+        }
+        else if (c == '$') {
+            i += n;
+            j = 0;
+        }
+        else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+            if (!unbounded && (i >= f->rows || j + n > f->cols)) {
+                if (!f->quiet) {
+                    printf("RLE pattern runs off its %d x %d box\n",
+                            f->rows, f->cols);
+                }
+                return -1;
+            }
+            for (long k = 0; k < n; k++) {
+                fn(ctx, i, j + k);
+            }
+            j += n;
+            count += n;
+        }
+        else {
+            if (!f->quiet) {
+                printf("Improper RLE tag '%c' at byte %ld\n", c,
+                        (long)(p - f->addr));
+            }
+            return -1;
+        }
+    }
+    if (p == end || *p != '!') {
+        if (!f->quiet) {
+            printf("Improper RLE pattern: no closing !\n");
+        }
+        return -1;
+    }
+    return count;
+}
+
+/******************** Parse Cells **********************
+ * board_file_cells: See loader.h.
+ ***************************************************************/
+
+long board_file_cells(const struct board_file *f, int part, int parts,
+        int unbounded, board_cell_fn fn, void *ctx) {
+    size_t span = f->len - f->body;
+    const char *p, *end;
+    long count = 0;
+
+    if (f->rle) {
+        return (part == 0) ? rle_cells(f, unbounded, fn, ctx) : 0;
+    }
+
+    p = f->addr + line_start(f, f->body + span * part / parts);
+    end = f->addr + line_start(f, f->body + span * (part + 1) / parts);
+    while (1) {
+        long i, j;
+        int got = scan_long(&p, end, &i);
+
+        if (got == 0) {
+            break;
+        }
+        if (got < 0 || scan_long(&p, end, &j) != 1) {
+            if (!f->quiet) {
+                printf("Improper file format near byte %ld\n",
+                        (long)(p - f->addr));
+            }
+            return -1;
+        }
+        if (!unbounded && (i < 0 || i >= f->rows || j < 0 || j >= f->cols)) {
+            if (!f->quiet) {
+                printf("Cell %ld %ld is off the %d x %d board\n", i, j,
+                        f->rows, f->cols);
+            }
+            return -1;
+        }
+        fn(ctx, i, j);
+        count++;
+    }
+    return count;
+}
@@ -0,0 +1,55 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Board file loader. The file is mapped, not read, and its cells are
+ * parsed with a hand-written integer scanner. Text files (the gol format:
+ * rows, cols, rounds, count, an optional "rule = B3/S23" line, then one
+ * "i j" line per live cell) can be parsed in any number of parts at once,
+ * each a run of whole lines. RLE
+ * files (the usual Life pattern format) are parsed in one part, since a
+ * cell's position depends on every tag before it.
+ */
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* a board file mapped into memory, with its header parsed */
+struct board_file {
+    const char *addr; //the file, NULL if empty
+    size_t len;
+    int rle; //1 for an RLE pattern, 0 for the gol text format
+    int rows;
+    int cols;
+    int iters; //rounds from the file, -1 for RLE (which has none)
+    long howmany; //live cells the header promises, -1 for RLE
+    int has_rule; //1 if the file names a rule
+    uint32_t rule; //that rule, see rule.h
+    size_t body; //offset of the first cell
+    int quiet; //1 if board_file_cells should not print format errors
+};
+
+/* called for every live cell found, from whichever thread parses it */
+typedef void (*board_cell_fn)(void *ctx, long i, long j);
+
+/* map the file at path and parse its header. returns 0, or -1 with a
+ * message printed if it cannot be read or the header is bad */
+int board_file_open(const char *path, struct board_file *f);
+
+/* unmap the file */
+void board_file_close(struct board_file *f);
+
+/* parse part `part` of `parts` of the cells, calling fn(ctx, i, j) for each
+ * one. Cells must be on the rows x cols board unless unbounded is set.
+ * returns the number of cells in the part, or -1 (with a message printed,
+ * unless f->quiet is set) on a format error. Parts of an RLE file other
+ * than 0 are empty */
+long board_file_cells(const struct board_file *f, int part, int parts,
+        int unbounded, board_cell_fn fn, void *ctx);
+
+#endif
@@ -0,0 +1,271 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * The frame ring and renderer thread, see render.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "bitboard.h"
+#include "render.h"
+
+/******************** Monotonic Seconds **********************/
+static double render_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/******************** Write Frame **********************
+ * write_all: Writes a whole frame. A terminal or pipe may take less than
+ *       asked, so this goes on from where the last write stopped.
+ * fd: Where to write.
+ * text, len: The frame.
+ * returns: 0, or -1 if the write failed.
+ ***************************************************************/
+
+static int write_all(int fd, const char *text, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, text, len);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        text += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/******************** Text Size **********************
+ * render_text_size: See render.h. Two characters per cell and a newline
+ *       per row, plus the round and live lines.
+ ***************************************************************/
+
+size_t render_text_size(int rows, int cols) {
+    return (size_t)rows * (2 * (size_t)cols + 1) + 96;
+}
+
+/******************** Format Frame **********************
+ * render_format: See render.h.
+ ***************************************************************/
+
+size_t render_format(const uint64_t *bits, int rows, int cols,
+        long long gen, char *text) {
+    int wpr = bitboard_words(cols);
+    long long live = 0;
+    char *p = text;
+
+    p += sprintf(p, "Round: %lld\n", gen);
+    for (int i = 0; i < rows; i++) {
+        const uint64_t *row = bits + (long)i * wpr;
+
+        for (int j = 0; j < cols; j++) {
+            int alive = (row[j >> 6] >> (j & 63)) & 1;
+
+            *p++ = ' ';
+            *p++ = alive ? '@' : '.';
+            live += alive;
+        }
+        *p++ = '\n';
+    }
+    p += sprintf(p, "Live cells: %lld\n\n", live);
+    return p - text;
+}
+
+/******************** Renderer Thread **********************
+ * render_main: Formats and writes the newest packed frame each time one
+ *       is handed over, until render_stop.
+ * arg: The render.
+ * returns: NULL.
+ ***************************************************************/
+
+static void *render_main(void *arg) {
+    struct render *r = arg;
+
+    pthread_mutex_lock(&r->lock);
+    while (1) {
+        while (r->ready < 0 && !r->quit) {
+            pthread_cond_wait(&r->posted_cond, &r->lock);
+        }
+        if (r->ready < 0) {
+            break;
+        }
+        r->drawing = r->ready;
+        r->ready = -1;
+        pthread_mutex_unlock(&r->lock);
+
+        size_t len = render_format(r->slots[r->drawing], r->rows, r->cols,
+                r->slot_gen[r->drawing], r->text);
+        int failed = write_all(r->fd, r->text, len);
+
+        pthread_mutex_lock(&r->lock);
+        r->drawing = -1;
+        if (failed) {
+            //keep running, the simulation does not need its frames
+            __atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED);
+        }
+        else {
+            r->frames++;
+        }
+    }
+    pthread_mutex_unlock(&r->lock);
+    return NULL;
+}
+
+/******************** Start Renderer **********************
+ * render_start: See render.h.
+ ***************************************************************/
+
+struct render *render_start(int rows, int cols, int num_threads, int fps,
+        int fd) {
+    struct render *r = calloc(1, sizeof(struct render));
+
+    if (!r) {
+        printf("malloc failed: renderer\n");
+        exit(1);
+    }
+    r->rows = rows;
+    r->cols = cols;
+    r->num_threads = num_threads;
+    r->fd = fd;
+    r->frame_secs = fps > 0 ? 1.0 / fps : 0;
+    r->next_frame = 0; //the first round is always drawn
+    r->ready = -1;
+    r->drawing = -1;
+    if (fd < 0) {
+        return r;
+    }
+    for (int s = 0; s < RENDER_SLOTS; s++) {
+        r->slots[s] = bitboard_alloc(rows, cols);
+        if (!r->slots[s]) {
+            printf("malloc failed: frame ring\n");
+            exit(1);
+        }
+    }
+    r->text = malloc(render_text_size(rows, cols));
+    if (!r->text) {
+        printf("malloc failed: frame text\n");
+        exit(1);
+    }
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->posted_cond, NULL);
+    if (pthread_create(&r->tid, NULL, render_main, r)) {
+        perror("Error: pthread_create");
+        exit(1);
+    }
+    return r;
+}
+
+/******************** Plan Frame **********************
+ * render_plan: See render.h. A frame is due once frame_secs have passed
+ *       since the last one taken; it takes any slot that is neither the
+ *       newest packed one nor the one being drawn, and is dropped if the
+ *       last frame is still being packed.
+ ***************************************************************/
+
+void render_plan(struct render *r, long long gen, int want) {
+    double now;
+
+    r->take = 0;
+    if (!want) {
+        return;
+    }
+    now = r->frame_secs > 0 ? render_now() : 0;
+    if (now < r->next_frame) {
+        return;
+    }
+    r->next_frame = now + r->frame_secs;
+    if (r->fd < 0) {
+        r->gen = gen;
+        r->take = 1;
+        r->frames++;
+        return;
+    }
+    if (__atomic_load_n(&r->filling, __ATOMIC_ACQUIRE)) {
+        __atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    for (int s = 0; s < RENDER_SLOTS; s++) {
+        if (s != r->ready && s != r->drawing) {
+            r->slot = s;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&r->lock);
+    r->filling = 1;
+    r->packed = 0;
+    r->gen = gen;
+    r->take = 1;
+}
+
+/******************** Rows to Pack **********************
+ * render_rows: See render.h. Even bands of rows, whatever the workers'
+ *       own partitioning.
+ ***************************************************************/
+
+void render_rows(const struct render *r, int t, int *first, int *n) {
+    int r0 = (long)r->rows * t / r->num_threads;
+    int r1 = (long)r->rows * (t + 1) / r->num_threads;
+
+    *first = r0;
+    *n = r1 - r0;
+}
+
+/******************** Frame Packed **********************
+ * render_packed: See render.h. The last worker publishes the slot; if
+ *       the renderer never took the one before, that frame is dropped.
+ ***************************************************************/
+
+void render_packed(struct render *r) {
+    if (__atomic_add_fetch(&r->packed, 1, __ATOMIC_ACQ_REL)
+            != r->num_threads) {
+        return;
+    }
+    pthread_mutex_lock(&r->lock);
+    if (r->ready >= 0) {
+        __atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED);
+    }
+    r->slot_gen[r->slot] = r->gen;
+    r->ready = r->slot;
+    pthread_cond_signal(&r->posted_cond);
+    pthread_mutex_unlock(&r->lock);
+    __atomic_store_n(&r->filling, 0, __ATOMIC_RELEASE);
+}
+
+/******************** Stop Renderer **********************
+ * render_stop: See render.h.
+ ***************************************************************/
+
+void render_stop(struct render *r, long *frames, long *dropped) {
+    if (r->fd >= 0) {
+        pthread_mutex_lock(&r->lock);
+        r->quit = 1;
+        pthread_cond_signal(&r->posted_cond);
+        pthread_mutex_unlock(&r->lock);
+        pthread_join(r->tid, NULL);
+        pthread_cond_destroy(&r->posted_cond);
+        pthread_mutex_destroy(&r->lock);
+    }
+    *frames = r->frames;
+    *dropped = r->dropped;
+
+    for (int s = 0; s < RENDER_SLOTS; s++) {
+        free(r->slots[s]);
+    }
+    free(r->text);
+    free(r);
+}
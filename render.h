@@ -0,0 +1,88 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Asynchronous rendering of the board while it runs. A frame clock picks
+ * the rounds that are drawn, so the frame rate does not depend on how fast
+ * rounds go. On a picked round each worker packs its rows into a free slot
+ * of a ring of bit-packed boards, and the last one hands the slot to a
+ * renderer thread, which formats the whole frame into one buffer and
+ * writes it with a single write. With three slots (one being packed, the
+ * newest packed one and the one being drawn) the workers never wait for
+ * the renderer: a frame that finds no free slot is dropped, and so is a
+ * packed frame the renderer had not got to before a newer one came.
+ */
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* boards in the ring: packing, newest packed, drawing */
+#define RENDER_SLOTS (3)
+
+struct render {
+    int rows, cols;
+    int num_threads;
+    int fd; //where frames are written, -1 to only pick rounds
+    double frame_secs; //time between frames, 0 for as often as it can
+    double next_frame; //monotonic time the next frame is due
+    uint64_t *slots[RENDER_SLOTS]; //bit-packed boards
+    long long slot_gen[RENDER_SLOTS]; //the round in each slot
+
+    //set by the planning thread, read by the workers after a barrier
+    int take; //1 if the workers draw (pack) this round
+    int slot; //the slot they pack into
+    long long gen; //the round being packed
+
+    int filling; //1 from planning until packed (atomic)
+    int packed; //workers done packing (atomic)
+    long frames; //frames written
+    long dropped; //frames skipped or replaced before drawn (atomic)
+
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t posted_cond;
+    int ready; //newest packed slot waiting for the renderer, -1 if none
+    int drawing; //slot the renderer is formatting, -1 if none
+    int quit;
+    char *text; //one formatted frame
+};
+
+/* start rendering a rows x cols board packed by num_threads workers at
+ * up to fps frames a second (0: every round that finds a free slot).
+ * Frames go to fd; with fd -1 there is no ring or renderer thread and only
+ * the frame clock is kept (for ParaVisi, which draws its own). exits on
+ * failure */
+struct render *render_start(int rows, int cols, int num_threads, int fps,
+        int fd);
+
+/* called by one thread once round gen is computed and before the barrier
+ * that ends it: sets take if the workers should draw this round. want is
+ * 0 for a round that is never drawn */
+void render_plan(struct render *r, long long gen, int want);
+
+/* the board rows worker t (from 0) packs */
+void render_rows(const struct render *r, int t, int *first, int *n);
+
+/* called by each worker after packing its rows of a planned round */
+void render_packed(struct render *r);
+
+/* format a bit-packed board the way print_board does (round, one " @" or
+ * " ." per cell, live count) into text, which must have room for
+ * render_text_size(rows, cols) bytes. returns the length */
+size_t render_format(const uint64_t *bits, int rows, int cols,
+        long long gen, char *text);
+
+/* bytes a formatted rows x cols frame may take */
+size_t render_text_size(int rows, int cols);
+
+/* draw the last packed frame, stop the thread and free the renderer,
+ * after storing how many frames were written and dropped */
+void render_stop(struct render *r, long *frames, long *dropped);
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Rule parsing and printing, see rule.h.
+ */
+#include <string.h>
+#include <strings.h>
+#include "rule.h"
+
+/* the rules known by name */
+static const struct {
+    const char *name;
+    uint32_t rule;
+} named_rules[] = {
+    {"life", RULE_LIFE},
+    {"highlife", RULE_HIGHLIFE},
+    {"daynight", RULE_DAY_NIGHT},
+    {"seeds", RULE_SEEDS},
+};
+
+#define NUM_NAMED_RULES ((int)(sizeof(named_rules) / sizeof(named_rules[0])))
+
+/******************** Parse Counts **********************
+ * parse_counts: Reads a run of neighbor counts (digits 0-8).
+ * p: The text, moved past the digits.
+ * shift: 0 to set birth bits, 9 for survival bits.
+ * rule: The bits are or'ed into it.
+ * returns: 0, or -1 on a 9.
+ ***************************************************************/
+
+static int parse_counts(const char **p, int shift, uint32_t *rule) {
+    while (**p >= '0' && **p <= '9') {
+        if (**p == '9') {
+            return -1;
+        }
+        *rule |= 1u << (shift + (**p - '0'));
+        (*p)++;
+    }
+    return 0;
+}
+
+/******************** Parse Rule **********************
+ * rule_parse: See rule.h.
+ ***************************************************************/
+
+int rule_parse(const char *text, uint32_t *rule) {
+    const char *p = text;
+    uint32_t r = 0;
+
+    for (int k = 0; k < NUM_NAMED_RULES; k++) {
+        if (strcasecmp(text, named_rules[k].name) == 0) {
+            *rule = named_rules[k].rule;
+            return 0;
+        }
+    }
+
+    if (*p == 'B' || *p == 'b') {
+        //B<birth>/S<survival>, the slash may be left out
+        p++;
+        if (parse_counts(&p, 0, &r)) {
+            return -1;
+        }
+        if (*p == '/') {
+            p++;
+        }
+        if (*p != 'S' && *p != 's') {
+            return -1;
+        }
+        p++;
+        if (parse_counts(&p, 9, &r)) {
+            return -1;
+        }
+    }
+    else {
+        //<survival>/<birth>, the older notation
+        if (parse_counts(&p, 9, &r) || *p++ != '/' || parse_counts(&p, 0, &r)) {
+            return -1;
+        }
+    }
+    if (*p != '\0') {
+        return -1;
+    }
+    *rule = r;
+    return 0;
+}
+
+/******************** Format Rule **********************
+ * rule_format: See rule.h.
+ ***************************************************************/
+
+char *rule_format(uint32_t rule, char *text) {
+    char *p = text;
+
+    *p++ = 'B';
+    for (int n = 0; n <= 8; n++) {
+        if (rule & RULE_BIRTH(n)) {
+            *p++ = '0' + n;
+        }
+    }
+    *p++ = '/';
+    *p++ = 'S';
+    for (int n = 0; n <= 8; n++) {
+        if (rule & RULE_SURVIVE(n)) {
+            *p++ = '0' + n;
+        }
+    }
+    *p = '\0';
+    return text;
+}
+
+/******************** Rule Name **********************
+ * rule_name: See rule.h.
+ ***************************************************************/
+
+const char *rule_name(uint32_t rule) {
+    for (int k = 0; k < NUM_NAMED_RULES; k++) {
+        if (named_rules[k].rule == rule) {
+            return named_rules[k].name;
+        }
+    }
+    return NULL;
+}
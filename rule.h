@@ -0,0 +1,52 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Life-like (outer totalistic) rules. A rule is a word with bit n set if
+ * a dead cell with n live neighbors is born, and bit 9+n set if a live
+ * cell with n live neighbors survives, so the next state of any cell is
+ * one shift and mask of it. The kernels have copies specialized for the
+ * common rules below and fall back to that lookup for any other.
+ */
+#ifndef RULE_H
+#define RULE_H
+
+#include <stdint.h>
+
+#define RULE_BIRTH(n)    (1u << (n))
+#define RULE_SURVIVE(n)  (1u << (9 + (n)))
+
+/* every bit a rule may have */
+#define RULE_MASK  ((1u << 18) - 1)
+
+/* the rules with specialized kernels */
+#define RULE_LIFE       (RULE_BIRTH(3) | RULE_SURVIVE(2) | RULE_SURVIVE(3))
+#define RULE_HIGHLIFE   (RULE_LIFE | RULE_BIRTH(6))                //B36/S23
+#define RULE_DAY_NIGHT  (RULE_BIRTH(3) | RULE_BIRTH(6) | RULE_BIRTH(7) \
+        | RULE_BIRTH(8) | RULE_SURVIVE(3) | RULE_SURVIVE(4)            \
+        | RULE_SURVIVE(6) | RULE_SURVIVE(7) | RULE_SURVIVE(8))     //B3678/S34678
+#define RULE_SEEDS      (RULE_BIRTH(2))                            //B2/S
+
+/* room for any rule in B/S notation, with the nul */
+#define RULE_TEXT_MAX  (24)
+
+/* the next state of a cell (0 or 1) with n live neighbors */
+static inline int rule_next(uint32_t rule, int alive, int n) {
+    return (rule >> (n + 9 * alive)) & 1;
+}
+
+/* parse a rule in B/S notation ("B36/S23" or "B36S23", any case, either
+ * list may be empty), S/B notation ("23/36") or by name (life, highlife,
+ * daynight, seeds). returns 0, or -1 if the text is not a rule */
+int rule_parse(const char *text, uint32_t *rule);
+
+/* write rule in B/S notation to text (RULE_TEXT_MAX bytes), returns text */
+char *rule_format(uint32_t rule, char *text);
+
+/* the name of a rule with a specialized kernel, NULL for any other */
+const char *rule_name(uint32_t rule);
+
+#endif
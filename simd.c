@@ -0,0 +1,453 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * SSE2, AVX2 and AVX-512 stepping kernels for the int board.
+ * Each kernel walks a row strip: the 8 neighbors of a vector of cells
+ * are loaded from the rows above, at and below the strip with offsets
+ * of -1, 0 and +1, summed, and the rule is applied without branches:
+ * under B3/S23 a cell lives next round iff (neighbors | cell) == 3, under
+ * any other rule its bit neighbors + 9 * cell of the rule word is looked
+ * up with a variable shift (AVX2, AVX-512) or compares (SSE2). Every
+ * kernel is made once for each rule in rule.h, with the rule a constant,
+ * and once more taking it as an argument.
+ * The first and last columns wrap around and are done one at a time,
+ * unless the board has a halo, in which case nothing wraps at all.
+ * Every variant is compiled with a target attribute, so one binary
+ * carries all of them and picks one at runtime.
+ */
+#include <string.h>
+#include <stdint.h>
+#include <cpuid.h>
+#include <immintrin.h>
+#include "rule.h"
+#include "simd.h"
+
+/******************** Scalar Cell Update **********************
+ * step_cell: Computes one cell with explicit wraparound on columns.
+ * up, mid, down: The rows above, at and below the cell.
+ * cols: Row length.
+ * j: Column of the cell.
+ * rule: The rule, see rule.h.
+ * returns: 1 if the cell is alive next round, 0 otherwise.
+ ***************************************************************/
+
+static inline int step_cell(const int *up, const int *mid, const int *down,
+        int cols, int j, uint32_t rule) {
+    int jl = (j == 0) ? cols - 1 : j - 1;
+    int jr = (j == cols - 1) ? 0 : j + 1;
+    int n = up[jl] + up[j] + up[jr] + mid[jl] + mid[jr]
+        + down[jl] + down[j] + down[jr];
+
+    if (rule == RULE_LIFE) {
+        return (n | mid[j]) == 3;
+    }
+    return rule_next(rule, mid[j], n);
+}
+
+/******************** Scalar Span **********************
+ * step_span: Computes columns lo..hi of one row one cell at a time.
+ * up, mid, down, out: The rows above, at and below, and the output row.
+ * cols: Row length.
+ * lo, hi: The columns to compute (inclusive, may be empty).
+ * rule: The rule.
+ * returns: The number of live cells written.
+ ***************************************************************/
+
+static inline int step_span(const int *up, const int *mid, const int *down,
+        int *out, int cols, int lo, int hi, uint32_t rule) {
+    int live = 0;
+
+    for (int j = lo; j <= hi; j++) {
+        out[j] = step_cell(up, mid, down, cols, j, rule);
+        live += out[j];
+    }
+    return live;
+}
+
+/******************** Scalar Halo Span **********************
+ * step_span_halo: Like step_span, for a board with a halo around it.
+ * up, mid, down, out: The rows above, at and below, and the output row.
+ * lo, hi: The columns to compute (inclusive, may be empty).
+ * rule: The rule.
+ * returns: The number of live cells written.
+ ***************************************************************/
+
+static inline int step_span_halo(const int *up, const int *mid,
+        const int *down, int *out, int lo, int hi, uint32_t rule) {
+    int live = 0;
+
+    for (int j = lo; j <= hi; j++) {
+        int n = up[j-1] + up[j] + up[j+1] + mid[j-1] + mid[j+1]
+            + down[j-1] + down[j] + down[j+1];
+        out[j] = (rule == RULE_LIFE) ? (n | mid[j]) == 3
+            : rule_next(rule, mid[j], n);
+        live += out[j];
+    }
+    return live;
+}
+
+/******************** Vector Rules **********************
+ * rule_sse2, rule_avx2, rule_avx512: The next state of a vector of cells
+ *       from their neighbor counts n and states c (0 or 1). Bit 0 of each
+ *       lane (of the mask for AVX-512) is 1 if the cell is alive next
+ *       round, the other bits are anything. Always inlined, so a constant
+ *       rule folds to just the instructions it needs.
+ ***************************************************************/
+
+static inline __attribute__((target("sse2"), always_inline)) __m128i
+rule_sse2(__m128i n, __m128i c, __m128i three, uint32_t rule) {
+    __m128i idx, res;
+
+    if (rule == RULE_LIFE) {
+        return _mm_cmpeq_epi32(_mm_or_si128(n, c), three);
+    }
+    //no variable shift here: compare n + 9c with each count in the rule
+    idx = _mm_add_epi32(n, _mm_add_epi32(_mm_slli_epi32(c, 3), c));
+    res = _mm_setzero_si128();
+    for (int k = 0; k < 18; k++) {
+        if ((rule >> k) & 1) {
+            res = _mm_or_si128(res, _mm_cmpeq_epi32(idx, _mm_set1_epi32(k)));
+        }
+    }
+    return res;
+}
+
+static inline __attribute__((target("avx2"), always_inline)) __m256i
+rule_avx2(__m256i n, __m256i c, __m256i three, uint32_t rule) {
+    __m256i idx;
+
+    if (rule == RULE_LIFE) {
+        return _mm256_cmpeq_epi32(_mm256_or_si256(n, c), three);
+    }
+    //bit n + 9c of the rule word, shifted down to bit 0
+    idx = _mm256_add_epi32(n, _mm256_add_epi32(_mm256_slli_epi32(c, 3), c));
+    return _mm256_srlv_epi32(_mm256_set1_epi32(rule), idx);
+}
+
+static inline __attribute__((target("avx512f"), always_inline)) __mmask16
+rule_avx512(__m512i n, __m512i c, __m512i three, __m512i one, uint32_t rule) {
+    __m512i idx;
+
+    if (rule == RULE_LIFE) {
+        return _mm512_cmpeq_epi32_mask(_mm512_or_si512(n, c), three);
+    }
+    idx = _mm512_add_epi32(n, _mm512_add_epi32(_mm512_slli_epi32(c, 3), c));
+    return _mm512_test_epi32_mask(
+            _mm512_srlv_epi32(_mm512_set1_epi32(rule), idx), one);
+}
+
+/*
+ * Defines one region kernel: every row of the region is split into the
+ * wrapping edge columns (scalar), the vector body and a scalar remainder.
+ * STEP_BODY(up, mid, down, out, lo, hi, live, RULE) must compute whole
+ * vectors starting at lo, advancing lo and adding to live as it goes.
+ * RULE is either a constant, which makes a kernel for that rule only, or
+ * the rule argument.
+ */
+#define DEFINE_REGION_KERNEL(name, attr, STEP_BODY, RULE)                   \
+attr int name(const int *base, int *next, int rows, int cols,               \
+        int r0, int r1, int c0, int c1, uint32_t rule) {                    \
+    int live = 0;                                                           \
+                                                                            \
+    for (int i = r0; i <= r1; i++) {                                        \
+        const int *up = base + (long)((i == 0) ? rows - 1 : i - 1) * cols;  \
+        const int *mid = base + (long)i * cols;                             \
+        const int *down = base + (long)((i == rows - 1) ? 0 : i + 1) * cols;\
+        int *out = next + (long)i * cols;                                   \
+        int lo = c0, hi = c1;                                               \
+                                                                            \
+        if (lo == 0) {                                                      \
+            live += step_span(up, mid, down, out, cols, 0, 0, RULE);        \
+            lo = 1;                                                         \
+        }                                                                   \
+        if (hi == cols - 1 && hi >= lo) {                                   \
+            live += step_span(up, mid, down, out, cols, hi, hi, RULE);      \
+            hi--;                                                           \
+        }                                                                   \
+        STEP_BODY(up, mid, down, out, lo, hi, live, RULE);                  \
+        live += step_span(up, mid, down, out, cols, lo, hi, RULE);          \
+    }                                                                       \
+    return live;                                                            \
+}
+
+/*
+ * Defines one region kernel for a halo board: rows are stride apart and
+ * the halo holds copies of the wrapped edges, so every row is just the
+ * vector body and a scalar remainder.
+ */
+#define DEFINE_HALO_KERNEL(name, attr, STEP_BODY, RULE)                     \
+attr int name(const int *base, int *next, int stride,                       \
+        int r0, int r1, int c0, int c1, uint32_t rule) {                    \
+    int live = 0;                                                           \
+                                                                            \
+    for (int i = r0; i <= r1; i++) {                                        \
+        const int *mid = base + (long)i * stride;                           \
+        const int *up = mid - stride;                                       \
+        const int *down = mid + stride;                                     \
+        int *out = next + (long)i * stride;                                 \
+        int lo = c0, hi = c1;                                               \
+                                                                            \
+        STEP_BODY(up, mid, down, out, lo, hi, live, RULE);                  \
+        live += step_span_halo(up, mid, down, out, lo, hi, RULE);           \
+    }                                                                       \
+    return live;                                                            \
+}
+
+/* 4 cells at a time, horizontal neighbors come from unaligned loads */
+#define SSE2_BODY(up, mid, down, out, lo, hi, live, RULE)                   \
+    {                                                                       \
+        __m128i three = _mm_set1_epi32(3), one = _mm_set1_epi32(1);         \
+        __m128i acc = _mm_setzero_si128();                                  \
+        int lanes[4];                                                       \
+        for (; lo + 3 <= hi; lo += 4) {                                     \
+            __m128i c = _mm_loadu_si128((const __m128i *)(mid + lo));       \
+            __m128i n = _mm_add_epi32(                                      \
+                _mm_add_epi32(                                              \
+                    _mm_add_epi32(                                          \
+                        _mm_loadu_si128((const __m128i *)(up + lo - 1)),    \
+                        _mm_loadu_si128((const __m128i *)(up + lo))),       \
+                    _mm_add_epi32(                                          \
+                        _mm_loadu_si128((const __m128i *)(up + lo + 1)),    \
+                        _mm_loadu_si128((const __m128i *)(mid + lo - 1)))), \
+                _mm_add_epi32(                                              \
+                    _mm_add_epi32(                                          \
+                        _mm_loadu_si128((const __m128i *)(mid + lo + 1)),   \
+                        _mm_loadu_si128((const __m128i *)(down + lo - 1))), \
+                    _mm_add_epi32(                                          \
+                        _mm_loadu_si128((const __m128i *)(down + lo)),      \
+                        _mm_loadu_si128((const __m128i *)(down + lo + 1)))));\
+            __m128i res = _mm_and_si128(rule_sse2(n, c, three, RULE), one); \
+            _mm_storeu_si128((__m128i *)(out + lo), res);                   \
+            acc = _mm_add_epi32(acc, res);                                  \
+        }                                                                   \
+        _mm_storeu_si128((__m128i *)lanes, acc);                            \
+        live += lanes[0] + lanes[1] + lanes[2] + lanes[3];                  \
+    }
+
+/* 8 cells at a time */
+#define AVX2_BODY(up, mid, down, out, lo, hi, live, RULE)                   \
+    {                                                                       \
+        __m256i three = _mm256_set1_epi32(3), one = _mm256_set1_epi32(1);   \
+        __m256i acc = _mm256_setzero_si256();                               \
+        int lanes[8];                                                       \
+        for (; lo + 7 <= hi; lo += 8) {                                     \
+            __m256i c = _mm256_loadu_si256((const __m256i *)(mid + lo));    \
+            __m256i n = _mm256_add_epi32(                                   \
+                _mm256_add_epi32(                                           \
+                    _mm256_add_epi32(                                       \
+                        _mm256_loadu_si256((const __m256i *)(up + lo - 1)), \
+                        _mm256_loadu_si256((const __m256i *)(up + lo))),    \
+                    _mm256_add_epi32(                                       \
+                        _mm256_loadu_si256((const __m256i *)(up + lo + 1)), \
+                        _mm256_loadu_si256((const __m256i *)(mid + lo - 1)))),\
+                _mm256_add_epi32(                                           \
+                    _mm256_add_epi32(                                       \
+                        _mm256_loadu_si256((const __m256i *)(mid + lo + 1)),\
+                        _mm256_loadu_si256((const __m256i *)(down + lo - 1))),\
+                    _mm256_add_epi32(                                       \
+                        _mm256_loadu_si256((const __m256i *)(down + lo)),   \
+                        _mm256_loadu_si256((const __m256i *)(down + lo + 1)))));\
+            __m256i res = _mm256_and_si256(                                 \
+                rule_avx2(n, c, three, RULE), one);                         \
+            _mm256_storeu_si256((__m256i *)(out + lo), res);                \
+            acc = _mm256_add_epi32(acc, res);                               \
+        }                                                                   \
+        _mm256_storeu_si256((__m256i *)lanes, acc);                         \
+        for (int l = 0; l < 8; l++) {                                       \
+            live += lanes[l];                                               \
+        }                                                                   \
+    }
+
+/* 16 cells at a time, the compare yields a mask we can popcount */
+#define AVX512_BODY(up, mid, down, out, lo, hi, live, RULE)                 \
+    {                                                                       \
+        __m512i three = _mm512_set1_epi32(3), one = _mm512_set1_epi32(1);   \
+        for (; lo + 15 <= hi; lo += 16) {                                   \
+            __m512i c = _mm512_loadu_si512(mid + lo);                       \
+            __m512i n = _mm512_add_epi32(                                   \
+                _mm512_add_epi32(                                           \
+                    _mm512_add_epi32(_mm512_loadu_si512(up + lo - 1),       \
+                        _mm512_loadu_si512(up + lo)),                       \
+                    _mm512_add_epi32(_mm512_loadu_si512(up + lo + 1),       \
+                        _mm512_loadu_si512(mid + lo - 1))),                 \
+                _mm512_add_epi32(                                           \
+                    _mm512_add_epi32(_mm512_loadu_si512(mid + lo + 1),      \
+                        _mm512_loadu_si512(down + lo - 1)),                 \
+                    _mm512_add_epi32(_mm512_loadu_si512(down + lo),         \
+                        _mm512_loadu_si512(down + lo + 1))));               \
+            __mmask16 alive = rule_avx512(n, c, three, one, RULE);          \
+            _mm512_storeu_si512(out + lo, _mm512_maskz_mov_epi32(alive, one));\
+            live += __builtin_popcount(alive);                              \
+        }                                                                   \
+    }
+
+/*
+ * Defines the kernels of one ISA: one for each rule in kernel_rules, with
+ * the rule a constant, and one for any rule.
+ */
+#define DEFINE_ISA_KERNELS(DEFINE, prefix, attr, BODY)                      \
+    DEFINE(prefix##_life, attr, BODY, RULE_LIFE)                            \
+    DEFINE(prefix##_highlife, attr, BODY, RULE_HIGHLIFE)                    \
+    DEFINE(prefix##_day_night, attr, BODY, RULE_DAY_NIGHT)                  \
+    DEFINE(prefix##_seeds, attr, BODY, RULE_SEEDS)                          \
+    DEFINE(prefix##_any, attr, BODY, rule)
+
+DEFINE_ISA_KERNELS(DEFINE_REGION_KERNEL, step_sse2,
+        __attribute__((target("sse2"))), SSE2_BODY)
+DEFINE_ISA_KERNELS(DEFINE_REGION_KERNEL, step_avx2,
+        __attribute__((target("avx2"))), AVX2_BODY)
+DEFINE_ISA_KERNELS(DEFINE_REGION_KERNEL, step_avx512,
+        __attribute__((target("avx512f"))), AVX512_BODY)
+DEFINE_ISA_KERNELS(DEFINE_HALO_KERNEL, step_halo_sse2,
+        __attribute__((target("sse2"))), SSE2_BODY)
+DEFINE_ISA_KERNELS(DEFINE_HALO_KERNEL, step_halo_avx2,
+        __attribute__((target("avx2"))), AVX2_BODY)
+DEFINE_ISA_KERNELS(DEFINE_HALO_KERNEL, step_halo_avx512,
+        __attribute__((target("avx512f"))), AVX512_BODY)
+
+/* the rules with kernels of their own, in DEFINE_ISA_KERNELS order */
+static const uint32_t kernel_rules[] = {
+    RULE_LIFE, RULE_HIGHLIFE, RULE_DAY_NIGHT, RULE_SEEDS
+};
+
+#define NUM_KERNEL_RULES \
+    ((int)(sizeof(kernel_rules) / sizeof(kernel_rules[0])))
+
+/* indexed by ISA, then by kernel_rules (the last takes any rule) */
+static const simd_step_fn step_kernels[][NUM_KERNEL_RULES + 1] = {
+    {step_sse2_life, step_sse2_highlife, step_sse2_day_night,
+        step_sse2_seeds, step_sse2_any},
+    {step_avx2_life, step_avx2_highlife, step_avx2_day_night,
+        step_avx2_seeds, step_avx2_any},
+    {step_avx512_life, step_avx512_highlife, step_avx512_day_night,
+        step_avx512_seeds, step_avx512_any},
+};
+
+static const simd_halo_step_fn halo_kernels[][NUM_KERNEL_RULES + 1] = {
+    {step_halo_sse2_life, step_halo_sse2_highlife, step_halo_sse2_day_night,
+        step_halo_sse2_seeds, step_halo_sse2_any},
+    {step_halo_avx2_life, step_halo_avx2_highlife, step_halo_avx2_day_night,
+        step_halo_avx2_seeds, step_halo_avx2_any},
+    {step_halo_avx512_life, step_halo_avx512_highlife,
+        step_halo_avx512_day_night, step_halo_avx512_seeds,
+        step_halo_avx512_any},
+};
+
+/******************** Kernel of a Rule **********************
+ * rule_kernel: Finds a rule's column in the kernel tables.
+ * rule: The rule.
+ * returns: Its index in kernel_rules, or NUM_KERNEL_RULES for the kernel
+ *       that takes any rule.
+ ***************************************************************/
+
+static int rule_kernel(uint32_t rule) {
+    int k = 0;
+
+    while (k < NUM_KERNEL_RULES && kernel_rules[k] != rule) {
+        k++;
+    }
+    return k;
+}
+
+/******************** OS Vector State Check **********************
+ * os_saves_state: Checks that the OS saves the given register state
+ *       on context switches (XCR0), needed before using AVX registers.
+ * mask: The XCR0 bits that must all be set.
+ * returns: 1 if they are, 0 otherwise.
+ ***************************************************************/
+
+static int os_saves_state(uint32_t mask) {
+    unsigned int eax, ebx, ecx, edx;
+    uint32_t xcr0_lo, xcr0_hi;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE)) {
+        return 0;
+    }
+    __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    return (xcr0_lo & mask) == mask;
+}
+
+/******************** ISA Support Check **********************
+ * simd_isa_supported: Checks CPUID and XCR0 for an instruction set.
+ * isa: One of ISA_SSE2, ISA_AVX2 or ISA_AVX512.
+ * returns: 1 if the kernel for isa can run here, 0 otherwise.
+ ***************************************************************/
+
+int simd_isa_supported(int isa) {
+    unsigned int eax, ebx, ecx, edx;
+
+    if (isa == ISA_SSE2) {
+        return 1; //part of x86-64
+    }
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    if (isa == ISA_AVX2) {
+        //XMM and YMM state
+        return (ebx & bit_AVX2) && os_saves_state(0x6);
+    }
+    if (isa == ISA_AVX512) {
+        //XMM, YMM, opmask and both halves of the ZMM state
+        return (ebx & bit_AVX512F) && os_saves_state(0xe6);
+    }
+    return 0;
+}
+
+/******************** Detect ISA **********************
+ * simd_detect_isa: Finds the widest instruction set we have a kernel for.
+ * returns: ISA_AVX512, ISA_AVX2 or ISA_SSE2.
+ ***************************************************************/
+
+int simd_detect_isa(void) {
+    if (simd_isa_supported(ISA_AVX512)) {
+        return ISA_AVX512;
+    }
+    if (simd_isa_supported(ISA_AVX2)) {
+        return ISA_AVX2;
+    }
+    return ISA_SSE2;
+}
+
+/******************** Select Kernel **********************
+ * simd_kernel, simd_halo_kernel: Map an instruction set and a rule to
+ *       their kernel.
+ * isa: One of ISA_SSE2, ISA_AVX2 or ISA_AVX512.
+ * rule: The rule, see rule.h.
+ * returns: The region kernel (plain or halo board), specialized for rule
+ *       if it is one of kernel_rules.
+ ***************************************************************/
+
+simd_step_fn simd_kernel(int isa, uint32_t rule) {
+    return step_kernels[isa][rule_kernel(rule)];
+}
+
+simd_halo_step_fn simd_halo_kernel(int isa, uint32_t rule) {
+    return halo_kernels[isa][rule_kernel(rule)];
+}
+
+/******************** ISA Names **********************
+ * simd_isa_name, simd_parse_isa: Convert between ISA ids and names.
+ ***************************************************************/
+
+const char *simd_isa_name(int isa) {
+    switch (isa) {
+        case ISA_AUTO:   return "auto";
+        case ISA_SSE2:   return "sse2";
+        case ISA_AVX2:   return "avx2";
+        case ISA_AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+int simd_parse_isa(const char *name) {
+    for (int isa = ISA_AUTO; isa <= ISA_AVX512; isa++) {
+        if (strcmp(name, simd_isa_name(isa)) == 0) {
+            return isa;
+        }
+    }
+    return -2;
+}
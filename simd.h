@@ -0,0 +1,54 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Vectorized Game of Life kernels for the int board, with one variant
+ * per instruction set and runtime selection of the widest one the CPU
+ * (and OS) supports.
+ */
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+
+/* Instruction sets with a kernel, in increasing vector width */
+#define ISA_AUTO    (-1)  // pick the widest supported at startup
+#define ISA_SSE2    (0)   // 4 cells per instruction, every x86-64 has it
+#define ISA_AVX2    (1)   // 8 cells per instruction
+#define ISA_AVX512  (2)   // 16 cells per instruction
+
+/* computes rows r0..r1, columns c0..c1 (inclusive) of the next generation
+ * of a toroidal rows x cols int board under rule (which a kernel made for
+ * one rule ignores), returns the live cells written */
+typedef int (*simd_step_fn)(const int *base, int *next, int rows, int cols,
+        int r0, int r1, int c0, int c1, uint32_t rule);
+
+/* same for a board padded with a one-cell halo: base and next point at
+ * cell (0, 0) and rows are stride ints apart, so neighbors are plain
+ * fixed offsets and nothing wraps */
+typedef int (*simd_halo_step_fn)(const int *base, int *next, int stride,
+        int r0, int r1, int c0, int c1, uint32_t rule);
+
+/* returns the widest ISA the CPU and OS support (via CPUID/XGETBV) */
+int simd_detect_isa(void);
+
+/* returns 1 if the CPU and OS support isa, 0 otherwise */
+int simd_isa_supported(int isa);
+
+/* returns the kernel for isa, which must be supported, and rule */
+simd_step_fn simd_kernel(int isa, uint32_t rule);
+
+/* returns the halo board kernel for isa, which must be supported, and
+ * rule */
+simd_halo_step_fn simd_halo_kernel(int isa, uint32_t rule);
+
+/* returns the printable name of isa ("sse2", "avx2", "avx512") */
+const char *simd_isa_name(int isa);
+
+/* parses an ISA name (including "auto"), returns -2 if unknown */
+int simd_parse_isa(const char *name);
+
+#endif
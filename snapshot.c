@@ -0,0 +1,284 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Binary board snapshots and the background checkpoint writer, see
+ * snapshot.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bitboard.h"
+#include "snapshot.h"
+
+/******************** Is Snapshot **********************
+ * snapshot_is: See snapshot.h.
+ ***************************************************************/
+
+int snapshot_is(const char *path) {
+    char magic[8];
+    FILE *in = fopen(path, "rb");
+    int is = 0;
+
+    if (!in) {
+        return 0;
+    }
+    if (fread(magic, 1, sizeof(magic), in) == sizeof(magic)) {
+        is = memcmp(magic, SNAP_MAGIC, sizeof(magic)) == 0;
+    }
+    fclose(in);
+    return is;
+}
+
+/******************** Map Snapshot **********************
+ * snapshot_map: See snapshot.h. The mapping is private, so the board can
+ *       be stepped in place; pages are only copied once written.
+ ***************************************************************/
+
+int snapshot_map(const char *path, struct snap_map *map) {
+    struct stat st;
+    const struct snap_header *h;
+    size_t body;
+    int fd;
+
+    map->addr = NULL;
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        printf("Error: failed to open snapshot: %s\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    if ((size_t)st.st_size < SNAP_BODY_OFFSET) {
+        printf("Error: snapshot %s is cut short\n", path);
+        close(fd);
+        return -1;
+    }
+    map->len = st.st_size;
+    map->addr = mmap(NULL, map->len, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+            fd, 0);
+    close(fd);
+    if (map->addr == MAP_FAILED) {
+        printf("Error: failed to map snapshot: %s\n", path);
+        map->addr = NULL;
+        return -1;
+    }
+
+    h = map->addr;
+    map->header = h;
+    if (memcmp(h->magic, SNAP_MAGIC, sizeof(h->magic)) != 0
+            || h->body_offset != SNAP_BODY_OFFSET || h->rows < 1
+            || h->cols < 1 || h->generation < 0
+            || h->generation > h->iters) {
+        printf("Error: %s is not a snapshot this gol can read\n", path);
+        snapshot_unmap(map);
+        return -1;
+    }
+    body = sizeof(uint64_t) * (size_t)h->rows * bitboard_words(h->cols);
+    if (map->len < h->body_offset + body) {
+        printf("Error: snapshot %s is cut short\n", path);
+        snapshot_unmap(map);
+        return -1;
+    }
+    map->bits = (uint64_t *)((char *)map->addr + h->body_offset);
+    return 0;
+}
+
+/******************** Unmap Snapshot **********************/
+void snapshot_unmap(struct snap_map *map) {
+    if (map->addr) {
+        munmap(map->addr, map->len);
+        map->addr = NULL;
+    }
+}
+
+/******************** Write Snapshot **********************
+ * snapshot_write: See snapshot.h. The data is synced before the rename,
+ *       so a crash leaves either the old snapshot or the new one.
+ ***************************************************************/
+
+int snapshot_write(const char *path, const struct snap_header *header,
+        const uint64_t *bits) {
+    char page[SNAP_BODY_OFFSET];
+    size_t body = sizeof(uint64_t) * (size_t)header->rows
+        * bitboard_words(header->cols);
+    size_t tmp_len = strlen(path) + 5;
+    char *tmp = malloc(tmp_len);
+    FILE *out;
+    int ok;
+
+    if (!tmp) {
+        return -1;
+    }
+    snprintf(tmp, tmp_len, "%s.tmp", path);
+    out = fopen(tmp, "wb");
+    if (!out) {
+        free(tmp);
+        return -1;
+    }
+    memset(page, 0, sizeof(page));
+    memcpy(page, header, sizeof(*header));
+    ok = fwrite(page, 1, sizeof(page), out) == sizeof(page)
+        && fwrite(bits, 1, body, out) == body
+        && fflush(out) == 0
+        && fsync(fileno(out)) == 0;
+    ok = (fclose(out) == 0) && ok;
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok) {
+        unlink(tmp);
+    }
+    free(tmp);
+    return ok ? 0 : -1;
+}
+
+/******************** Writer Thread **********************
+ * writer_main: Writes each board handed over by the workers, until
+ *       snapshot_writer_stop.
+ * arg: The snap_writer.
+ * returns: NULL.
+ ***************************************************************/
+
+static void *writer_main(void *arg) {
+    struct snap_writer *w = arg;
+    long words = (long)w->rows * bitboard_words(w->cols);
+
+    pthread_mutex_lock(&w->lock);
+    while (1) {
+        while (!w->posted && !w->quit) {
+            pthread_cond_wait(&w->posted_cond, &w->lock);
+        }
+        if (!w->posted) {
+            break;
+        }
+        w->posted = 0;
+        pthread_mutex_unlock(&w->lock);
+
+        struct snap_header h;
+        long long live = 0;
+
+        for (long k = 0; k < words; k++) {
+            live += __builtin_popcountll(w->bits[k]);
+        }
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, SNAP_MAGIC, sizeof(h.magic));
+        h.body_offset = SNAP_BODY_OFFSET;
+        h.rule = w->rule;
+        h.rows = w->rows;
+        h.cols = w->cols;
+        h.generation = w->gen;
+        h.iters = w->iters;
+        h.live = live;
+        if (snapshot_write(w->path, &h, w->bits)) {
+            //keep running, the last good checkpoint is still there
+            printf("Warning: failed to write checkpoint %s at round %lld\n",
+                    w->path, w->gen);
+        }
+        else {
+            w->written++;
+        }
+
+        pthread_mutex_lock(&w->lock);
+        __atomic_store_n(&w->busy, 0, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/******************** Start Writer **********************
+ * snapshot_writer_start: See snapshot.h.
+ ***************************************************************/
+
+struct snap_writer *snapshot_writer_start(const char *path, int rows,
+        int cols, long long iters, uint32_t rule, int every,
+        int num_threads) {
+    struct snap_writer *w = calloc(1, sizeof(struct snap_writer));
+
+    if (!w) {
+        printf("malloc failed: checkpoint writer\n");
+        exit(1);
+    }
+    w->bits = bitboard_alloc(rows, cols);
+    if (!w->bits) {
+        printf("malloc failed: checkpoint board\n");
+        exit(1);
+    }
+    w->path = path;
+    w->rows = rows;
+    w->cols = cols;
+    w->iters = iters;
+    w->rule = rule;
+    w->every = every;
+    w->num_threads = num_threads;
+    w->next_gen = every;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->posted_cond, NULL);
+    if (pthread_create(&w->tid, NULL, writer_main, w)) {
+        perror("Error: pthread_create");
+        exit(1);
+    }
+    return w;
+}
+
+/******************** Plan Checkpoint **********************
+ * snapshot_writer_plan: See snapshot.h. Temporal blocking can step past
+ *       a multiple of every, so the checkpoint goes at the first round at
+ *       or after it.
+ ***************************************************************/
+
+void snapshot_writer_plan(struct snap_writer *w, long long gen) {
+    w->take = 0;
+    if (gen < w->next_gen) {
+        return;
+    }
+    w->next_gen = gen - gen % w->every + w->every;
+    if (__atomic_load_n(&w->busy, __ATOMIC_ACQUIRE)) {
+        w->skipped++;
+        return;
+    }
+    w->busy = 1;
+    w->packed = 0;
+    w->gen = gen;
+    w->take = 1;
+}
+
+/******************** Board Packed **********************
+ * snapshot_writer_packed: See snapshot.h.
+ ***************************************************************/
+
+void snapshot_writer_packed(struct snap_writer *w) {
+    if (__atomic_add_fetch(&w->packed, 1, __ATOMIC_ACQ_REL)
+            == w->num_threads) {
+        pthread_mutex_lock(&w->lock);
+        w->posted = 1;
+        pthread_cond_signal(&w->posted_cond);
+        pthread_mutex_unlock(&w->lock);
+    }
+}
+
+/******************** Stop Writer **********************
+ * snapshot_writer_stop: See snapshot.h.
+ ***************************************************************/
+
+void snapshot_writer_stop(struct snap_writer *w, long *written,
+        long *skipped) {
+    pthread_mutex_lock(&w->lock);
+    w->quit = 1;
+    pthread_cond_signal(&w->posted_cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->tid, NULL);
+    *written = w->written;
+    *skipped = w->skipped;
+
+    pthread_cond_destroy(&w->posted_cond);
+    pthread_mutex_destroy(&w->lock);
+    free(w->bits);
+    free(w);
+}
@@ -0,0 +1,109 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Binary board snapshots, used for checkpoint and restart. A snapshot is
+ * a fixed header followed, at the next page boundary, by the board in the
+ * bitboard.h layout (rows of ceil(cols/64) words), so it can be mapped and
+ * used as a bit-packed board without copying.
+ */
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/* first 8 bytes of every snapshot */
+#define SNAP_MAGIC "GOLSNAP1"
+
+/* where the board starts in the file: one page, so it maps aligned */
+#define SNAP_BODY_OFFSET (4096)
+
+struct snap_header {
+    char magic[8]; //SNAP_MAGIC, not nul terminated
+    uint32_t body_offset; //bytes from the start of the file to the board
+    uint32_t rule; //the rule the board is run under, see rule.h
+    int32_t rows;
+    int32_t cols;
+    int64_t generation; //rounds run to reach this board
+    int64_t iters; //rounds the whole run is meant to take
+    int64_t live; //live cells on the board
+};
+
+/* a snapshot mapped into memory, copy on write */
+struct snap_map {
+    void *addr; //NULL if nothing is mapped
+    size_t len;
+    const struct snap_header *header;
+    uint64_t *bits; //the board, writable without touching the file
+};
+
+/* Background checkpoint writer. Every `every` rounds one thread plans a
+ * checkpoint, then each of the num_threads workers packs its share of the
+ * board into bits and calls snapshot_writer_packed; the last one hands the
+ * board to the writer thread. If the previous checkpoint is still being
+ * written the new one is skipped, so the workers never wait on the disk. */
+struct snap_writer {
+    const char *path; //the latest checkpoint, replaced atomically
+    int rows, cols;
+    long long iters;
+    uint32_t rule;
+    int every; //rounds between checkpoints
+    int num_threads;
+    uint64_t *bits; //the board being checkpointed
+
+    //set by the planning thread, read by the workers after a barrier
+    int take; //1 if the workers pack this round
+    long long gen; //the round being packed
+    long long next_gen; //the next round to checkpoint at or after
+
+    int busy; //1 from planning until written (atomic)
+    int packed; //workers done packing (atomic)
+    long written; //checkpoints written
+    long skipped; //checkpoints skipped because the writer was busy
+
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t posted_cond;
+    int posted; //a packed board waits for the writer
+    int quit;
+};
+
+/* returns 1 if the file at path starts with SNAP_MAGIC, 0 otherwise */
+int snapshot_is(const char *path);
+
+/* map the snapshot at path, returns 0 or -1 (with a message printed) if
+ * it cannot be opened or is not a whole snapshot */
+int snapshot_map(const char *path, struct snap_map *map);
+
+/* unmap a snapshot, map->addr is NULL after */
+void snapshot_unmap(struct snap_map *map);
+
+/* write header and board to path through a temporary file and a rename,
+ * so path always holds a whole snapshot. returns 0 or -1 */
+int snapshot_write(const char *path, const struct snap_header *header,
+        const uint64_t *bits);
+
+/* start a writer thread for a rows x cols board run under rule, exits on
+ * failure */
+struct snap_writer *snapshot_writer_start(const char *path, int rows,
+        int cols, long long iters, uint32_t rule, int every,
+        int num_threads);
+
+/* called by one thread once round gen is computed and before the barrier
+ * that ends it: sets take if the workers should pack this round */
+void snapshot_writer_plan(struct snap_writer *w, long long gen);
+
+/* called by each worker after packing its rows of a planned round */
+void snapshot_writer_packed(struct snap_writer *w);
+
+/* finish the last checkpoint, stop the thread and free the writer, after
+ * storing how many checkpoints were written and skipped */
+void snapshot_writer_stop(struct snap_writer *w, long *written,
+        long *skipped);
+
+#endif
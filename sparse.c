@@ -0,0 +1,278 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Sparse Game of Life engine. A generation is an array of live cell
+ * keys. To step it, every live cell adds 2 to the score of each of its 8
+ * neighbors and 1 to its own in an open-addressing hash table, so a
+ * candidate's score is 2 * (live neighbors) + (alive now), and the rule
+ * picks the scores of the next generation (5, 6 and 7 for B3/S23). Only
+ * cells next to a live one are candidates, so rules that give birth with
+ * 0 neighbors cannot be run this way. The table is sized from the
+ * population, not the board, and is cleared by the same scan that reads
+ * it. It and the cell arrays shrink again when the population falls, so
+ * a board that dies down does not keep paying for its peak.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "rule.h"
+#include "sparse.h"
+
+/* smallest hash table, in slots */
+#define SPARSE_MIN_SLOTS (1 << 10)
+
+/* hash table slots per live cell: at most 9 candidates per live cell, so
+ * the table stays under 9/16 full */
+#define SPARSE_SLOTS_PER_CELL (16)
+
+/* the table and cell arrays are cut back to size once they are this many
+ * times bigger than the population needs (not at once, so a population
+ * going up and down a little does not reallocate every generation) */
+#define SPARSE_SHRINK (4)
+
+/* one candidate cell, score 0 means the slot is empty */
+struct sparse_slot {
+    uint64_t key;
+    uint32_t score; //2 per live neighbor, plus 1 if alive
+    uint32_t pad;
+};
+
+/******************** Hash Slot **********************
+ * slot_of: The home slot of a key in a table of 2^bits slots.
+ ***************************************************************/
+
+static inline size_t slot_of(uint64_t key, int bits) {
+    return (size_t)((key * 0x9e3779b97f4a7c15ULL) >> (64 - bits));
+}
+
+/******************** Add Score **********************
+ * add_score: Adds to the score of a cell, inserting it if new.
+ * table, bits: The hash table of 2^bits slots.
+ * key: The cell.
+ * score: What to add (nonzero).
+ * returns: void.
+ ***************************************************************/
+
+static inline void add_score(struct sparse_slot *table, int bits,
+        uint64_t key, uint32_t score) {
+    size_t mask = ((size_t)1 << bits) - 1;
+    size_t s = slot_of(key, bits);
+
+    while (table[s].score && table[s].key != key) {
+        s = (s + 1) & mask;
+    }
+    table[s].key = key;
+    table[s].score += score;
+}
+
+/******************** Step **********************
+ * step: Computes the next generation of a set of live cells.
+ * live, num: The live cells now.
+ * next: Where to write the next generation (room for 9*num cells).
+ * table, bits: An all-empty hash table with room for 9*num cells, it is
+ *       left empty again.
+ * rows, cols: The torus size, unless unbounded is set.
+ * alive: Bit s is set if a cell scoring s is alive next generation.
+ * returns: The number of cells written to next, -1 if a cell left the
+ *       plane.
+ ***************************************************************/
+
+static long step(const uint64_t *live, long num, uint64_t *next,
+        struct sparse_slot *table, int bits, int rows, int cols,
+        int unbounded, uint32_t alive) {
+    size_t slots = (size_t)1 << bits;
+    long out = 0;
+
+    for (long k = 0; k < num; k++) {
+        long r = sparse_row(live[k]);
+        long c = sparse_col(live[k]);
+
+        if (unbounded && (labs(r) > SPARSE_MAX_COORD
+                    || labs(c) > SPARSE_MAX_COORD)) {
+            return -1;
+        }
+        add_score(table, bits, live[k], 1);
+        for (int dr = -1; dr <= 1; dr++) {
+            long nr = r + dr;
+
+            if (!unbounded) {
+                if (nr < 0) {
+                    nr += rows;
+                }
+                else if (nr >= rows) {
+                    nr -= rows;
+                }
+            }
+            for (int dc = -1; dc <= 1; dc++) {
+                long nc = c + dc;
+
+                if (dr == 0 && dc == 0) {
+                    continue;
+                }
+                if (!unbounded) {
+                    if (nc < 0) {
+                        nc += cols;
+                    }
+                    else if (nc >= cols) {
+                        nc -= cols;
+                    }
+                }
+                add_score(table, bits, sparse_key(nr, nc), 2);
+            }
+        }
+    }
+
+    //empty slots score 0, which is never alive
+    for (size_t s = 0; s < slots; s++) {
+        uint32_t score = table[s].score;
+
+        if ((alive >> score) & 1) {
+            next[out++] = table[s].key;
+        }
+        table[s].score = 0;
+    }
+    return out;
+}
+
+/******************** Compare Keys **********************/
+static int compare_keys(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/******************** Run Sparse Engine **********************
+ * sparse_run: See sparse.h. The cells are sorted and made distinct
+ *       first. The cell arrays and the table grow to the size each
+ *       generation needs, and shrink when they are SPARSE_SHRINK times
+ *       that.
+ ***************************************************************/
+
+long sparse_run(uint64_t **cells, long num, int rows, int cols,
+        int unbounded, long gens, uint32_t rule, struct sparse_stats *stats) {
+    uint64_t *live = *cells;
+    uint64_t *next = NULL;
+    long cap = 0; //cells live and next have room for
+    struct sparse_slot *table = NULL;
+    int bits = 0;
+    uint32_t alive = 0; //scores alive next generation
+
+    //score 2n + a is alive if bit n + 9a of the rule is set
+    for (int n = 0; n <= 8; n++) {
+        for (int a = 0; a <= 1; a++) {
+            if (rule_next(rule, a, n)) {
+                alive |= 1u << (2 * n + a);
+            }
+        }
+    }
+    alive &= ~1u;
+
+    //the file may list a cell twice
+    qsort(live, num, sizeof(uint64_t), compare_keys);
+    if (num > 0) {
+        long u = 1;
+
+        for (long k = 1; k < num; k++) {
+            if (live[k] != live[u-1]) {
+                live[u++] = live[k];
+            }
+        }
+        num = u;
+    }
+
+    if (stats) {
+        stats->peak_live = num;
+        stats->peak_bytes = 0;
+    }
+
+    for (long g = 0; g < gens && num > 0; g++) {
+        size_t slots = (size_t)num * SPARSE_SLOTS_PER_CELL;
+
+        //room for every candidate of this generation
+        if (9 * num > cap || 9 * num * SPARSE_SHRINK < cap) {
+            cap = 9 * num;
+            live = realloc(live, sizeof(uint64_t) * cap);
+            free(next);
+            next = malloc(sizeof(uint64_t) * cap);
+            if (!live || !next) {
+                printf("malloc failed: sparse cells\n");
+                exit(1);
+            }
+        }
+        if (slots < SPARSE_MIN_SLOTS) {
+            slots = SPARSE_MIN_SLOTS;
+        }
+        if (((size_t)1 << bits) < slots
+                || ((size_t)1 << bits) > slots * SPARSE_SHRINK) {
+            bits = 0;
+            while (((size_t)1 << bits) < slots) {
+                bits++;
+            }
+            free(table);
+            table = calloc((size_t)1 << bits, sizeof(struct sparse_slot));
+            if (!table) {
+                printf("malloc failed: sparse hash table\n");
+                exit(1);
+            }
+        }
+        if (stats) {
+            size_t bytes = 2 * sizeof(uint64_t) * cap
+                + sizeof(struct sparse_slot) * ((size_t)1 << bits);
+
+            if (bytes > stats->peak_bytes) {
+                stats->peak_bytes = bytes;
+            }
+        }
+
+        num = step(live, num, next, table, bits, rows, cols, unbounded,
+                alive);
+        if (num < 0) {
+            *cells = live;
+            free(next);
+            free(table);
+            return -1;
+        }
+        //the next generation becomes the current one
+        uint64_t *tmp = live;
+        live = next;
+        next = tmp;
+
+        if (stats && num > stats->peak_live) {
+            stats->peak_live = num;
+        }
+    }
+
+    qsort(live, num, sizeof(uint64_t), compare_keys);
+    free(next);
+    free(table);
+    *cells = live;
+    return num;
+}
+
+/******************** Has Cell **********************
+ * sparse_has: Binary search for a key in the sorted live cells.
+ ***************************************************************/
+
+int sparse_has(const uint64_t *cells, long num, uint64_t key) {
+    long lo = 0;
+    long hi = num - 1;
+
+    while (lo <= hi) {
+        long mid = lo + (hi - lo) / 2;
+
+        if (cells[mid] == key) {
+            return 1;
+        }
+        if (cells[mid] < key) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+    return 0;
+}
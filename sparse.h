@@ -0,0 +1,55 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Sparse Game of Life engine: only live cells are stored, as one 64-bit
+ * key each, so memory and time grow with the population rather than the
+ * board area. The board is either the usual rows x cols torus or an
+ * unbounded plane.
+ */
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* live cells must stay within this many cells of (0, 0) on the plane */
+#define SPARSE_MAX_COORD (INT32_MAX - 1)
+
+/* the key of cell (row, col): row in the high 32 bits and col in the low,
+ * both offset by 2^31, so keys sort by row and then column */
+static inline uint64_t sparse_key(long row, long col) {
+    return ((uint64_t)(uint32_t)(row + 0x80000000L) << 32)
+        | (uint32_t)(col + 0x80000000L);
+}
+
+/* row and column of a key */
+static inline long sparse_row(uint64_t key) {
+    return (long)(key >> 32) - 0x80000000L;
+}
+
+static inline long sparse_col(uint64_t key) {
+    return (long)(key & 0xffffffffu) - 0x80000000L;
+}
+
+/* what a run did, filled in by sparse_run */
+struct sparse_stats {
+    long peak_live; //most live cells in any generation
+    size_t peak_bytes; //most memory held by the cell arrays and hash table
+};
+
+/* advance the live cells in *cells (num keys in any order, malloc'd) by
+ * gens generations under rule, which must not give birth with 0 neighbors
+ * (see rule.h). rows x cols is a torus unless unbounded is set. *cells is
+ * replaced by the final live cells, sorted, and stats may be NULL.
+ * returns the number of live cells, or -1 if a cell left the plane */
+long sparse_run(uint64_t **cells, long num, int rows, int cols,
+        int unbounded, long gens, uint32_t rule, struct sparse_stats *stats);
+
+/* returns 1 if key is one of the num sorted cells, 0 otherwise */
+int sparse_has(const uint64_t *cells, long num, uint64_t key);
+
+#endif
@@ -0,0 +1,300 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * The per-round record stream and its writer thread, see stream.h.
+ */
+#include <stdlib.h>
+#include <limits.h>
+#include "bitboard.h"
+#include "stream.h"
+
+/* stdio buffer of the stream, records go out in blocks this big */
+#define STREAM_BUFFER_BYTES (1 << 20)
+
+/******************** Empty Part **********************
+ * part_reset: Empties a part for a new round, keeping its buffer.
+ ***************************************************************/
+
+static void part_reset(struct stream_part *part) {
+    part->births = 0;
+    part->deaths = 0;
+    part->min_row = INT32_MAX;
+    part->min_col = INT32_MAX;
+    part->max_row = -1;
+    part->max_col = -1;
+    part->len = 0;
+    part->last = -1;
+}
+
+/******************** Grow Part **********************
+ * stream_part_grow: See stream.h.
+ ***************************************************************/
+
+void stream_part_grow(struct stream_part *part, size_t more) {
+    size_t cap = part->cap ? part->cap : 4096;
+
+    while (cap - part->len < more) {
+        cap *= 2;
+    }
+    part->delta = realloc(part->delta, cap);
+    if (!part->delta) {
+        printf("malloc failed: stream buffer\n");
+        exit(1);
+    }
+    part->cap = cap;
+}
+
+/******************** Write Record **********************
+ * write_record: Writes a record and, with state, its parts.
+ * st: The stream.
+ * rec: The record.
+ * parts, num_parts: Its board change, cut into parts.
+ * returns: void, sets st->failed if the write failed.
+ ***************************************************************/
+
+static void write_record(struct stream *st, const struct stream_record *rec,
+        const struct stream_part *parts, int num_parts) {
+    long long bytes = sizeof(*rec);
+    int ok = fwrite(rec, sizeof(*rec), 1, st->out) == 1;
+
+    if (st->state) {
+        uint32_t n = num_parts;
+
+        ok = ok && fwrite(&n, sizeof(n), 1, st->out) == 1;
+        bytes += sizeof(n);
+        for (int p = 0; p < num_parts; p++) {
+            uint32_t len = parts[p].len;
+
+            ok = ok && fwrite(&len, sizeof(len), 1, st->out) == 1
+                && fwrite(parts[p].delta, 1, len, st->out) == len;
+            bytes += sizeof(len) + len;
+        }
+    }
+    if (!ok) {
+        st->failed = 1;
+        return;
+    }
+    st->bytes += bytes;
+}
+
+/******************** Writer Thread **********************
+ * writer_main: Writes each round handed over, in order, until
+ *       stream_stop, and tells waiting workers each time a round's parts
+ *       are free again. After a failed write it keeps taking rounds
+ *       without writing them, so the workers never wait for it forever.
+ * arg: The stream.
+ * returns: NULL.
+ ***************************************************************/
+
+static void *writer_main(void *arg) {
+    struct stream *st = arg;
+
+    pthread_mutex_lock(&st->lock);
+    while (1) {
+        while (st->written == st->posted && !st->quit) {
+            pthread_cond_wait(&st->posted_cond, &st->lock);
+        }
+        if (st->written == st->posted) {
+            break;
+        }
+        long long gen = st->written + 1;
+        int slot = gen % STREAM_DEPTH;
+        pthread_mutex_unlock(&st->lock);
+
+        if (!st->failed) {
+            write_record(st, &st->records[slot],
+                    st->parts + (long)slot * st->num_threads,
+                    st->num_threads);
+        }
+
+        pthread_mutex_lock(&st->lock);
+        __atomic_store_n(&st->written, gen, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&st->written_cond);
+    }
+    pthread_mutex_unlock(&st->lock);
+    return NULL;
+}
+
+/******************** Start Stream **********************
+ * stream_start: See stream.h. The first record's change is the whole
+ *       board (from an empty one), and it has no births or deaths.
+ ***************************************************************/
+
+struct stream *stream_start(const char *path, int rows, int cols,
+        uint32_t rule, int state, int num_threads, long long gen,
+        const uint64_t *bits) {
+    struct stream *st = calloc(1, sizeof(struct stream));
+    struct stream_header h;
+    struct stream_record rec;
+    struct stream_part first;
+    int wpr = bitboard_words(cols);
+    long long live = 0;
+
+    if (!st) {
+        printf("malloc failed: stream\n");
+        exit(1);
+    }
+    st->path = path;
+    st->rows = rows;
+    st->cols = cols;
+    st->state = state;
+    st->num_threads = num_threads;
+    st->out = fopen(path, "w");
+    if (!st->out) {
+        printf("Error: failed to open file: %s\n", path);
+        exit(1);
+    }
+    setvbuf(st->out, NULL, _IOFBF, STREAM_BUFFER_BYTES);
+    st->parts = aligned_alloc(64, sizeof(struct stream_part)
+            * STREAM_DEPTH * num_threads);
+    if (!st->parts) {
+        printf("malloc failed: stream parts\n");
+        exit(1);
+    }
+    memset(st->parts, 0, sizeof(struct stream_part) * STREAM_DEPTH
+            * num_threads);
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, STREAM_MAGIC, sizeof(h.magic));
+    h.flags = state ? STREAM_STATE : 0;
+    h.rule = rule;
+    h.rows = rows;
+    h.cols = cols;
+    h.generation = gen;
+    if (fwrite(&h, sizeof(h), 1, st->out) != 1) {
+        st->failed = 1;
+    }
+    st->bytes = sizeof(h);
+
+    memset(&first, 0, sizeof(first));
+    part_reset(&first);
+    for (int i = 0; i < rows; i++) {
+        for (int w = 0; w < wpr; w++) {
+            uint64_t word = bits[(long)i * wpr + w];
+
+            live += __builtin_popcountll(word);
+            stream_part_word(&first, state, (long)i * wpr + w, i, w * 64,
+                    0, word);
+        }
+    }
+    memset(&rec, 0, sizeof(rec));
+    rec.generation = gen;
+    rec.live = live;
+    rec.min_row = first.max_row < 0 ? -1 : first.min_row;
+    rec.min_col = first.max_row < 0 ? -1 : first.min_col;
+    rec.max_row = first.max_row;
+    rec.max_col = first.max_row < 0 ? -1 : first.max_col;
+    write_record(st, &rec, &first, 1);
+    free(first.delta);
+
+    st->posted = gen;
+    st->written = gen;
+    pthread_mutex_init(&st->lock, NULL);
+    pthread_cond_init(&st->posted_cond, NULL);
+    pthread_cond_init(&st->written_cond, NULL);
+    if (pthread_create(&st->tid, NULL, writer_main, st)) {
+        perror("Error: pthread_create");
+        exit(1);
+    }
+    return st;
+}
+
+/******************** Begin Part **********************
+ * stream_part_begin: See stream.h. The part of round gen last held
+ *       round gen - STREAM_DEPTH, which must be written first.
+ ***************************************************************/
+
+struct stream_part *stream_part_begin(struct stream *st, int t,
+        long long gen) {
+    struct stream_part *part = &st->parts[(long)(gen % STREAM_DEPTH)
+        * st->num_threads + t];
+
+    if (__atomic_load_n(&st->written, __ATOMIC_ACQUIRE)
+            < gen - STREAM_DEPTH) {
+        pthread_mutex_lock(&st->lock);
+        __atomic_add_fetch(&st->waits, 1, __ATOMIC_RELAXED);
+        while (st->written < gen - STREAM_DEPTH) {
+            pthread_cond_wait(&st->written_cond, &st->lock);
+        }
+        pthread_mutex_unlock(&st->lock);
+    }
+    part_reset(part);
+    return part;
+}
+
+/******************** Post Round **********************
+ * stream_post: See stream.h.
+ ***************************************************************/
+
+void stream_post(struct stream *st, long long gen, long long live) {
+    int slot = gen % STREAM_DEPTH;
+    const struct stream_part *parts = st->parts + (long)slot
+        * st->num_threads;
+    struct stream_record *rec = &st->records[slot];
+
+    memset(rec, 0, sizeof(*rec));
+    rec->generation = gen;
+    rec->live = live;
+    rec->min_row = INT32_MAX;
+    rec->min_col = INT32_MAX;
+    rec->max_row = -1;
+    rec->max_col = -1;
+    for (int t = 0; t < st->num_threads; t++) {
+        const struct stream_part *p = &parts[t];
+
+        rec->births += p->births;
+        rec->deaths += p->deaths;
+        if (p->max_row < 0) {
+            continue;
+        }
+        rec->min_row = p->min_row < rec->min_row ? p->min_row : rec->min_row;
+        rec->min_col = p->min_col < rec->min_col ? p->min_col : rec->min_col;
+        rec->max_row = p->max_row > rec->max_row ? p->max_row : rec->max_row;
+        rec->max_col = p->max_col > rec->max_col ? p->max_col : rec->max_col;
+    }
+    if (rec->max_row < 0) {
+        rec->min_row = rec->min_col = rec->max_col = -1;
+    }
+
+    pthread_mutex_lock(&st->lock);
+    st->posted = gen;
+    pthread_cond_signal(&st->posted_cond);
+    pthread_mutex_unlock(&st->lock);
+}
+
+/******************** Stop Stream **********************
+ * stream_stop: See stream.h.
+ ***************************************************************/
+
+int stream_stop(struct stream *st, long long *last, long long *bytes,
+        long *waits) {
+    int failed;
+
+    pthread_mutex_lock(&st->lock);
+    st->quit = 1;
+    pthread_cond_signal(&st->posted_cond);
+    pthread_mutex_unlock(&st->lock);
+    pthread_join(st->tid, NULL);
+
+    if (fclose(st->out)) {
+        st->failed = 1;
+    }
+    failed = st->failed;
+    *last = st->written;
+    *bytes = st->bytes;
+    *waits = st->waits;
+
+    pthread_cond_destroy(&st->posted_cond);
+    pthread_cond_destroy(&st->written_cond);
+    pthread_mutex_destroy(&st->lock);
+    for (long k = 0; k < (long)STREAM_DEPTH * st->num_threads; k++) {
+        free(st->parts[k].delta);
+    }
+    free(st->parts);
+    free(st);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Streaming per-round output: population, births, deaths and the bounding
+ * box of the live cells after every round, and optionally the change to
+ * the board itself, as binary records written to a file or pipe. Each
+ * worker adds up its own part of a round while it steps it (the cells are
+ * still in cache) into a part of its own, and one thread sums the parts
+ * once the round is done. A writer thread writes the records.
+ *
+ * The parts of the last STREAM_DEPTH rounds are kept, so the writer can
+ * fall that far behind. A worker about to fill a part the writer has not
+ * written yet waits for it, so a slow disk slows the run down instead of
+ * letting the buffers grow.
+ *
+ * A board change is the XOR of the two boards in the bitboard.h layout,
+ * kept as a list of the words that are not 0: each is a varint count of
+ * zero words skipped since the last one, then the 8 bytes of the word.
+ */
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+
+/* first 8 bytes of every stream */
+#define STREAM_MAGIC "GOLSTRM1"
+
+/* rounds of parts kept for the writer */
+#define STREAM_DEPTH (8)
+
+/* stream header flags */
+#define STREAM_STATE (1u) //the records carry board changes
+
+struct stream_header {
+    char magic[8]; //STREAM_MAGIC, not nul terminated
+    uint32_t flags;
+    uint32_t rule; //see rule.h
+    int32_t rows;
+    int32_t cols;
+    int64_t generation; //the round of the first record
+};
+
+/* one record per round, followed by the board change with STREAM_STATE:
+ * a uint32 count of parts, then each part's uint32 length and bytes */
+struct stream_record {
+    int64_t generation;
+    int64_t live;
+    int64_t births;
+    int64_t deaths;
+    int32_t min_row, min_col; //bounding box of the live cells, -1 if none
+    int32_t max_row, max_col;
+};
+
+/* one worker's share of one round, on cache lines of its own */
+struct stream_part {
+    int64_t births, deaths;
+    int32_t min_row, min_col, max_row, max_col; //INT32_MAX/-1 if empty
+    unsigned char *delta; //the encoded change to its rows
+    size_t len, cap;
+    long last; //the last word put in delta, -1 for none
+} __attribute__((aligned(64)));
+
+struct stream {
+    FILE *out;
+    const char *path;
+    int rows, cols;
+    int state; //1 to write board changes
+    int num_threads;
+    struct stream_part *parts; //STREAM_DEPTH rounds of num_threads parts
+    struct stream_record records[STREAM_DEPTH];
+
+    long long posted; //the last round summed and handed over (atomic)
+    long long written; //the last round written (atomic)
+    long waits; //times a worker waited for the writer (atomic)
+    long long bytes; //bytes written
+    int failed; //1 once a write failed
+
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t posted_cond;
+    pthread_cond_t written_cond;
+    int quit;
+};
+
+/* open path, write the header and the record of round gen for the rows x
+ * cols board bits (bitboard.h layout) under rule, and start the writer
+ * for num_threads workers. state adds board changes. exits on failure */
+struct stream *stream_start(const char *path, int rows, int cols,
+        uint32_t rule, int state, int num_threads, long long gen,
+        const uint64_t *bits);
+
+/* called by worker t (from 0) before it steps round gen: waits if the
+ * writer still needs the part, then returns it emptied */
+struct stream_part *stream_part_begin(struct stream *st, int t,
+        long long gen);
+
+/* make room for at least more bytes in part's delta, exits on failure */
+void stream_part_grow(struct stream_part *part, size_t more);
+
+/* add a word of live cells at board row i, bit k being column j+k, to
+ * part's bounding box */
+static inline void stream_part_box(struct stream_part *part, int i, int j,
+        uint64_t live) {
+    int lo = j + __builtin_ctzll(live);
+    int hi = j + 63 - __builtin_clzll(live);
+
+    if (i < part->min_row) {
+        part->min_row = i;
+    }
+    if (i > part->max_row) {
+        part->max_row = i;
+    }
+    if (lo < part->min_col) {
+        part->min_col = lo;
+    }
+    if (hi > part->max_col) {
+        part->max_col = hi;
+    }
+}
+
+/* add the change diff (not 0) of word index of the board to part's delta;
+ * words must come in increasing index */
+static inline void stream_part_delta(struct stream_part *part, long index,
+        uint64_t diff) {
+    unsigned long skip = index - part->last - 1;
+    unsigned char *p;
+
+    if (part->cap - part->len < 18) {
+        stream_part_grow(part, 18);
+    }
+    p = part->delta + part->len;
+    while (skip >= 0x80) {
+        *p++ = (unsigned char)(skip | 0x80);
+        skip >>= 7;
+    }
+    *p++ = (unsigned char)skip;
+    memcpy(p, &diff, sizeof(diff));
+    part->len = p + sizeof(diff) - part->delta;
+    part->last = index;
+}
+
+/* add up to 64 cells of board row i, from column j, to part: before and
+ * after are them in the old and new board (bit k is column j+k). With
+ * state their change is added too, index being their word on the board */
+static inline void stream_part_word(struct stream_part *part, int state,
+        long index, int i, int j, uint64_t before, uint64_t after) {
+    uint64_t diff = before ^ after;
+
+    part->births += __builtin_popcountll(after & diff);
+    part->deaths += __builtin_popcountll(before & diff);
+    if (after) {
+        stream_part_box(part, i, j, after);
+    }
+    if (state && diff) {
+        stream_part_delta(part, index, diff);
+    }
+}
+
+/* stream_part_word over a whole bit-packed row i of n words, the first
+ * being word index of the board: the counts in one pass that vectorizes,
+ * the bounding box from the first and last live words, and the changed
+ * words only if there are any */
+static inline void stream_part_row(struct stream_part *part, int state,
+        long index, int i, const uint64_t *before, const uint64_t *after,
+        int n) {
+    int64_t births = 0, deaths = 0;
+    uint64_t changed = 0;
+    int lo, hi;
+
+    for (int w = 0; w < n; w++) {
+        uint64_t diff = before[w] ^ after[w];
+
+        births += __builtin_popcountll(after[w] & diff);
+        deaths += __builtin_popcountll(before[w] & diff);
+        changed |= diff;
+    }
+    part->births += births;
+    part->deaths += deaths;
+
+    for (lo = 0; lo < n && !after[lo]; lo++) {
+    }
+    if (lo < n) {
+        for (hi = n - 1; !after[hi]; hi--) {
+        }
+        stream_part_box(part, i, lo * 64, after[lo]);
+        stream_part_box(part, i, hi * 64, after[hi]);
+    }
+    if (state && changed) {
+        for (int w = 0; w < n; w++) {
+            if (before[w] != after[w]) {
+                stream_part_delta(part, index + w, before[w] ^ after[w]);
+            }
+        }
+    }
+}
+
+/* called by one thread once every worker's part of round gen is done:
+ * sums the parts, with live the board's live cells, and hands the round
+ * to the writer */
+void stream_post(struct stream *st, long long gen, long long live);
+
+/* write what is left, stop the writer and free the stream, after storing
+ * the last round and the bytes written and the times a worker waited.
+ * returns 0, or -1 if a write failed */
+int stream_stop(struct stream *st, long long *last, long long *bytes,
+        long *waits);
+
+#endif
@@ -0,0 +1,375 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Worker thread timeline, see trace.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "trace.h"
+
+/* trace_finish measures the TSC rate over at least this long */
+#define TRACE_CALIBRATE_SECS (0.05)
+
+/* names of the kinds in the timeline and the summary */
+static const char *kind_names[TRACE_KINDS] = {
+    "compute", "barrier", "neighbor wait", "checkpoint", "output"
+};
+
+/* the perf events of the counters, in trace_counter order */
+static const uint64_t counter_events[TRACE_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES
+};
+
+/* set by the first thread whose counters fail to open (atomic) */
+static int counters_warned = 0;
+
+/******************** Monotonic Seconds **********************/
+static double mono_secs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/******************** Timestamp **********************
+ * trace_now: See trace.h. The TSC runs at a fixed rate on any x86 with
+ *       an invariant TSC (constant_tsc in /proc/cpuinfo), and is read
+ *       without a system call.
+ ***************************************************************/
+
+uint64_t trace_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+/******************** Create Trace **********************
+ * trace_create: See trace.h.
+ ***************************************************************/
+
+struct trace *trace_create(int num_threads, long events_per_thread,
+        int counters) {
+    struct trace *tr = malloc(sizeof(*tr));
+
+    if (!tr) {
+        printf("malloc failed: trace\n");
+        exit(1);
+    }
+    tr->num_threads = num_threads;
+    tr->counters = counters;
+    tr->threads = aligned_alloc(64, sizeof(struct trace_thread)
+            * num_threads);
+    if (!tr->threads) {
+        printf("malloc failed: trace\n");
+        exit(1);
+    }
+    memset(tr->threads, 0, sizeof(struct trace_thread) * num_threads);
+    for (int t = 0; t < num_threads; t++) {
+        struct trace_thread *th = &tr->threads[t];
+
+        th->events = malloc(sizeof(struct trace_event) * events_per_thread);
+        if (!th->events) {
+            printf("malloc failed: trace events\n");
+            exit(1);
+        }
+        th->cap_events = events_per_thread;
+        for (int c = 0; c < TRACE_COUNTERS; c++) {
+            th->fds[c] = -1;
+        }
+    }
+    tr->ticks_per_sec = 0;
+    tr->mono0 = mono_secs();
+    tr->tsc0 = trace_now();
+    return tr;
+}
+
+/******************** Open Counter **********************
+ * open_counter: Opens one hardware counter of the calling thread, user
+ *       space only (so it works with perf_event_paranoid up to 2).
+ * event: A PERF_COUNT_HW_ event.
+ * group: The group leader's fd, or -1 to lead a new group.
+ * returns: The fd, or -1.
+ ***************************************************************/
+
+static int open_counter(uint64_t event, int group) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = event;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+/******************** Start Thread **********************
+ * trace_thread_start: See trace.h. The counters are one group, so one
+ *       read gets all of them, counted over the same instructions.
+ ***************************************************************/
+
+void trace_thread_start(struct trace *tr, int t) {
+    struct trace_thread *th = &tr->threads[t];
+
+    if (!tr->counters) {
+        return;
+    }
+    for (int c = 0; c < TRACE_COUNTERS; c++) {
+        th->fds[c] = open_counter(counter_events[c], c ? th->fds[0] : -1);
+        if (th->fds[c] < 0) {
+            if (!__atomic_exchange_n(&counters_warned, 1, __ATOMIC_RELAXED)) {
+                printf("Warning: no hardware counters (perf_event_open"
+                        " failed for %s), tracing times only\n",
+                        c == 0 ? "cycles" : c == 1 ? "instructions"
+                        : "cache misses");
+            }
+            trace_thread_stop(tr, t);
+            return;
+        }
+    }
+}
+
+/******************** Stop Thread **********************/
+void trace_thread_stop(struct trace *tr, int t) {
+    struct trace_thread *th = &tr->threads[t];
+
+    for (int c = 0; c < TRACE_COUNTERS; c++) {
+        if (th->fds[c] >= 0) {
+            close(th->fds[c]);
+            th->fds[c] = -1;
+        }
+    }
+}
+
+/******************** Read Counters **********************
+ * read_counters: Reads a thread's counter group.
+ * th: The thread, with its counters open.
+ * out: The counts, in trace_counter order.
+ * returns: 0, or -1 if the read failed.
+ ***************************************************************/
+
+static int read_counters(const struct trace_thread *th, uint64_t *out) {
+    struct {
+        uint64_t nr;
+        uint64_t values[TRACE_COUNTERS];
+    } group;
+
+    if (read(th->fds[0], &group, sizeof(group)) != sizeof(group)) {
+        return -1;
+    }
+    memcpy(out, group.values, sizeof(group.values));
+    return 0;
+}
+
+/******************** Begin Interval **********************
+ * trace_begin: See trace.h.
+ ***************************************************************/
+
+uint64_t trace_begin(struct trace *tr, int t, int kind) {
+    struct trace_thread *th = &tr->threads[t];
+
+    if (kind == TRACE_COMPUTE && th->fds[0] >= 0) {
+        read_counters(th, th->last);
+    }
+    return trace_now();
+}
+
+/******************** End Interval **********************
+ * trace_end: See trace.h. An interval always goes into the totals, and
+ *       into the timeline while there is room.
+ ***************************************************************/
+
+void trace_end(struct trace *tr, int t, int kind, int round,
+        uint64_t start) {
+    struct trace_thread *th = &tr->threads[t];
+    uint64_t end = trace_now();
+    uint64_t counts[TRACE_COUNTERS] = {0, 0, 0};
+
+    if (kind == TRACE_COMPUTE && th->fds[0] >= 0
+            && read_counters(th, counts) == 0) {
+        for (int c = 0; c < TRACE_COUNTERS; c++) {
+            counts[c] -= th->last[c];
+            th->counts[c] += counts[c];
+        }
+    }
+    th->ticks[kind] += end - start;
+    if (th->num_events < th->cap_events) {
+        struct trace_event *e = &th->events[th->num_events++];
+
+        e->start = start;
+        e->end = end;
+        e->kind = kind;
+        e->round = round;
+        memcpy(e->counts, counts, sizeof(counts));
+    }
+    else {
+        th->dropped++;
+    }
+}
+
+/******************** Finish Trace **********************
+ * trace_finish: See trace.h. A short run is padded with a sleep, so the
+ *       rate is measured over at least TRACE_CALIBRATE_SECS.
+ ***************************************************************/
+
+void trace_finish(struct trace *tr) {
+    double secs = mono_secs() - tr->mono0;
+
+    if (secs < TRACE_CALIBRATE_SECS) {
+        usleep((TRACE_CALIBRATE_SECS - secs) * 1e6 + 1);
+    }
+    //read the two clocks as close together as we can
+    uint64_t tsc = trace_now();
+
+    secs = mono_secs() - tr->mono0;
+    tr->ticks_per_sec = (tsc - tr->tsc0) / secs;
+}
+
+/******************** Write JSON **********************
+ * trace_write_json: See trace.h. Every interval is a complete ("X")
+ *       event on its thread's track, with times in microseconds from the
+ *       start of the trace. Compute intervals with counters also carry
+ *       them as args and add an IPC sample to a counter ("C") track.
+ ***************************************************************/
+
+int trace_write_json(const struct trace *tr, const char *path) {
+    FILE *out = fopen(path, "w");
+    double us = 1e6 / tr->ticks_per_sec;
+    const char *sep = "";
+
+    if (!out) {
+        printf("Error: failed to open file: %s\n", path);
+        return -1;
+    }
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (int t = 0; t < tr->num_threads; t++) {
+        const struct trace_thread *th = &tr->threads[t];
+
+        fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1,"
+                " \"tid\": %d, \"args\": {\"name\": \"tid %d\"}}", sep, t + 1,
+                t + 1);
+        sep = ",\n";
+        for (long k = 0; k < th->num_events; k++) {
+            const struct trace_event *e = &th->events[k];
+            const uint64_t *c = e->counts;
+
+            fprintf(out, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1,"
+                    " \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f,"
+                    " \"args\": {\"round\": %d", kind_names[e->kind], t + 1,
+                    (double)(e->start - tr->tsc0) * us,
+                    (double)(e->end - e->start) * us, e->round);
+            if (e->kind == TRACE_COMPUTE && c[TRACE_CYCLES]) {
+                double ipc = (double)c[TRACE_INSTRUCTIONS] / c[TRACE_CYCLES];
+
+                fprintf(out, ", \"cycles\": %lu, \"instructions\": %lu,"
+                        " \"cache_misses\": %lu, \"ipc\": %.3f}},\n"
+                        "{\"name\": \"IPC tid %d\", \"ph\": \"C\","
+                        " \"pid\": 1, \"ts\": %.3f, \"args\": {\"ipc\": %.3f}}",
+                        (unsigned long)c[TRACE_CYCLES],
+                        (unsigned long)c[TRACE_INSTRUCTIONS],
+                        (unsigned long)c[TRACE_CACHE_MISSES], ipc, t + 1,
+                        (double)(e->start - tr->tsc0) * us, ipc);
+            }
+            else {
+                fprintf(out, "}}");
+            }
+        }
+    }
+    fprintf(out, "\n]}\n");
+    if (fclose(out)) {
+        printf("Error: failed to write file: %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/******************** Print Summary **********************
+ * trace_print_summary: See trace.h. One line per thread with the
+ *       milliseconds spent in each kind and the share spent computing,
+ *       then the counters if there are any. The spread of compute times
+ *       shows load imbalance; barrier time is what it costs.
+ ***************************************************************/
+
+void trace_print_summary(const struct trace *tr) {
+    double ms = 1e3 / tr->ticks_per_sec;
+    uint64_t min_compute = UINT64_MAX, max_compute = 0;
+    long dropped = 0;
+    int counted = 0;
+
+    //counters were asked for and at least one thread could open them
+    for (int t = 0; t < tr->num_threads; t++) {
+        counted |= tr->threads[t].counts[TRACE_CYCLES] != 0;
+    }
+
+    printf("Trace (TSC %.3f GHz):\n", tr->ticks_per_sec / 1e9);
+    printf("tid  %12s %12s %12s %12s %12s %9s", "compute ms", "barrier ms",
+            "nbr wait ms", "ckpt ms", "output ms", "compute%");
+    if (counted) {
+        printf(" %6s %14s", "IPC", "cache misses");
+    }
+    printf("\n");
+    for (int t = 0; t < tr->num_threads; t++) {
+        const struct trace_thread *th = &tr->threads[t];
+        uint64_t total = 0;
+
+        for (int k = 0; k < TRACE_KINDS; k++) {
+            total += th->ticks[k];
+        }
+        printf("%4d", t + 1);
+        for (int k = 0; k < TRACE_KINDS; k++) {
+            printf(" %12.3f", th->ticks[k] * ms);
+        }
+        printf(" %8.1f%%", total ? 100.0 * th->ticks[TRACE_COMPUTE] / total
+                : 0.0);
+        if (counted) {
+            const uint64_t *c = th->counts;
+
+            printf(" %6.2f %14lu", c[TRACE_CYCLES]
+                    ? (double)c[TRACE_INSTRUCTIONS] / c[TRACE_CYCLES] : 0.0,
+                    (unsigned long)c[TRACE_CACHE_MISSES]);
+        }
+        printf("\n");
+        if (th->ticks[TRACE_COMPUTE] < min_compute) {
+            min_compute = th->ticks[TRACE_COMPUTE];
+        }
+        if (th->ticks[TRACE_COMPUTE] > max_compute) {
+            max_compute = th->ticks[TRACE_COMPUTE];
+        }
+        dropped += th->dropped;
+    }
+    printf("compute imbalance (max/min): %.3f\n", min_compute
+            ? (double)max_compute / min_compute : 0.0);
+    if (dropped) {
+        printf("Warning: the timeline filled up, %ld later intervals are"
+                " only in the totals\n", dropped);
+    }
+}
+
+/******************** Destroy Trace **********************/
+void trace_destroy(struct trace *tr) {
+    for (int t = 0; t < tr->num_threads; t++) {
+        free(tr->threads[t].events);
+    }
+    free(tr->threads);
+    free(tr);
+}
@@ -0,0 +1,107 @@
+/*
+ * Swarthmore College, CS 31
+ * Copyright (c) 2023 Swarthmore College Computer Science Department,
+ * Swarthmore PA
+ */
+
+/*
+ * Per-thread timeline of the worker threads: how long each spends
+ * computing, waiting at the barrier, waiting for its neighbors, packing
+ * checkpoints and animating, every round. Times are read from the TSC (a
+ * few cycles, no system call) and turned into seconds against the
+ * monotonic clock at the end. Optionally each compute interval also reads
+ * the thread's hardware counters (cycles, instructions, cache misses)
+ * through perf_event_open. Each thread only writes its own cache-aligned
+ * record, so tracing adds no sharing between threads.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/* what a thread was doing in a traced interval */
+enum trace_kind {
+    TRACE_COMPUTE,    //stepping its cells
+    TRACE_BARRIER,    //waiting at the round barrier
+    TRACE_NEIGHBOR,   //neighbor sync: waiting for the bands beside it
+    TRACE_CHECKPOINT, //packing its rows of a checkpoint
+    TRACE_OUTPUT,     //printing or drawing the board
+    TRACE_KINDS
+};
+
+/* hardware counters read around every compute interval */
+enum trace_counter {
+    TRACE_CYCLES,
+    TRACE_INSTRUCTIONS,
+    TRACE_CACHE_MISSES,
+    TRACE_COUNTERS
+};
+
+/* one interval on a thread's timeline */
+struct trace_event {
+    uint64_t start, end; //TSC ticks
+    int kind;
+    int round;
+    uint64_t counts[TRACE_COUNTERS]; //compute intervals with counters only
+};
+
+/* one thread's timeline and totals, on cache lines of its own */
+struct trace_thread {
+    struct trace_event *events;
+    long num_events;
+    long cap_events; //events past this are only added to the totals
+    long dropped; //events left out of the timeline
+    uint64_t ticks[TRACE_KINDS]; //time in each kind
+    uint64_t counts[TRACE_COUNTERS]; //counter totals over compute
+    int fds[TRACE_COUNTERS]; //perf events, the first leads the group; -1
+    uint64_t last[TRACE_COUNTERS]; //counters when compute started
+} __attribute__((aligned(64)));
+
+struct trace {
+    int num_threads;
+    int counters; //1 if hardware counters were asked for
+    struct trace_thread *threads;
+    uint64_t tsc0; //when the trace started
+    double mono0;
+    double ticks_per_sec; //set by trace_finish
+};
+
+/* the timestamp counter, or monotonic nanoseconds where there is none */
+uint64_t trace_now(void);
+
+/* a trace of num_threads threads, with room for events_per_thread events
+ * each; counters asks for hardware counters. exits on failure */
+struct trace *trace_create(int num_threads, long events_per_thread,
+        int counters);
+
+/* called by thread t (from 0) before its first interval: opens its
+ * counters if they were asked for. Prints a warning once and goes on
+ * without them if the kernel refuses */
+void trace_thread_start(struct trace *tr, int t);
+
+/* called by thread t after its last interval: closes its counters */
+void trace_thread_stop(struct trace *tr, int t);
+
+/* start an interval of thread t, returns its start time. For
+ * TRACE_COMPUTE this also reads the counters */
+uint64_t trace_begin(struct trace *tr, int t, int kind);
+
+/* end an interval of thread t started at start, in round round */
+void trace_end(struct trace *tr, int t, int kind, int round,
+        uint64_t start);
+
+/* after the threads are joined: calibrate the TSC against the monotonic
+ * clock, so ticks can be turned into seconds */
+void trace_finish(struct trace *tr);
+
+/* write the timeline in the Chrome trace event format (JSON), which
+ * chrome://tracing and ui.perfetto.dev open. returns 0 or -1 */
+int trace_write_json(const struct trace *tr, const char *path);
+
+/* print the per-thread totals to stdout */
+void trace_print_summary(const struct trace *tr);
+
+/* free the trace */
+void trace_destroy(struct trace *tr);
+
+#endif